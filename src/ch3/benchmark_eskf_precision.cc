@@ -0,0 +1,196 @@
+//
+// ESKF精度与耗时测试：双精度、单精度与混合精度（名义位置double，协方差与雅可比float）
+//
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "ch3/eskf.hpp"
+#include "ch3/static_imu_init.h"
+#include "ch3/utm_convert.h"
+#include "common/sensor_timeline.h"
+#include "common/txt_reader.h"
+
+DEFINE_string(txt_path, "./data/ch3/10.txt", "数据文件路径");
+DEFINE_double(antenna_angle, 12.06, "RTK天线安装偏角（角度）");
+DEFINE_double(antenna_pox_x, -0.17, "RTK天线安装偏移X");
+DEFINE_double(antenna_pox_y, -0.20, "RTK天线安装偏移Y");
+DEFINE_int32(repeat, 3, "每种精度重复处理整个日志的次数");
+
+namespace {
+
+/// 静止初始化得到的零偏、重力与IMU噪声
+struct InitParams {
+    Vec3d bg_ = Vec3d::Zero();
+    Vec3d ba_ = Vec3d::Zero();
+    Vec3d gravity_ = Vec3d(0, 0, -9.8);
+    double gyro_var_ = 1e-5;
+    double acce_var_ = 1e-2;
+};
+
+/// 一种精度处理整个日志的结果
+struct PrecisionRunResult {
+    std::string name_;
+    int imus_ = 0;                 // 递推的IMU个数
+    int updates_ = 0;              // 观测更新次数
+    double imu_ns_ = 0;            // 平均每个IMU的总耗时（含观测更新）
+    double update_ns_ = 0;         // 平均每次ObserveGps的耗时
+    std::vector<SE3> poses_;       // 每次观测更新后的名义位姿（double）
+    Eigen::Matrix<double, 18, 1> cov_diag_;  // 处理结束时协方差的对角线
+};
+
+/**
+ * 按时间顺序处理整个日志：首个GNSS之后IMU递推，GNSS做完整的位姿观测
+ * @param absolute  为true时GNSS位置加回UTM原点，即在数百万米量级的绝对坐标下滤波
+ */
+template <typename ESKFType>
+PrecisionRunResult Run(const sad::SensorTimeline& timeline, const sad::GNSSUTMTable& utm_table,
+                       const InitParams& init, bool absolute, const std::string& name) {
+    using VecT = typename ESKFType::VecT;
+    typename ESKFType::Options options;
+    options.gyro_var_ = init.gyro_var_;
+    options.acce_var_ = init.acce_var_;
+    options.phone_pitch_install_ = 0.0;
+    options.body_acce_path_ = "";
+
+    PrecisionRunResult result;
+    result.name_ = name;
+    double total_ns = 0, update_ns = 0;
+    for (int r = 0; r < std::max(FLAGS_repeat, 1); ++r) {
+        ESKFType eskf;
+        eskf.SetInitialConditions(options, init.bg_.cast<typename VecT::Scalar>(),
+                                  init.ba_.cast<typename VecT::Scalar>(),
+                                  init.gravity_.cast<typename VecT::Scalar>());
+        bool gnss_inited = false;
+        result.imus_ = result.updates_ = 0;
+        result.poses_.clear();
+
+        auto t_begin = std::chrono::steady_clock::now();
+        timeline.ForEachIndexed(
+            [&](const sad::IMU& imu) {
+                if (gnss_inited && eskf.Predict(imu)) {
+                    result.imus_++;
+                }
+            },
+            [&](const sad::GNSS& gnss, uint32_t index) {
+                if (!utm_table.valid_[index]) {
+                    return;
+                }
+                sad::GNSS gnss_convert = gnss;
+                gnss_convert.utm_pose_ = utm_table.pose_[index];
+                if (absolute) {
+                    gnss_convert.utm_pose_.translation() += utm_table.origin_;
+                }
+
+                auto t1 = std::chrono::steady_clock::now();
+                bool updated = eskf.ObserveGps(gnss_convert);
+                auto t2 = std::chrono::steady_clock::now();
+                gnss_inited = true;
+                if (!updated) {
+                    return;
+                }
+                update_ns += std::chrono::duration<double, std::nano>(t2 - t1).count();
+                result.updates_++;
+                result.poses_.emplace_back(eskf.GetNominalSE3());
+            });
+        total_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t_begin).count();
+        result.cov_diag_ = eskf.GetCov().diagonal().template cast<double>();
+    }
+
+    const int repeat = std::max(FLAGS_repeat, 1);
+    result.imu_ns_ = total_ns / std::max(result.imus_ * repeat, 1);
+    result.update_ns_ = update_ns / std::max(result.updates_ * repeat, 1);
+    return result;
+}
+
+/// 与同一坐标下double滤波的结果比较：位置差的RMS与最大值、最大姿态差和协方差对角线的最大相对差异
+void Report(const PrecisionRunResult& r, const PrecisionRunResult& ref) {
+    double sum_sq = 0, max_pos = 0, max_rot = 0;
+    const size_t n = std::min(r.poses_.size(), ref.poses_.size());
+    for (size_t i = 0; i < n; ++i) {
+        const double dp = (r.poses_[i].translation() - ref.poses_[i].translation()).norm();
+        sum_sq += dp * dp;
+        max_pos = std::max(max_pos, dp);
+        max_rot = std::max(max_rot, (ref.poses_[i].so3().inverse() * r.poses_[i].so3()).log().norm());
+    }
+    const double max_cov = ((r.cov_diag_ - ref.cov_diag_).cwiseAbs().array() / ref.cov_diag_.cwiseAbs().array())
+                               .maxCoeff();
+
+    LOG(INFO) << std::left << std::setw(16) << r.name_ << std::right << " IMU " << r.imus_ << " 个, 更新 "
+              << r.updates_ << " 次: " << std::fixed << std::setprecision(1) << r.imu_ns_ << " ns/IMU, "
+              << r.update_ns_ << " ns/更新, 加速 " << std::setprecision(2) << ref.imu_ns_ / r.imu_ns_ << " 倍";
+    LOG(INFO) << std::left << std::setw(16) << r.name_ << std::right << " 与double相比: 位置差RMS " << std::scientific
+              << std::setprecision(3) << std::sqrt(sum_sq / std::max<size_t>(n, 1)) << " m, 最大 " << max_pos
+              << " m, 最大姿态差 " << max_rot * sad::math::kRAD2DEG << " 度, 协方差对角线最大相对差异 " << max_cov
+              << (r.poses_.size() == ref.poses_.size() ? "" : ", 更新次数不同");
+}
+
+}  // namespace
+
+/// 本程序比较ESKFD、ESKFF与ESKFMixed处理整个日志的耗时(ns/IMU、ns/更新)与精度
+/// 分别在减去UTM原点的局部坐标和绝对UTM坐标下运行，后者中float的名义位置只有分米级分辨率，混合精度用double存放位置
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = google::INFO;
+    FLAGS_colorlogtostderr = true;
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    std::vector<sad::IMU> imus;
+    std::vector<sad::GNSS> gnss;
+    sad::TxtReader reader(FLAGS_txt_path, sad::TxtReadMode::MMAP,
+                          sad::Overloaded{[&](const sad::IMU& imu) { imus.push_back(imu); },
+                                          [&](const sad::GNSS& g) { gnss.push_back(g); }});
+    reader.Go();
+    if (imus.empty() || gnss.empty()) {
+        LOG(ERROR) << "未能从文件读取IMU/GNSS数据: " << FLAGS_txt_path;
+        return -1;
+    }
+
+    auto tables = sad::SensorTables::Create(imus, gnss);
+    sad::GNSSUTMTable utm_table;
+    if (!sad::ConvertGNSSTable2UTM(tables->gnss_, Vec2d(FLAGS_antenna_pox_x, FLAGS_antenna_pox_y),
+                                   FLAGS_antenna_angle, utm_table)) {
+        LOG(ERROR) << "GPS坐标转换失败";
+        return -1;
+    }
+    sad::SensorTimeline timeline;
+    timeline.Build(tables, 0.0);
+    LOG(INFO) << "IMU数据 " << tables->imu_.Size() << " 条, GNSS数据 " << tables->gnss_.Size() << " 条";
+
+    // 静止初始化零偏、重力与IMU噪声，未成功时使用默认值
+    InitParams init;
+    sad::StaticIMUInit::Options init_options;
+    init_options.use_speed_for_static_checking_ = false;
+    sad::StaticIMUInit imu_init(init_options);
+    for (const auto& imu : imus) {
+        if (imu_init.AddIMU(imu) && imu_init.InitSuccess()) {
+            break;
+        }
+    }
+    if (imu_init.InitSuccess()) {
+        init.bg_ = imu_init.GetInitBg();
+        init.ba_ = imu_init.GetInitBa();
+        init.gravity_ = imu_init.GetGravity();
+        init.gyro_var_ = std::sqrt(imu_init.GetCovGyro()[0]);
+        init.acce_var_ = std::sqrt(imu_init.GetCovAcce()[0]);
+    } else {
+        LOG(WARNING) << "IMU静止初始化失败，使用默认零偏与噪声";
+    }
+
+    for (bool absolute : {false, true}) {
+        const std::string frame = absolute ? " abs" : " local";
+        const auto ref = Run<sad::ESKFD>(timeline, utm_table, init, absolute, "double" + frame);
+        const auto single = Run<sad::ESKFF>(timeline, utm_table, init, absolute, "float" + frame);
+        const auto mixed = Run<sad::ESKFMixed>(timeline, utm_table, init, absolute, "mixed" + frame);
+        Report(ref, ref);
+        Report(single, ref);
+        Report(mixed, ref);
+    }
+    return 0;
+}
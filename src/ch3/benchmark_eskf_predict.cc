@@ -0,0 +1,164 @@
+//
+// ESKF预测步耗时测试：分块协方差传播、上三角紧凑存放的分块传播与稠密矩阵传播，以及成批递推
+//
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "ch3/eskf.hpp"
+#include "common/timer/timer.h"
+#include "common/txt_reader.h"
+
+DEFINE_string(txt_path, "./data/ch3/10.txt", "数据文件路径");
+DEFINE_int32(repeat, 5, "每种配置重复次数");
+DEFINE_int32(max_imu, 0, "最多使用的IMU条数，0表示全部");
+DEFINE_int32(batch_size, 10, "成批递推时每批的IMU个数，对应相邻两个GNSS之间的IMU");
+
+namespace {
+
+/**
+ * 用一种配置对IMU序列逐条预测，每次重复都从相同的初始状态开始
+ * @param cov    最后一次重复结束时的协方差
+ * @return 实际完成递推的次数（不含跳过的IMU）
+ */
+template <typename S>
+int RunPredict(const std::vector<sad::IMU>& imus, bool dense, bool packed, const std::string& name,
+               typename sad::ESKF<S>::Mat18T& cov) {
+    using ESKFType = sad::ESKF<S>;
+    typename ESKFType::Options options;
+    options.gyro_var_ = 2e-3;
+    options.acce_var_ = 5e-2;
+    options.body_acce_path_ = "";
+    options.dense_covariance_propagation_ = dense;
+    options.packed_covariance_ = packed;
+
+    int predicted = 0;
+    for (int i = 0; i < std::max(FLAGS_repeat, 1); ++i) {
+        ESKFType eskf;
+        eskf.SetInitialConditions(options, ESKFType::VecT::Zero(), ESKFType::VecT::Zero());
+        predicted = 0;
+        sad::common::Timer::Evaluate(
+            [&]() {
+                for (const auto& imu : imus) {
+                    predicted += eskf.Predict(imu) ? 1 : 0;
+                }
+            },
+            name);
+        cov = eskf.GetCov();
+    }
+    return predicted;
+}
+
+/**
+ * 把IMU序列按batch_size分批调用PredictBatch，每批只传播一次协方差
+ * @param propagation_samples  batch_propagation_samples_，为1时每个IMU传播一次，应与逐个Predict相同
+ * @param states  最后一次重复得到的每个IMU之后的名义状态
+ */
+template <typename S>
+int RunPredictBatch(const std::vector<sad::IMU>& imus, int propagation_samples, const std::string& name,
+                    typename sad::ESKF<S>::Mat18T& cov, std::vector<typename sad::ESKF<S>::NavStateT>& states) {
+    using ESKFType = sad::ESKF<S>;
+    typename ESKFType::Options options;
+    options.gyro_var_ = 2e-3;
+    options.acce_var_ = 5e-2;
+    options.body_acce_path_ = "";
+    options.batch_propagation_samples_ = propagation_samples;
+
+    const size_t batch_size = static_cast<size_t>(std::max(FLAGS_batch_size, 1));
+    int predicted = 0;
+    for (int i = 0; i < std::max(FLAGS_repeat, 1); ++i) {
+        ESKFType eskf;
+        eskf.SetInitialConditions(options, ESKFType::VecT::Zero(), ESKFType::VecT::Zero());
+        predicted = 0;
+        states.clear();
+        states.reserve(imus.size());
+        sad::common::Timer::Evaluate(
+            [&]() {
+                for (size_t begin = 0; begin < imus.size(); begin += batch_size) {
+                    predicted += eskf.PredictBatch(imus.data() + begin, std::min(batch_size, imus.size() - begin),
+                                                   &states);
+                }
+            },
+            name);
+        cov = eskf.GetCov();
+    }
+    return predicted;
+}
+
+/// 比较分块与稠密传播的协方差，返回相对最大误差，并给出两者的对称性误差
+template <typename S>
+void Compare(const std::vector<sad::IMU>& imus, const std::string& type_name) {
+    using Mat18T = typename sad::ESKF<S>::Mat18T;
+    Mat18T cov_blocks, cov_packed, cov_dense;
+    const int predicted = RunPredict<S>(imus, false, false, type_name + " blocks", cov_blocks);
+    RunPredict<S>(imus, false, true, type_name + " packed", cov_packed);
+    RunPredict<S>(imus, true, false, type_name + " dense", cov_dense);
+
+    const double blocks_ns =
+        sad::common::Timer::GetMeanTime(type_name + " blocks") * 1e6 / std::max(predicted, 1);
+    const double packed_ns =
+        sad::common::Timer::GetMeanTime(type_name + " packed") * 1e6 / std::max(predicted, 1);
+    const double dense_ns = sad::common::Timer::GetMeanTime(type_name + " dense") * 1e6 / std::max(predicted, 1);
+    const double rel_diff = (cov_blocks - cov_dense).cwiseAbs().maxCoeff() / cov_dense.cwiseAbs().maxCoeff();
+    const double blocks_asym = (cov_blocks - cov_blocks.transpose()).cwiseAbs().maxCoeff();
+    const double dense_asym = (cov_dense - cov_dense.transpose()).cwiseAbs().maxCoeff();
+
+    LOG(INFO) << type_name << " Predict " << predicted << " 次: 分块 " << std::fixed << std::setprecision(1)
+              << blocks_ns << " ns/次, 紧凑存放 " << packed_ns << " ns/次, 稠密 " << dense_ns << " ns/次, 加速 " << std::setprecision(2)
+              << dense_ns / blocks_ns << " 倍";
+    LOG(INFO) << type_name << " 紧凑存放与分块传播的协方差" << ((cov_packed - cov_blocks).isZero(0) ? "相同" : "不同");
+    LOG(INFO) << type_name << " 协方差相对最大差异 " << std::scientific << std::setprecision(3) << rel_diff
+              << ", 不对称量: 分块 " << blocks_asym << ", 稠密 " << dense_asym;
+
+    // 成批递推：名义状态与逐个Predict相同，协方差每批传播一次
+    std::vector<typename sad::ESKF<S>::NavStateT> states_batch, states_single;
+    Mat18T cov_batch, cov_single;
+    RunPredictBatch<S>(imus, 0, type_name + " batch", cov_batch, states_batch);
+    RunPredictBatch<S>(imus, 1, type_name + " batch1", cov_single, states_single);
+    const double batch_ns = sad::common::Timer::GetMeanTime(type_name + " batch") * 1e6 / std::max(predicted, 1);
+    const double single_ns = sad::common::Timer::GetMeanTime(type_name + " batch1") * 1e6 / std::max(predicted, 1);
+    const auto rel = [&](const Mat18T& cov) {
+        return (cov - cov_blocks).cwiseAbs().maxCoeff() / cov_blocks.cwiseAbs().maxCoeff();
+    };
+    LOG(INFO) << type_name << " PredictBatch 每批" << FLAGS_batch_size << "个IMU: 每批传播一次 " << std::fixed
+              << std::setprecision(1) << batch_ns << " ns/IMU, 加速 " << std::setprecision(2) << blocks_ns / batch_ns
+              << " 倍; 每个IMU传播一次 " << std::setprecision(1) << single_ns << " ns/IMU";
+    LOG(INFO) << type_name << " PredictBatch 与逐个Predict的协方差相对最大差异: 每批传播一次 " << std::scientific
+              << std::setprecision(3) << rel(cov_batch) << ", 每个IMU传播一次 " << rel(cov_single) << ", 名义状态"
+              << (states_batch.size() == static_cast<size_t>(predicted) ? "个数相同" : "个数不同");
+}
+
+}  // namespace
+
+/// 本程序比较ESKF预测步分块传播、紧凑存放与稠密传播协方差的耗时(ns/Predict)，分别测试ESKFD与ESKFF
+/// 同时给出两种方式最终协方差的相对差异，验证分块传播与F * P * F^T + Q相同
+/// 并测试按batch_size分批调用PredictBatch的耗时(ns/IMU)及其协方差与逐个Predict的差异
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = google::INFO;
+    FLAGS_colorlogtostderr = true;
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    std::vector<sad::IMU> imus;
+    sad::TxtReader reader(FLAGS_txt_path, sad::TxtReadMode::MMAP,
+                          sad::Overloaded{[&](const sad::IMU& imu) { imus.push_back(imu); }});
+    reader.Go();
+    if (imus.empty()) {
+        LOG(ERROR) << "未能从文件读取IMU数据: " << FLAGS_txt_path;
+        return -1;
+    }
+    std::stable_sort(imus.begin(), imus.end(),
+                     [](const sad::IMU& a, const sad::IMU& b) { return a.timestamp_ < b.timestamp_; });
+    if (FLAGS_max_imu > 0 && imus.size() > static_cast<size_t>(FLAGS_max_imu)) {
+        imus.resize(FLAGS_max_imu);
+    }
+    LOG(INFO) << "IMU数据 " << imus.size() << " 条";
+
+    Compare<double>(imus, "ESKFD");
+    Compare<float>(imus, "ESKFF");
+    return 0;
+}
@@ -0,0 +1,185 @@
+//
+// ESKF观测更新耗时与协方差对称性测试：稠密求逆、LDLT与逐个标量观测，以及上三角紧凑存放的协方差
+//
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "ch3/eskf.hpp"
+#include "ch3/utm_convert.h"
+#include "common/sensor_timeline.h"
+#include "common/txt_reader.h"
+
+DEFINE_string(txt_path, "./data/ch3/10.txt", "数据文件路径");
+DEFINE_int32(repeat, 3, "每种更新方式重复处理整个日志的次数");
+DEFINE_double(projection_tolerance, 1e-12, "协方差投影分块与稠密形式允许的最大相对差异");
+
+namespace {
+
+/// 一种更新方式处理整个日志的结果
+struct UpdateRunResult {
+    std::string name_;
+    int updates_ = 0;           // 观测更新次数
+    double update_ns_ = 0;      // 平均每次ObserveGps的耗时
+    double max_asymmetry_ = 0;  // 每次更新后max|P - P^T| / max|P|的最大值
+    sad::NavStated state_;      // 处理结束时的状态
+};
+
+/**
+ * 按时间顺序处理整个日志：IMU递推，GNSS做完整的位姿观测，只统计观测更新的耗时
+ * 协方差传播用分块形式，本身严格对称，不对称量只来自观测更新
+ */
+UpdateRunResult Run(const sad::SensorTimeline& timeline, const sad::GNSSUTMTable& utm_table,
+                    sad::ESKFD::UpdateMethod method, bool packed, const std::string& name) {
+    sad::ESKFD::Options options;
+    options.gyro_var_ = 2e-3;
+    options.acce_var_ = 5e-2;
+    options.body_acce_path_ = "";
+    options.update_method_ = method;
+    options.packed_covariance_ = packed;
+
+    UpdateRunResult result;
+    result.name_ = name;
+    double total_ns = 0;
+    for (int r = 0; r < std::max(FLAGS_repeat, 1); ++r) {
+        sad::ESKFD eskf;
+        eskf.SetInitialConditions(options, Vec3d::Zero(), Vec3d::Zero());
+        result.updates_ = 0;
+        result.max_asymmetry_ = 0;
+        timeline.ForEachIndexed([&](const sad::IMU& imu) { eskf.Predict(imu); },
+                                [&](const sad::GNSS& gnss, uint32_t index) {
+                                    if (!utm_table.valid_[index]) {
+                                        return;
+                                    }
+                                    sad::GNSS gnss_convert = gnss;
+                                    gnss_convert.utm_pose_ = utm_table.pose_[index];
+
+                                    auto t1 = std::chrono::steady_clock::now();
+                                    bool updated = eskf.ObserveGps(gnss_convert);
+                                    auto t2 = std::chrono::steady_clock::now();
+                                    if (!updated) {
+                                        return;
+                                    }
+                                    total_ns += std::chrono::duration<double, std::nano>(t2 - t1).count();
+                                    result.updates_++;
+
+                                    const auto& cov = eskf.GetCov();
+                                    double asym = (cov - cov.transpose()).cwiseAbs().maxCoeff() /
+                                                  cov.cwiseAbs().maxCoeff();
+                                    result.max_asymmetry_ = std::max(result.max_asymmetry_, asym);
+                                });
+        result.state_ = eskf.GetNominalState();
+    }
+    result.update_ns_ = total_ns / std::max(result.updates_ * std::max(FLAGS_repeat, 1), 1);
+    return result;
+}
+
+/**
+ * 处理整个日志，每次观测更新后用本次的协方差与姿态修正量dtheta分别做分块与稠密的投影，比较两者的结果
+ * dtheta由更新前后的姿态求得，与滤波内部投影时使用的修正量相同（舍入误差除外）
+ * @return 分块投影与稠密投影的最大相对差异
+ */
+double CheckProjection(const sad::SensorTimeline& timeline, const sad::GNSSUTMTable& utm_table) {
+    sad::ESKFD::Options options;
+    options.gyro_var_ = 2e-3;
+    options.acce_var_ = 5e-2;
+    options.body_acce_path_ = "";
+
+    sad::ESKFD eskf;
+    eskf.SetInitialConditions(options, Vec3d::Zero(), Vec3d::Zero());
+    int checked = 0;
+    double max_diff = 0, blocks_ns = 0, dense_ns = 0;
+    timeline.ForEachIndexed([&](const sad::IMU& imu) { eskf.Predict(imu); },
+                            [&](const sad::GNSS& gnss, uint32_t index) {
+                                if (!utm_table.valid_[index]) {
+                                    return;
+                                }
+                                sad::GNSS gnss_convert = gnss;
+                                gnss_convert.utm_pose_ = utm_table.pose_[index];
+                                const SO3 R_before = eskf.GetNominalState().R_;
+                                if (!eskf.ObserveGps(gnss_convert)) {
+                                    return;
+                                }
+                                const Vec3d dtheta = (R_before.inverse() * eskf.GetNominalState().R_).log();
+
+                                Mat18d cov_blocks = eskf.GetCov(), cov_dense = eskf.GetCov();
+                                auto t1 = std::chrono::steady_clock::now();
+                                sad::ESKFD::ProjectCovBlocks(cov_blocks, dtheta);
+                                auto t2 = std::chrono::steady_clock::now();
+                                sad::ESKFD::ProjectCovDense(cov_dense, dtheta);
+                                auto t3 = std::chrono::steady_clock::now();
+                                blocks_ns += std::chrono::duration<double, std::nano>(t2 - t1).count();
+                                dense_ns += std::chrono::duration<double, std::nano>(t3 - t2).count();
+
+                                double diff = (cov_blocks - cov_dense).cwiseAbs().maxCoeff() /
+                                              cov_dense.cwiseAbs().maxCoeff();
+                                max_diff = std::max(max_diff, diff);
+                                checked++;
+                            });
+
+    LOG(INFO) << "协方差投影检查 " << checked << " 次: 分块 " << std::fixed << std::setprecision(1)
+              << blocks_ns / std::max(checked, 1) << " ns/次, 稠密 " << dense_ns / std::max(checked, 1)
+              << " ns/次, 最大相对差异 " << std::scientific << std::setprecision(3) << max_diff;
+    return max_diff;
+}
+
+}  // namespace
+
+/// 本程序比较ESKF三种观测更新方式处理整个日志时每次更新的耗时(ns)与协方差的对称性
+/// 同时给出LDLT与逐个标量观测的最终状态与稠密求逆的差异，并逐次检查协方差投影的分块形式与稠密形式一致
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = google::INFO;
+    FLAGS_colorlogtostderr = true;
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    std::vector<sad::IMU> imus;
+    std::vector<sad::GNSS> gnss;
+    sad::TxtReader reader(FLAGS_txt_path, sad::TxtReadMode::MMAP,
+                          sad::Overloaded{[&](const sad::IMU& imu) { imus.push_back(imu); },
+                                          [&](const sad::GNSS& g) { gnss.push_back(g); }});
+    reader.Go();
+    if (imus.empty() || gnss.empty()) {
+        LOG(ERROR) << "未能从文件读取IMU/GNSS数据: " << FLAGS_txt_path;
+        return -1;
+    }
+
+    auto tables = sad::SensorTables::Create(imus, gnss);
+    sad::GNSSUTMTable utm_table;
+    if (!sad::ConvertGNSSTable2UTM(tables->gnss_, Vec2d::Zero(), 0.0, utm_table)) {
+        LOG(ERROR) << "GPS坐标转换失败";
+        return -1;
+    }
+    sad::SensorTimeline timeline;
+    timeline.Build(tables, 0.0);
+    LOG(INFO) << "IMU数据 " << tables->imu_.Size() << " 条, GNSS数据 " << tables->gnss_.Size() << " 条";
+
+    using UpdateMethod = sad::ESKFD::UpdateMethod;
+    std::vector<UpdateRunResult> results = {
+        Run(timeline, utm_table, UpdateMethod::DENSE, false, "dense"),
+        Run(timeline, utm_table, UpdateMethod::LDLT, false, "ldlt"),
+        Run(timeline, utm_table, UpdateMethod::SEQUENTIAL, false, "sequential"),
+        Run(timeline, utm_table, UpdateMethod::LDLT, true, "ldlt_packed"),
+        Run(timeline, utm_table, UpdateMethod::SEQUENTIAL, true, "seq_packed"),
+    };
+
+    const UpdateRunResult& dense = results.front();
+    for (const auto& r : results) {
+        LOG(INFO) << std::left << std::setw(12) << r.name_ << std::right << " 更新 " << r.updates_ << " 次: "
+                  << std::fixed << std::setprecision(1) << r.update_ns_ << " ns/次, 加速 " << std::setprecision(2)
+                  << dense.update_ns_ / r.update_ns_ << " 倍, 协方差最大相对不对称量 " << std::scientific
+                  << std::setprecision(3) << r.max_asymmetry_ << ", 最终位置与dense相差 "
+                  << (r.state_.p_ - dense.state_.p_).norm() << " m";
+    }
+
+    if (CheckProjection(timeline, utm_table) > FLAGS_projection_tolerance) {
+        LOG(ERROR) << "协方差投影的分块形式与稠密形式不一致";
+        return -1;
+    }
+    return 0;
+}
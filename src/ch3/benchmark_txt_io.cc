@@ -0,0 +1,213 @@
+//
+// TxtIO 读取吞吐量测试
+//
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+#include "common/io_utils.h"
+#include "common/timer/timer.h"
+#include "common/txt_reader.h"
+
+DEFINE_string(txt_path, "./data/ch3/10.txt", "数据文件路径");
+DEFINE_int32(repeat, 5, "每种读取方式重复次数");
+DEFINE_int32(threads, 0, "并行解析的线程数，0表示使用全部CPU核");
+
+namespace {
+
+/// 回调统计，用于校验不同读取方式输出一致
+/// 每类回调单独累加校验和：并行解析时不同类型的回调顺序会变化，但每类内部顺序不变
+struct CallbackStats {
+    size_t imu = 0, gnss = 0, odom = 0, nzz = 0, gps_timekey = 0, fbk = 0;
+    double imu_sum = 0, gnss_sum = 0, odom_sum = 0, nzz_sum = 0, gps_timekey_sum = 0, fbk_sum = 0;
+
+    bool operator==(const CallbackStats& o) const {
+        return imu == o.imu && gnss == o.gnss && odom == o.odom && nzz == o.nzz && gps_timekey == o.gps_timekey &&
+               fbk == o.fbk && imu_sum == o.imu_sum && gnss_sum == o.gnss_sum && odom_sum == o.odom_sum &&
+               nzz_sum == o.nzz_sum && gps_timekey_sum == o.gps_timekey_sum && fbk_sum == o.fbk_sum;
+    }
+
+    size_t Total() const { return imu + gnss + odom + nzz + gps_timekey + fbk; }
+
+    void Add(const sad::IMU& imu) {
+        this->imu++;
+        imu_sum += imu.timestamp_ + imu.gyro_.sum() + imu.acce_.sum();
+    }
+    void Add(const sad::GNSS& gnss) {
+        this->gnss++;
+        gnss_sum += gnss.unix_time_ + gnss.lat_lon_alt_.sum() + gnss.heading_;
+    }
+    void Add(const sad::Odom& odom) {
+        this->odom++;
+        odom_sum += odom.timestamp_ + odom.left_pulse_ + odom.right_pulse_;
+    }
+    void Add(const sad::NZZ& nzz) {
+        this->nzz++;
+        nzz_sum += nzz.heading_;
+    }
+    void Add(const sad::GPSWithTimeKey& gps) {
+        gps_timekey++;
+        gps_timekey_sum += gps.gnss_data_.unix_time_;
+    }
+    void Add(const sad::FBKPair& fbk) {
+        this->fbk++;
+        fbk_sum += fbk.flag_.timestamp_ + fbk.misalignment_.pitch_ + fbk.misalignment_.heading_;
+    }
+};
+
+/// TxtReader使用的处理器，回调在编译期绑定
+struct StatsHandler {
+    CallbackStats& stats_;
+
+    template <typename T>
+    void operator()(const T& data) const {
+        stats_.Add(data);
+    }
+};
+
+/// 一种读取方式
+struct ReadConfig {
+    std::string name;
+    sad::TxtReadMode mode;
+    int threads;
+    bool static_dispatch;  // true: TxtReader, false: TxtIO(std::function)
+};
+
+CallbackStats RunOnce(const ReadConfig& config) {
+    CallbackStats stats;
+    if (config.static_dispatch) {
+        sad::TxtReader reader(FLAGS_txt_path, config.mode, StatsHandler{stats});
+        reader.SetNumThreads(config.threads).Go();
+        return stats;
+    }
+
+    sad::TxtIO io(FLAGS_txt_path, config.mode);
+    io.SetNumThreads(config.threads)
+        .SetIMUProcessFunc([&](const sad::IMU& imu) { stats.Add(imu); })
+        .SetGNSSProcessFunc([&](const sad::GNSS& gnss) { stats.Add(gnss); })
+        .SetOdomProcessFunc([&](const sad::Odom& odom) { stats.Add(odom); })
+        .SetNZZProcessFunc([&](const sad::NZZ& nzz) { stats.Add(nzz); })
+        .SetGPSWithTimeKeyProcessFunc([&](const sad::GPSWithTimeKey& gps) { stats.Add(gps); })
+        .SetFBKPairProcessFunc([&](const sad::FBKPair& fbk) { stats.Add(fbk); })
+        .Go();
+    return stats;
+}
+
+/**
+ * 单独测量回调分派本身的开销：对已读入内存的IMU序列，分别经std::function与模板处理器逐条调用
+ * 返回每条记录的平均耗时(ns)
+ */
+void BenchmarkDispatch(const std::vector<sad::IMU>& imus, double& function_ns, double& static_ns) {
+    const int rounds = std::max(FLAGS_repeat, 1) * 10;
+
+    CallbackStats function_stats;
+    std::function<void(const sad::IMU&)> func = [&](const sad::IMU& imu) { function_stats.Add(imu); };
+    sad::common::Timer::Evaluate(
+        [&]() {
+            for (int r = 0; r < rounds; ++r) {
+                for (const auto& imu : imus) {
+                    func(imu);
+                }
+            }
+        },
+        "dispatch std::function");
+
+    CallbackStats static_stats;
+    StatsHandler handler{static_stats};
+    sad::common::Timer::Evaluate(
+        [&]() {
+            for (int r = 0; r < rounds; ++r) {
+                for (const auto& imu : imus) {
+                    handler(imu);
+                }
+            }
+        },
+        "dispatch static");
+
+    // 两种方式累加结果相同，同时防止循环被优化掉
+    if (!(function_stats == static_stats)) {
+        LOG(ERROR) << "两种分派方式累加结果不一致";
+    }
+
+    const double calls = static_cast<double>(rounds) * static_cast<double>(imus.size());
+    function_ns = sad::common::Timer::GetMeanTime("dispatch std::function") * 1e6 / calls;
+    static_ns = sad::common::Timer::GetMeanTime("dispatch static") * 1e6 / calls;
+}
+
+}  // namespace
+
+/// 本程序比较TxtIO不同读取方式的吞吐量(MB/s, 条/s)，并校验它们产生的回调一致
+/// *_tpl为以模板处理器读取的TxtReader，最后单独给出std::function与模板处理器逐条分派的开销
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = google::INFO;
+    FLAGS_colorlogtostderr = true;
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    struct stat st;
+    if (FLAGS_txt_path.empty() || stat(FLAGS_txt_path.c_str(), &st) != 0) {
+        LOG(ERROR) << "未能找到文件: " << FLAGS_txt_path;
+        return -1;
+    }
+    const double file_mb = static_cast<double>(st.st_size) / (1024.0 * 1024.0);
+
+    std::vector<ReadConfig> modes = {
+        {"stream", sad::TxtReadMode::STREAM, 1, false},
+        {"mmap", sad::TxtReadMode::MMAP, 1, false},
+        {"stream_tpl", sad::TxtReadMode::STREAM, 1, true},
+        {"mmap_tpl", sad::TxtReadMode::MMAP, 1, true},
+    };
+    int max_threads = FLAGS_threads > 0 ? FLAGS_threads : static_cast<int>(std::thread::hardware_concurrency());
+    for (int threads = 2; threads < max_threads; threads *= 2) {
+        modes.push_back({"mmap_x" + std::to_string(threads), sad::TxtReadMode::MMAP, threads, false});
+    }
+    if (max_threads > 1) {
+        modes.push_back({"mmap_x" + std::to_string(max_threads), sad::TxtReadMode::MMAP, max_threads, false});
+    }
+
+    std::vector<CallbackStats> results;
+    for (const auto& m : modes) {
+        CallbackStats stats;
+        for (int i = 0; i < FLAGS_repeat; ++i) {
+            sad::common::Timer::Evaluate([&]() { stats = RunOnce(m); }, "TxtIO " + m.name);
+        }
+        results.emplace_back(stats);
+    }
+
+    LOG(INFO) << "文件: " << FLAGS_txt_path << ", 大小: " << std::fixed << std::setprecision(1) << file_mb << " MB";
+    for (size_t i = 0; i < modes.size(); ++i) {
+        double ms = sad::common::Timer::GetMeanTime("TxtIO " + modes[i].name);
+        LOG(INFO) << std::left << std::setw(10) << modes[i].name << std::right << std::fixed << std::setprecision(1)
+                  << " 平均耗时: " << ms << " ms, 吞吐量: " << file_mb / (ms / 1000.0) << " MB/s, "
+                  << results[i].Total() / (ms / 1000.0) << " 条/s, 记录数: " << results[i].Total() << " (IMU=" << results[i].imu << ", GNSS=" << results[i].gnss
+                  << ", NZZ=" << results[i].nzz << ", FBK=" << results[i].fbk << ")";
+    }
+
+    bool consistent = true;
+    for (size_t i = 1; i < results.size(); ++i) {
+        if (!(results[i] == results[0])) {
+            LOG(ERROR) << modes[i].name << " 与 " << modes[0].name << " 的回调结果不一致";
+            consistent = false;
+        }
+    }
+    if (consistent) {
+        LOG(INFO) << "各读取方式回调结果一致";
+    }
+
+    std::vector<sad::IMU> imus;
+    sad::TxtReader reader(FLAGS_txt_path, sad::TxtReadMode::MMAP,
+                          sad::Overloaded{[&](const sad::IMU& imu) { imus.push_back(imu); }});
+    reader.Go();
+    double function_ns = 0, static_ns = 0;
+    BenchmarkDispatch(imus, function_ns, static_ns);
+    LOG(INFO) << "回调分派开销(" << imus.size() << "条IMU): std::function " << std::setprecision(2) << function_ns
+              << " ns/条, 模板处理器 " << static_ns << " ns/条";
+
+    return consistent ? 0 : -1;
+}
@@ -10,10 +10,16 @@
 #include "common/imu.h"
 #include "common/math_utils.h"
 #include "common/nav_state.h"
+#include "common/sym_packed_matrix.h"
 #include <fstream> 
 
 #include <glog/logging.h>
+#include <algorithm>
+#include <array>
 #include <iomanip>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 namespace sad {
 
@@ -34,20 +40,33 @@ struct FBKInstallationData {
  *
  * 本书使用18维的ESKF，标量类型可以由S指定，默认取double
  * 变量顺序：p, v, R, bg, ba, grav，与书本对应
+ * UTM坐标有数十万到数百万米，float的名义位置只能精确到分米，S取float时可以让PS取double，
+ * 即名义位置用double，其余名义状态、雅可比与协方差都用float的混合精度
  * @tparam S    状态变量的精度，取float或double
+ * @tparam PS   名义位置的精度，默认与S相同
  */
-template <typename S = double>
+template <typename S = double, typename PS = S>
 class ESKF {
    public:
     /// 类型定义
     using SO3 = Sophus::SO3<S>;                     // 旋转变量类型
     using VecT = Eigen::Matrix<S, 3, 1>;            // 向量类型
+    using PosT = Eigen::Matrix<PS, 3, 1>;           // 名义位置类型
     using Vec18T = Eigen::Matrix<S, 18, 1>;         // 18维向量类型
     using Mat3T = Eigen::Matrix<S, 3, 3>;           // 3x3矩阵类型
     using MotionNoiseT = Eigen::Matrix<S, 18, 18>;  // 运动噪声类型
     using GnssNoiseT = Eigen::Matrix<S, 6, 6>;      // GNSS噪声类型
     using Mat18T = Eigen::Matrix<S, 18, 18>;        // 18维方差类型
-    using NavStateT = NavState<S>;                  // 整体名义状态变量类型
+    using NavStateT = NavState<PS>;                  // 整体名义状态变量类型，与名义位置的精度相同
+    using PackedCovT = SymPackedMatrix<S, 18>;      // 按上三角紧凑存放的18维方差类型
+    using Row3T = Eigen::Matrix<S, 3, 18>;          // 方差中3x18行块类型
+
+    /// 观测更新的计算方式
+    enum class UpdateMethod {
+        DENSE,       // 构造稠密的H，对H * P * H^T + V求逆，P = (I - K * H) * P，默认
+        LDLT,        // 直接取P中被观测的行列，LDLT求解卡尔曼增益，对称的秩k更新P
+        SEQUENTIAL,  // 观测噪声为对角阵时逐个标量观测依次更新，不需要矩阵分解
+    };
 
     struct Options {
         Options() = default;
@@ -75,15 +94,27 @@ class ESKF {
         bool enable_time_compensation_ = false;  // 是否启用时间补偿
         double fixed_time_delay_ = 0.2;         // 固定时间延迟（秒，正值表示IMU滞后于GNSS）
 
+        /// 安装角参数
+        bool dynamic_installation_angles_ = false;  // 首个GNSS设置安装角后，IMU时间每越过一个FBK数据就切换到该数据的安装角
+
         /// 其他配置
+        bool dense_covariance_propagation_ = false;  // 是否用稠密的18x18矩阵乘法传播和投影协方差，用于验证分块计算
+        UpdateMethod update_method_ = UpdateMethod::DENSE;  // 观测更新的计算方式
+        bool packed_covariance_ = false;  // 协方差只按上三角存放171个元素，传播、投影和更新只写上三角
+        int batch_propagation_samples_ = 0;  // PredictBatch每递推多少个IMU传播一次协方差，0表示每批只传播一次
         bool update_bias_gyro_ = true;  // 是否更新陀螺bias
         bool update_bias_acce_ = true;  // 是否更新加计bias
+        std::string body_acce_path_ = "body_acce.txt";  // 车体系加速度输出文件，为空时不输出
     };
 
     /**
      * 初始零偏取零
      */
-    ESKF(Options option = Options()) : options_(option) { BuildNoise(option); BuildPhoneInstallMatrix(); }
+    ESKF(Options option = Options()) : options_(option) {
+        BuildNoise(option);
+        BuildPhoneInstallMatrix();
+        packed_cov_.SetIdentity();
+    }
 
     /**
      * 设置初始条件
@@ -100,12 +131,26 @@ class ESKF {
         ba_ = init_ba;
         g_ = gravity;
         cov_ = Mat18T::Identity() * 1e-4;
+        packed_cov_.SetIdentity(1e-4);
         BuildPhoneInstallMatrix();
     }
 
     /// 使用IMU递推
     bool Predict(const IMU& imu);
 
+    /**
+     * 成批使用IMU递推，通常为相邻两个GNSS之间的IMU
+     * 名义状态逐个IMU积分，误差状态的转移矩阵与过程噪声在子区间内累积，每个子区间只传播一次协方差，
+     * 子区间长度由batch_propagation_samples_指定。跳过IMU的规则与Predict相同
+     * 子区间的过程噪声包括bias随机游走对p, v, theta的影响，结果与逐个Predict相同（舍入误差除外）
+     * 名义状态积分占了递推的大部分耗时，每个IMU的耗时与分块传播的Predict相当，因此离线模式仍逐个Predict
+     * @param imus    按时间排序的IMU
+     * @param count   IMU个数
+     * @param states  不为空时依次追加每个成功递推的IMU之后的名义状态
+     * @return 成功递推的IMU个数
+     */
+    int PredictBatch(const IMU* imus, size_t count, std::vector<NavStateT>* states = nullptr);
+
     /// 使用GPS观测
     bool ObserveGps(const GNSS& gnss);
 
@@ -126,27 +171,60 @@ class ESKF {
 
     /// accessors
     /// 获取全量状态
-    NavStateT GetNominalState() const { return NavStateT(current_time_, R_, p_, v_, bg_, ba_); }
+    NavStateT GetNominalState() const {
+        return NavStateT(current_time_, CastSO3<PS>(R_), p_, v_.template cast<PS>(), bg_.template cast<PS>(),
+                         ba_.template cast<PS>());
+    }
 
     /// 获取SE3 状态
-    SE3 GetNominalSE3() const { return SE3(R_, p_); }
+    SE3 GetNominalSE3() const { return SE3(CastSO3<double>(R_), p_.template cast<double>()); }
 
     /// 设置状态X
     void SetX(const NavStated& x, const Vec3d& grav) {
         current_time_ = x.timestamp_;
-        R_ = x.R_;
-        p_ = x.p_;
-        v_ = x.v_;
-        bg_ = x.bg_;
-        ba_ = x.ba_;
-        g_ = grav;
+        R_ = CastSO3(x.R_);
+        p_ = x.p_.template cast<PS>();
+        v_ = x.v_.template cast<S>();
+        bg_ = x.bg_.template cast<S>();
+        ba_ = x.ba_.template cast<S>();
+        g_ = grav.template cast<S>();
     }
 
-    /// 设置协方差
-    void SetCov(const Mat18T& cov) { cov_ = cov; }
+    /// 设置协方差，紧凑存放时只取上三角
+    void SetCov(const Mat18T& cov) {
+        cov_ = cov;
+        packed_cov_.FromFull(cov);
+    }
+
+    /// 获取协方差
+    Mat18T GetCov() const { return options_.packed_covariance_ ? packed_cov_.Full() : cov_; }
+
+    /// 获取紧凑存放的协方差，只在packed_covariance_打开时有效，用于保存快照
+    const PackedCovT& GetPackedCov() const { return packed_cov_; }
+
+    /**
+     * 误差状态重置时的协方差投影，分块形式，参考式(3.63)
+     * J只在theta对theta处为G = I - 0.5 * hat(dtheta)，其余为单位阵，J * P * J^T只改变theta所在的三行三列：
+     * theta行块左乘G，theta列块取其转置，theta对theta块为G * P * G^T
+     */
+    static void ProjectCovBlocks(Mat18T& cov, const VecT& dtheta) {
+        const Mat3T G = Mat3T::Identity() - S(0.5) * SO3::hat(dtheta);
+        Eigen::Matrix<S, 3, 18> rows = G * cov.template middleRows<3>(6);
+        const Mat3T theta = rows.template middleCols<3>(6) * G.transpose();
+        rows.template middleCols<3>(6) = theta.template selfadjointView<Eigen::Upper>();
+        cov.template middleRows<3>(6) = rows;
+        cov.template middleCols<3>(6) = rows.transpose();
+    }
+
+    /// 协方差投影的稠密形式J * P * J^T，用于验证分块形式
+    static void ProjectCovDense(Mat18T& cov, const VecT& dtheta) {
+        Mat18T J = Mat18T::Identity();
+        J.template block<3, 3>(6, 6) = Mat3T::Identity() - S(0.5) * SO3::hat(dtheta);
+        cov = J * cov * J.transpose();
+    }
 
     /// 获取重力
-    Vec3d GetGravity() const { return g_; }
+    Vec3d GetGravity() const { return g_.template cast<double>(); }
 
     /// 获取当前时间补偿设置
     double GetTimeCompensation() const {
@@ -162,9 +240,38 @@ class ESKF {
                   << ", delay = " << delay << "s";
     }
 
-    /// 添加FBK安装角数据
+    /// 添加FBK安装角数据，按时间排序保存，按时间顺序添加时为O(1)
     void AddFBKData(double timestamp, double pitch, double heading) {
-        fbk_data_list_.emplace_back(timestamp, pitch, heading);
+        if (fbk_data_list_.empty() || fbk_data_list_.back().timestamp_ <= timestamp) {
+            fbk_data_list_.emplace_back(timestamp, pitch, heading);
+            return;
+        }
+
+        // 乱序到达时插入到时间相同的数据之后，已经越过的数据不再切换
+        auto iter = std::upper_bound(fbk_data_list_.begin(), fbk_data_list_.end(), timestamp,
+                                     [](double t, const FBKInstallationData& data) { return t < data.timestamp_; });
+        if (static_cast<size_t>(iter - fbk_data_list_.begin()) < next_fbk_index_) {
+            next_fbk_index_++;
+        }
+        fbk_data_list_.insert(iter, FBKInstallationData(timestamp, pitch, heading));
+    }
+
+    /// 时间最接近的FBK数据，二分查找，时间差相同时取较早的，没有数据时返回nullptr
+    const FBKInstallationData* FindNearestFBK(double timestamp) const {
+        if (fbk_data_list_.empty()) {
+            return nullptr;
+        }
+        auto iter = std::lower_bound(fbk_data_list_.begin(), fbk_data_list_.end(), timestamp,
+                                     [](const FBKInstallationData& data, double t) { return data.timestamp_ < t; });
+        if (iter == fbk_data_list_.end() ||
+            (iter != fbk_data_list_.begin() && timestamp - (iter - 1)->timestamp_ <= iter->timestamp_ - timestamp)) {
+            --iter;
+            // 时间相同的数据取最先添加的
+            while (iter != fbk_data_list_.begin() && (iter - 1)->timestamp_ == iter->timestamp_) {
+                --iter;
+            }
+        }
+        return &*iter;
     }
 
     /// 根据GPS时间戳自动设置安装角
@@ -180,34 +287,38 @@ class ESKF {
         }
         
         // 找到最接近GPS时间戳的FBK数据
-        double min_time_diff = std::numeric_limits<double>::max();
-        const FBKInstallationData* best_match = nullptr;
-        
-        for (const auto& fbk_data : fbk_data_list_) {
-            double time_diff = std::abs(fbk_data.timestamp_ - gps_timestamp);
-            if (time_diff < min_time_diff) {
-                min_time_diff = time_diff;
-                best_match = &fbk_data;
-            }
+        const FBKInstallationData* best_match = FindNearestFBK(gps_timestamp);
+        ApplyInstallationAngles(*best_match);
+        installation_angles_set_ = true;
+
+        // 之后的切换从GPS时间戳之后的FBK数据开始
+        next_fbk_index_ = std::upper_bound(fbk_data_list_.begin(), fbk_data_list_.end(), gps_timestamp,
+                                           [](double t, const FBKInstallationData& data) {
+                                               return t < data.timestamp_;
+                                           }) -
+                          fbk_data_list_.begin();
+
+        LOG(INFO) << "自动设置安装角 (GPS时间戳: " << gps_timestamp << "s):";
+        LOG(INFO) << "  最佳匹配FBK时间戳: " << best_match->timestamp_ << "s (时间差: "
+                  << std::abs(best_match->timestamp_ - gps_timestamp) << "s)";
+        LOG(INFO) << "  Pitch: " << best_match->pitch_ << "° (安装角: " << (90.0 + best_match->pitch_) << "°)";
+        LOG(INFO) << "  Heading: " << best_match->heading_ << "° (安装角: " << best_match->heading_ << "°)";
+    }
+
+    /// 启用dynamic_installation_angles_时，切换到时间不晚于timestamp的最新FBK数据，每个数据只访问一次
+    void UpdateInstallationAnglesByTime(double timestamp) {
+        if (!options_.dynamic_installation_angles_ || !installation_angles_set_) {
+            return;
         }
-        
-        if (best_match != nullptr) {
-            // 设置安装角参数
-            options_.phone_pitch_install_ = (90.0 + best_match->pitch_) * math::kDEG2RAD;
-            options_.phone_heading_install_ = best_match->heading_ * math::kDEG2RAD;
-            
-            // 重新构建安装角转换矩阵
-            BuildPhoneInstallMatrix();
-            
-            installation_angles_set_ = true;
-            
-            LOG(INFO) << "自动设置安装角 (GPS时间戳: " << gps_timestamp << "s):";
-            LOG(INFO) << "  最佳匹配FBK时间戳: " << best_match->timestamp_ << "s (时间差: " << min_time_diff << "s)";
-            LOG(INFO) << "  Pitch: " << best_match->pitch_ << "° (安装角: " << (90.0 + best_match->pitch_) << "°)";
-            LOG(INFO) << "  Heading: " << best_match->heading_ << "° (安装角: " << best_match->heading_ << "°)";
-        } else {
-            LOG(WARNING) << "未找到匹配的FBK数据，使用默认安装角";
-            installation_angles_set_ = true;
+        const size_t last_index = next_fbk_index_;
+        while (next_fbk_index_ < fbk_data_list_.size() && fbk_data_list_[next_fbk_index_].timestamp_ <= timestamp) {
+            next_fbk_index_++;
+        }
+        if (next_fbk_index_ != last_index) {
+            const auto& fbk_data = fbk_data_list_[next_fbk_index_ - 1];
+            ApplyInstallationAngles(fbk_data);
+            VLOG(1) << "切换安装角 (时间 " << timestamp << "s, FBK时间戳 " << fbk_data.timestamp_
+                    << "s): Pitch " << fbk_data.pitch_ << "°, Heading " << fbk_data.heading_ << "°";
         }
     }
 
@@ -216,7 +327,8 @@ class ESKF {
         
         // 保存18个对角元素
         for (int i = 0; i < 18; ++i) {
-            cov_file << std::setprecision(9) << cov_(i, i) << " ";
+            cov_file << std::setprecision(9) << (options_.packed_covariance_ ? packed_cov_.Diagonal(i) : cov_(i, i))
+                     << " ";
         }
         cov_file << std::endl;
     }
@@ -231,7 +343,7 @@ class ESKF {
         double dis_n = utm_residual.y(); // 北向残差
         return dis_e * cos(heading) - dis_n * sin(heading);
     }
-   private:
+   protected:
 
     void Euler2Cbn(double roll, double pitch, double heading, Mat3T &Cbn) {
         Mat3T C1, C2, C3, Cnb;
@@ -256,6 +368,13 @@ class ESKF {
         Cbn = Cnb.transpose();
     }
 
+    /// 使用FBK数据设置安装角参数并重新构建转换矩阵
+    void ApplyInstallationAngles(const FBKInstallationData& fbk_data) {
+        options_.phone_pitch_install_ = (90.0 + fbk_data.pitch_) * math::kDEG2RAD;
+        options_.phone_heading_install_ = fbk_data.heading_ * math::kDEG2RAD;
+        BuildPhoneInstallMatrix();
+    }
+
     void BuildPhoneInstallMatrix() {
         // 计算手机到车体的转换矩阵
         Euler2Cbn(options_.phone_roll_install_, 
@@ -266,11 +385,11 @@ class ESKF {
 
     IMU ApplyPhoneInstallCorrection (const IMU& imu) const {
         IMU corrected_imu = imu;
-        VecT body_acce = C_phone_to_body_ * imu.acce_;
-        VecT body_gyro = C_phone_to_body_ * imu.gyro_;
+        VecT body_acce = C_phone_to_body_ * imu.acce_.template cast<S>();
+        VecT body_gyro = C_phone_to_body_ * imu.gyro_.template cast<S>();
 
-        if (!body_acce_file_initialized_) {
-            body_acce_file_.open("body_acce.txt");
+        if (!body_acce_file_initialized_ && !options_.body_acce_path_.empty()) {
+            body_acce_file_.open(options_.body_acce_path_);
             if (body_acce_file_.is_open()) {
                 // 写入文件头
                 body_acce_file_ << "# timestamp acce_x acce_y acce_z (m/s²)" << std::endl;
@@ -288,8 +407,8 @@ class ESKF {
         }
 
 
-        corrected_imu.acce_ = body_acce;
-        corrected_imu.gyro_ = body_gyro;
+        corrected_imu.acce_ = body_acce.template cast<double>();
+        corrected_imu.gyro_ = body_gyro.template cast<double>();
 
         return corrected_imu;
     }
@@ -319,7 +438,7 @@ class ESKF {
     /// 更新名义状态变量，重置error state
     void UpdateAndReset() {
         //更新名义状态
-        p_ += dx_.template block<3, 1>(0, 0);
+        p_ += dx_.template block<3, 1>(0, 0).template cast<PS>();
         v_ += dx_.template block<3, 1>(3, 0);
         R_ = R_ * SO3::exp(dx_.template block<3, 1>(6, 0));
 
@@ -339,11 +458,408 @@ class ESKF {
         dx_.setZero();
     }
 
+    /**
+     * 按F的分块结构传播协方差，结果与F * cov_ * F^T + Q_相同（舍入误差除外）
+     * F是单位阵加上p对v, v对theta/ba/g, theta对theta/bg六个3x3块，后三个状态bg, ba, g的行是单位阵，因此：
+     * M = F * cov_只有前9行变化；新的cov_中右上9x18块就是M的右9列，左上9x9块是M * F^T的前9列，
+     * 左下由对称得到，右下不变，Q_是对角阵，最后只在对角线上加Q_
+     * @param A  v对theta的块
+     * @param B  v对ba的块
+     * @param E  theta对theta的块
+     */
+    void PropagateCovBlocks(const Mat3T& A, const Mat3T& B, const Mat3T& E, S dt) {
+        Eigen::Matrix<S, 9, 18> M;
+        Eigen::Matrix<S, 9, 9> X;
+        PropagateBlocks([this](int k) { return cov_.template middleRows<3>(3 * k); }, A, B, E, dt, M, X);
+
+        cov_.template topLeftCorner<9, 9>() = X.template selfadjointView<Eigen::Upper>();
+        cov_.template topRightCorner<9, 9>() = M.template rightCols<9>();
+        cov_.template bottomLeftCorner<9, 9>() = M.template rightCols<9>().transpose();
+        cov_.diagonal() += Q_.diagonal();
+    }
+
+    /**
+     * 紧凑存放时的分块传播，与PropagateCovBlocks相同，3x18的行块直接从紧凑存放中读出，不展开成完整矩阵；
+     * 只写前9行的上三角部分，右下块除对角线外不变
+     */
+    void PropagatePackedCov(const Mat3T& A, const Mat3T& B, const Mat3T& E, S dt) {
+        Row3T rows[6];
+        for (int k = 0; k < 6; ++k) {
+            packed_cov_.template Rows<3>(3 * k, rows[k]);
+        }
+
+        Eigen::Matrix<S, 9, 18> M;
+        Eigen::Matrix<S, 9, 9> X;
+        PropagateBlocks([&rows](int k) -> const Row3T& { return rows[k]; }, A, B, E, dt, M, X);
+
+        // 前9行：左9列为X的上三角，右9列为M的右9列
+        M.template leftCols<9>().template triangularView<Eigen::Upper>() = X;
+        packed_cov_.template SetUpperRows<9>(0, M);
+        packed_cov_.AddDiagonal(Q_.diagonal());
+    }
+
+    /**
+     * 分块传播的公共部分：M = F * P的前9行，X = M * F^T左上9x9块的上三角部分
+     * @param P  P(k)为P中从第3k行开始的3x18行块
+     */
+    template <typename RowBlock>
+    static void PropagateBlocks(const RowBlock& P, const Mat3T& A, const Mat3T& B, const Mat3T& E, S dt,
+                                Eigen::Matrix<S, 9, 18>& M, Eigen::Matrix<S, 9, 9>& X) {
+        // M = F * P的前9行
+        M.template topRows<3>() = P(0) + dt * P(1);
+        M.template middleRows<3>(3) = P(1) + A * P(2) + B * P(4) + dt * P(5);
+        M.template bottomRows<3>() = E * P(2) - dt * P(3);
+
+        // M * F^T的前9列，只算上三角部分的块
+        X.template block<3, 3>(0, 0) = M.template block<3, 3>(0, 0) + dt * M.template block<3, 3>(0, 3);
+        X.template block<6, 3>(0, 3) = M.template block<6, 3>(0, 3) + M.template block<6, 3>(0, 6) * A.transpose() +
+                                       M.template block<6, 3>(0, 12) * B.transpose() +
+                                       dt * M.template block<6, 3>(0, 15);
+        X.template block<9, 3>(0, 6) = M.template block<9, 3>(0, 6) * E.transpose() - dt * M.template block<9, 3>(0, 9);
+    }
+
+    /**
+     * 一个IMU的名义状态递推，并求出F中v对theta, v对ba, theta对theta三个块，Predict与PredictBatch共用
+     * @return false表示按时间间隔跳过了该IMU
+     */
+    bool IntegrateNominal(const IMU& imu, S& dt_s, Mat3T& A, Mat3T& B, Mat3T& E);
+
+    /// 开始新的子区间，累积的转移矩阵置为单位阵
+    void ResetBatchTransition() {
+        batch_phi_.setZero();
+        batch_phi_.template leftCols<9>().setIdentity();
+        batch_steps_.clear();
+    }
+
+    /**
+     * 把一个IMU的F左乘到子区间累积的转移矩阵Phi上，Phi的后9行始终是单位阵，只更新前9行：
+     * p行加上dt倍的v行，v行加上A乘theta行、ba行的B与g行的dt，theta行左乘E再减去dt倍的bg行
+     * 同时记下dt、c = A * R_prev^T与B，用于计算子区间的过程噪声
+     * @param R_prev  递推前的旋转
+     */
+    void AccumulateBatchTransition(const Mat3T& R_prev, const Mat3T& A, const Mat3T& B, const Mat3T& E, S dt) {
+        batch_phi_.template block<3, 15>(0, 3) += dt * batch_phi_.template block<3, 15>(3, 3);
+        batch_phi_.template block<3, 6>(3, 6) += A * batch_phi_.template block<3, 6>(6, 6);
+        batch_phi_.template block<3, 3>(3, 12) += B;
+        batch_phi_.template block<3, 3>(3, 15).diagonal().array() += dt;
+        batch_phi_.template block<3, 6>(6, 6) = (E * batch_phi_.template block<3, 6>(6, 6)).eval();
+        batch_phi_.template block<3, 3>(6, 9).diagonal().array() -= dt;
+        batch_steps_.push_back({dt, A * R_prev.transpose(), B});
+    }
+
+    /**
+     * 子区间内过程噪声传播到区间末尾的p, v, theta部分（9x9，只填上三角的块）及其与bg, ba的相关（9x6）
+     * 第k步的theta噪声在导航系下为u = R_k * w，各向同性，之后第j步对v的影响为c_j * u（E_j = R_j^T * R_{j-1}），
+     * 记T_k, C_k, D_k为第k步之后的dt之和、c之和以及c_i * T_i之和，则该噪声在区间末尾对p, v, theta的影响为
+     * D_k * u, C_k * u, R_n^T * u；v噪声对p, v的影响为T_k * w, w。
+     * 第k步的bias噪声w在之后的第i步进入导航系下的theta（bg）或v（ba），两者都是b_i * w（b_i = B_i = -R_i * dt_i），
+     * 因此bg噪声在区间末尾对p, v, theta的影响为sum(D_i * b_i), sum(C_i * b_i), R_n^T * sum(b_i)，
+     * ba噪声对p, v的影响为sum(T_i * b_i), sum(b_i)，求和都取i > k。
+     * 从后往前一遍累加即可得到各块，不必逐步传播18x18的噪声阵
+     */
+    void BatchProcessNoise(Eigen::Matrix<S, 9, 9>& noise, Eigen::Matrix<S, 9, 6>& bias_cross) const {
+        const S ev = Q_(3, 3), et = Q_(6, 6), eg = Q_(9, 9), ea = Q_(12, 12);
+        const S n = static_cast<S>(batch_steps_.size());
+        S T = 0, sum_T = 0, sum_TT = 0;
+        Mat3T C = Mat3T::Zero(), D = Mat3T::Zero();
+        Mat3T sum_C = Mat3T::Zero(), sum_D = Mat3T::Zero();
+        Mat3T sum_CC = Mat3T::Zero(), sum_CD = Mat3T::Zero(), sum_DD = Mat3T::Zero();
+
+        // bg噪声对p, v和导航系下theta的影响Gp, Gv, U，ba噪声对p的影响Hp（对v的影响也是U）
+        Mat3T Gp = Mat3T::Zero(), Gv = Mat3T::Zero(), U = Mat3T::Zero(), Hp = Mat3T::Zero();
+        Mat3T sum_Gp = Mat3T::Zero(), sum_Gv = Mat3T::Zero(), sum_U = Mat3T::Zero(), sum_Hp = Mat3T::Zero();
+        Mat3T sum_GpGp = Mat3T::Zero(), sum_GpGv = Mat3T::Zero(), sum_GpU = Mat3T::Zero();
+        Mat3T sum_GvGv = Mat3T::Zero(), sum_GvU = Mat3T::Zero(), sum_UU = Mat3T::Zero();
+        Mat3T sum_HpHp = Mat3T::Zero(), sum_HpU = Mat3T::Zero();
+        for (auto it = batch_steps_.rbegin(); it != batch_steps_.rend(); ++it) {
+            sum_T += T;
+            sum_TT += T * T;
+            sum_C += C;
+            sum_D += D;
+            sum_CC.noalias() += C * C.transpose();
+            sum_CD.noalias() += C * D.transpose();
+            sum_DD.noalias() += D * D.transpose();
+
+            sum_Gp += Gp;
+            sum_Gv += Gv;
+            sum_U += U;
+            sum_Hp += Hp;
+            sum_GpGp.noalias() += Gp * Gp.transpose();
+            sum_GpGv.noalias() += Gp * Gv.transpose();
+            sum_GpU.noalias() += Gp * U.transpose();
+            sum_GvGv.noalias() += Gv * Gv.transpose();
+            sum_GvU.noalias() += Gv * U.transpose();
+            sum_UU.noalias() += U * U.transpose();
+            sum_HpHp.noalias() += Hp * Hp.transpose();
+            sum_HpU.noalias() += Hp * U.transpose();
+
+            Gp.noalias() += D * it->b_;
+            Gv.noalias() += C * it->b_;
+            U += it->b_;
+            Hp += T * it->b_;
+
+            D += it->c_ * T;
+            C += it->c_;
+            T += it->dt_;
+        }
+
+        const Mat3T R = R_.matrix();
+        const Mat3T I = Mat3T::Identity();
+        noise.template block<3, 3>(0, 0) = ev * sum_TT * I + et * sum_DD + eg * sum_GpGp + ea * sum_HpHp;
+        noise.template block<3, 3>(0, 3) = ev * sum_T * I + et * sum_CD.transpose() + eg * sum_GpGv + ea * sum_HpU;
+        noise.template block<3, 3>(0, 6) = (et * sum_D + eg * sum_GpU) * R;
+        noise.template block<3, 3>(3, 3) = ev * n * I + et * sum_CC + eg * sum_GvGv + ea * sum_UU;
+        noise.template block<3, 3>(3, 6) = (et * sum_C + eg * sum_GvU) * R;
+        noise.template block<3, 3>(6, 6) = et * n * I + eg * R.transpose() * sum_UU * R;
+
+        bias_cross.template block<3, 3>(0, 0) = eg * sum_Gp;
+        bias_cross.template block<3, 3>(0, 3) = ea * sum_Hp;
+        bias_cross.template block<3, 3>(3, 0) = eg * sum_Gv;
+        bias_cross.template block<3, 3>(3, 3) = ea * sum_U;
+        bias_cross.template block<3, 3>(6, 0) = eg * R.transpose() * sum_U;
+        bias_cross.template block<3, 3>(6, 3).setZero();
+    }
+
+    /// 用累积的转移矩阵与过程噪声传播一次协方差，P = Phi * P * Phi^T + Q_batch，然后开始新的子区间
+    void PropagateBatchCov() {
+        Eigen::Matrix<S, 9, 9> noise;
+        Eigen::Matrix<S, 9, 6> bias_cross;
+        BatchProcessNoise(noise, bias_cross);
+        Vec18T bias_noise = Vec18T::Zero();
+        bias_noise.template segment<6>(9) =
+            static_cast<S>(batch_steps_.size()) * Q_.diagonal().template segment<6>(9);
+
+        if (options_.dense_covariance_propagation_) {
+            Mat18T Phi = Mat18T::Identity();
+            Phi.template topRows<9>() = batch_phi_;
+            Mat18T Qb = bias_noise.asDiagonal();
+            Qb.template topLeftCorner<9, 9>() = noise.template selfadjointView<Eigen::Upper>();
+            Qb.template block<9, 6>(0, 9) = bias_cross;
+            Qb.template block<6, 9>(9, 0) = bias_cross.transpose();
+
+            if (options_.packed_covariance_) {
+                cov_ = packed_cov_.Full();
+            }
+            cov_ = Phi * cov_.eval() * Phi.transpose() + Qb;
+            if (options_.packed_covariance_) {
+                packed_cov_.FromFull(cov_);
+            }
+            ResetBatchTransition();
+            return;
+        }
+
+        Eigen::Matrix<S, 9, 9> X;
+        if (options_.packed_covariance_) {
+            Row3T rows[6];
+            for (int k = 0; k < 6; ++k) {
+                packed_cov_.template Rows<3>(3 * k, rows[k]);
+            }
+            Eigen::Matrix<S, 9, 18> Gt;
+            PropagateTransitionRows(rows, batch_phi_, Gt, X);
+            Gt.template block<9, 6>(0, 9) += bias_cross;
+
+            // 前9行：左9列为X加上噪声的上三角，右9列为G^T的右9列
+            Gt.template leftCols<9>().template triangularView<Eigen::Upper>() = X + noise;
+            packed_cov_.template SetUpperRows<9>(0, Gt);
+            packed_cov_.AddDiagonal(bias_noise);
+            ResetBatchTransition();
+            return;
+        }
+
+        Eigen::Matrix<S, 18, 9> G;
+        PropagateTransition(cov_, batch_phi_, G, X);
+        X.template block<3, 3>(0, 0) += noise.template block<3, 3>(0, 0);
+        X.template block<6, 3>(0, 3) += noise.template block<6, 3>(0, 3);
+        X.template block<9, 3>(0, 6) += noise.template block<9, 3>(0, 6);
+        G.template block<6, 9>(9, 0) += bias_cross.transpose();
+
+        cov_.template topLeftCorner<9, 9>() = X.template selfadjointView<Eigen::Upper>();
+        cov_.template topRightCorner<9, 9>() = G.template bottomRows<9>().transpose();
+        cov_.template bottomLeftCorner<9, 9>() = G.template bottomRows<9>();
+        cov_.diagonal() += bias_noise;
+        ResetBatchTransition();
+    }
+
+    /**
+     * P = Phi * P * Phi^T的分块计算，只需要Phi的前9行phi：
+     * G = P * phi^T (18x9)，新的P中右上9x9块为G下9行的转置，左上9x9块为phi * G，只取上三角
+     * 矩阵都按列存放，G与phi * G都逐列计算，向量化沿着长度为18和9的列进行；phi中已知为零的块不参与计算：
+     * p行从v列开始，v行从theta列开始，theta行只有theta, bg两列
+     */
+    static void PropagateTransition(const Mat18T& P, const Eigen::Matrix<S, 9, 18>& phi, Eigen::Matrix<S, 18, 9>& G,
+                                    Eigen::Matrix<S, 9, 9>& X) {
+        // 矩阵都很小，用lazyProduct逐元素计算，避免走通用的矩阵乘法分块路径
+        G.template leftCols<3>() = P.template leftCols<3>() +
+                                   P.template rightCols<15>().lazyProduct(phi.template block<3, 15>(0, 3).transpose());
+        G.template middleCols<3>(3) = P.template middleCols<3>(3) +
+                                      P.template rightCols<12>().lazyProduct(phi.template block<3, 12>(3, 6).transpose());
+        G.template rightCols<3>() = P.template middleCols<6>(6).lazyProduct(phi.template block<3, 6>(6, 6).transpose());
+
+        X.template block<3, 3>(0, 0) =
+            G.template block<3, 3>(0, 0) + phi.template block<3, 15>(0, 3).lazyProduct(G.template block<15, 3>(3, 0));
+        X.template block<6, 3>(0, 3) = phi.template block<6, 15>(0, 3).lazyProduct(G.template block<15, 3>(3, 3));
+        X.template block<3, 3>(0, 3) += G.template block<3, 3>(0, 3);
+        X.template rightCols<3>() = phi.lazyProduct(G.template rightCols<3>());
+    }
+
+    /**
+     * 紧凑存放时的PropagateTransition，按P的3x18行块计算，不展开成完整矩阵：
+     * Gt = phi * P即G^T (9x18)，左上9x9块为Gt * phi^T，只取上三角；phi中已知为零的块同样跳过
+     */
+    static void PropagateTransitionRows(const Row3T (&P)[6], const Eigen::Matrix<S, 9, 18>& phi,
+                                        Eigen::Matrix<S, 9, 18>& Gt, Eigen::Matrix<S, 9, 9>& X) {
+        Gt.template topRows<3>() = P[0];
+        Gt.template middleRows<3>(3) = P[1];
+        for (int k = 1; k < 6; ++k) {
+            Gt.template topRows<3>().noalias() += phi.template block<3, 3>(0, 3 * k) * P[k];
+        }
+        for (int k = 2; k < 6; ++k) {
+            Gt.template middleRows<3>(3).noalias() += phi.template block<3, 3>(3, 3 * k) * P[k];
+        }
+        Gt.template bottomRows<3>() =
+            phi.template block<3, 3>(6, 6) * P[2] + phi.template block<3, 3>(6, 9) * P[3];
+
+        X.template block<3, 3>(0, 0) =
+            Gt.template block<3, 3>(0, 0) +
+            Gt.template block<3, 15>(0, 3).lazyProduct(phi.template block<3, 15>(0, 3).transpose());
+        X.template block<6, 3>(0, 3) =
+            Gt.template block<6, 15>(0, 3).lazyProduct(phi.template block<3, 15>(3, 3).transpose());
+        X.template rightCols<3>() = Gt.template middleCols<6>(6).lazyProduct(phi.template block<3, 6>(6, 6).transpose());
+    }
+
+    /// 旋转转为T精度（默认为S），SO3::cast会重新归一化四元数，精度相同时直接返回
+    template <typename T = S, typename From>
+    static Sophus::SO3<T> CastSO3(const Sophus::SO3<From>& R) {
+        if constexpr (std::is_same<T, From>::value) {
+            return R;
+        } else {
+            return R.template cast<T>();
+        }
+    }
+
+    /**
+     * 观测矩阵H每行只在一个状态上为1时的观测更新，V为对角阵，结果存入dx_与cov_
+     * @param index  每个观测对应的误差状态下标，即H中为1的列
+     * @param innov  观测残差
+     * @param noise  V的对角线
+     */
+    template <int N>
+    void UpdateSelected(const std::array<int, N>& index, const Eigen::Matrix<S, N, 1>& innov,
+                        const Eigen::Matrix<S, N, 1>& noise) {
+        using MatNT = Eigen::Matrix<S, N, N>;
+        using Mat18xNT = Eigen::Matrix<S, 18, N>;
+
+        if (options_.packed_covariance_) {
+            UpdateSelectedPacked<N>(index, innov, noise);
+            return;
+        }
+
+        if (options_.update_method_ == UpdateMethod::DENSE) {
+            Eigen::Matrix<S, N, 18> H = Eigen::Matrix<S, N, 18>::Zero();
+            for (int i = 0; i < N; ++i) {
+                H(i, index[i]) = 1;
+            }
+            MatNT V = noise.asDiagonal();
+            Mat18xNT K = cov_ * H.transpose() * (H * cov_ * H.transpose() + V).inverse();
+            dx_ = K * innov;
+            cov_ = (Mat18T::Identity() - K * H) * cov_;
+            return;
+        }
+
+        if (options_.update_method_ == UpdateMethod::SEQUENTIAL) {
+            // 第j个状态的标量观测：s = P(j, j) + v, k = P(:, j) / s, dx += k * (z - dx(j)), P -= P(:, j) * P(:, j)^T / s
+            // 循环中只更新cov_的下三角
+            dx_.setZero();
+            for (int i = 0; i < N; ++i) {
+                const int j = index[i];
+                Vec18T c;
+                c.head(j) = cov_.row(j).head(j).transpose();
+                c.tail(18 - j) = cov_.col(j).tail(18 - j);
+                const S s = c[j] + noise[i];
+                dx_ += c * ((innov[i] - dx_[j]) / s);
+                cov_.template selfadjointView<Eigen::Lower>().rankUpdate(c, -1 / s);
+            }
+            cov_.template triangularView<Eigen::StrictlyUpper>() = cov_.transpose();
+            return;
+        }
+
+        // P * H^T是P中被观测的列，H * P * H^T + V是这些列中被观测的行加上V
+        Mat18xNT PHt;
+        for (int i = 0; i < N; ++i) {
+            PHt.col(i) = cov_.col(index[i]);
+        }
+        MatNT innov_cov;
+        for (int i = 0; i < N; ++i) {
+            innov_cov.row(i) = PHt.row(index[i]);
+        }
+        innov_cov.diagonal() += noise;
+
+        // K = P * H^T * (H * P * H^T + V)^-1，H * P * H^T + V对称正定，用LDLT求解代替求逆
+        const Mat18xNT K = innov_cov.ldlt().solve(PHt.transpose()).transpose();
+        dx_ = K * innov;
+
+        // (I - K * H) * P = P - K * (P * H^T)^T是对称阵的秩k更新，只算下三角再复制到上三角，保持严格对称
+        cov_.template triangularView<Eigen::Lower>() -= K * PHt.transpose();
+        cov_.template triangularView<Eigen::StrictlyUpper>() = cov_.transpose();
+    }
+
+    /// 紧凑存放时的UpdateSelected，三种方式都直接读写紧凑存放的上三角，不展开成完整矩阵
+    template <int N>
+    void UpdateSelectedPacked(const std::array<int, N>& index, const Eigen::Matrix<S, N, 1>& innov,
+                              const Eigen::Matrix<S, N, 1>& noise) {
+        if (options_.update_method_ == UpdateMethod::SEQUENTIAL) {
+            dx_.setZero();
+            for (int i = 0; i < N; ++i) {
+                const int j = index[i];
+                const Vec18T c = packed_cov_.Col(j);
+                const S s = c[j] + noise[i];
+                dx_ += c * ((innov[i] - dx_[j]) / s);
+                packed_cov_.RankUpdate(c, -1 / s);
+            }
+            return;
+        }
+
+        Eigen::Matrix<S, 18, N> PHt;
+        for (int i = 0; i < N; ++i) {
+            PHt.col(i) = packed_cov_.Col(index[i]);
+        }
+        Eigen::Matrix<S, N, N> innov_cov;
+        for (int i = 0; i < N; ++i) {
+            innov_cov.row(i) = PHt.row(index[i]);
+        }
+        innov_cov.diagonal() += noise;
+
+        // DENSE与完整矩阵时一样对H * P * H^T + V直接求逆，(I - K * H) * P = P - K * (P * H^T)^T
+        const Eigen::Matrix<S, 18, N> K = options_.update_method_ == UpdateMethod::DENSE
+                                              ? Eigen::Matrix<S, 18, N>(PHt * innov_cov.inverse())
+                                              : Eigen::Matrix<S, 18, N>(innov_cov.ldlt().solve(PHt.transpose()).transpose());
+        dx_ = K * innov;
+        packed_cov_.SubtractProduct(K, PHt);
+    }
+
+    /**
+     * 紧凑存放时的投影：J只在theta对theta处为G = I - 0.5 * hat(dtheta)，其余为单位阵，
+     * 因此只有theta所在的行和列变化：上方的列块右乘G^T，theta对theta块为G * P * G^T，右方的行块左乘G
+     */
+    void ProjectPackedCov() {
+        const Mat3T G = Mat3T::Identity() - S(0.5) * SO3::hat(dx_.template block<3, 1>(6, 0));
+        packed_cov_.SetBlock(0, 6, packed_cov_.template Block<6, 3>(0, 6) * G.transpose());
+        packed_cov_.SetBlock(6, 6, G * packed_cov_.template Block<3, 3>(6, 6) * G.transpose());
+        packed_cov_.SetBlock(6, 9, G * packed_cov_.template Block<3, 9>(6, 9));
+    }
+
     /// 对P阵进行投影，参考式(3.63)
     void ProjectCov() {
-        Mat18T J = Mat18T::Identity();
-        J.template block<3, 3>(6, 6) = Mat3T::Identity() - 0.5 * SO3::hat(dx_.template block<3, 1>(6, 0));
-        cov_ = J * cov_ * J.transpose();
+        if (options_.packed_covariance_) {
+            ProjectPackedCov();
+            return;
+        }
+
+        if (options_.dense_covariance_propagation_) {
+            ProjectCovDense(cov_, dx_.template block<3, 1>(6, 0));
+        } else {
+            ProjectCovBlocks(cov_, dx_.template block<3, 1>(6, 0));
+        }
     }
 
     IMU ApplyTimeCompensation(const IMU& imu) const {
@@ -362,7 +878,7 @@ class ESKF {
     double current_time_ = 0.0;  // 当前时间
 
     /// 名义状态
-    VecT p_ = VecT::Zero();
+    PosT p_ = PosT::Zero();
     VecT v_ = VecT::Zero();
     SO3 R_;
     VecT bg_ = VecT::Zero();
@@ -372,8 +888,18 @@ class ESKF {
     /// 误差状态
     Vec18T dx_ = Vec18T::Zero();
 
-    /// 协方差阵
+    /// 协方差阵，packed_covariance_打开时使用packed_cov_，稠密验证路径临时展开到cov_
     Mat18T cov_ = Mat18T::Identity();
+    PackedCovT packed_cov_;
+
+    /// PredictBatch当前子区间累积的误差状态转移
+    struct BatchStep {
+        S dt_;     // IMU间隔
+        Mat3T c_;  // A * R_prev^T，导航系下的theta噪声对v的影响
+        Mat3T b_;  // B = -R * dt，bias噪声对v及导航系下theta的影响
+    };
+    Eigen::Matrix<S, 9, 18> batch_phi_;  // 子区间内各F的乘积的前9行，后9行为单位阵
+    std::vector<BatchStep> batch_steps_;
 
     /// 噪声阵
     MotionNoiseT Q_ = MotionNoiseT::Zero();
@@ -388,8 +914,9 @@ class ESKF {
     Options options_;
 
     /// FBK安装角数据存储
-    std::vector<FBKInstallationData> fbk_data_list_;  // 存储所有FBK数据
-    bool installation_angles_set_;                     // 安装角是否已设置
+    std::vector<FBKInstallationData> fbk_data_list_;  // 存储所有FBK数据，按时间排序
+    bool installation_angles_set_ = false;             // 安装角是否已设置
+    size_t next_fbk_index_ = 0;                        // 下一个待切换的FBK数据
 
     mutable std::ofstream body_acce_file_;  // 使用mutable因为ApplyPhoneInstallCorrection是const函数
     mutable bool body_acce_file_initialized_ = false;
@@ -397,11 +924,15 @@ class ESKF {
 
 using ESKFD = ESKF<double>;
 using ESKFF = ESKF<float>;
+using ESKFMixed = ESKF<float, double>;  // 名义位置double，其余float
 
-template <typename S>
-bool ESKF<S>::Predict(const IMU& imu) {
+template <typename S, typename PS>
+bool ESKF<S, PS>::IntegrateNominal(const IMU& imu, S& dt_s, Mat3T& A, Mat3T& B, Mat3T& E) {
     // assert(imu.timestamp_ >= current_time_);
 
+    // 随时间切换安装角
+    UpdateInstallationAnglesByTime(imu.timestamp_);
+
     //应用手机安装角补偿
     IMU corrected_imu = ApplyPhoneInstallCorrection(imu);
 
@@ -424,9 +955,18 @@ bool ESKF<S>::Predict(const IMU& imu) {
     }
 
     // nominal state 递推
-    VecT new_p = p_ + v_ * dt + 0.5 * (R_ * (compensated_imu.acce_ - ba_)) * dt * dt + 0.5 * g_ * dt * dt;
-    VecT new_v = v_ + R_ * (compensated_imu.acce_ - ba_) * dt + g_ * dt;
-    SO3 new_R = R_ * SO3::exp((compensated_imu.gyro_ - bg_) * dt);
+    dt_s = static_cast<S>(dt);
+    const VecT acce = compensated_imu.acce_.template cast<S>() - ba_;
+    const VecT gyro = compensated_imu.gyro_.template cast<S>() - bg_;
+    PosT new_p;
+    if constexpr (std::is_same<PS, S>::value) {
+        new_p = p_ + v_ * dt_s + S(0.5) * (R_ * acce) * dt_s * dt_s + S(0.5) * g_ * dt_s * dt_s;
+    } else {
+        // 混合精度时位移量很小，用S计算后再加到高精度的位置上
+        new_p = p_ + (v_ * dt_s + S(0.5) * (R_ * acce) * dt_s * dt_s + S(0.5) * g_ * dt_s * dt_s).template cast<PS>();
+    }
+    VecT new_v = v_ + R_ * acce * dt_s + g_ * dt_s;
+    SO3 new_R = R_ * SO3::exp(gyro * dt_s);
 
     //状态更新
     R_ = new_R;
@@ -435,26 +975,85 @@ bool ESKF<S>::Predict(const IMU& imu) {
     // 其余状态维度不变
 
     // error state 递推
-    // 计算运动过程雅可比矩阵 F，见(3.47)
-    // F实际上是稀疏矩阵，也可以不用矩阵形式进行相乘而是写成散装形式，这里为了教学方便，使用矩阵形式
-    Mat18T F = Mat18T::Identity();                                                 // 主对角线
-    F.template block<3, 3>(0, 3) = Mat3T::Identity() * dt;                         // p 对 v
-    F.template block<3, 3>(3, 6) = -R_.matrix() * SO3::hat(compensated_imu.acce_ - ba_) * dt;  // v对theta
-    F.template block<3, 3>(3, 12) = -R_.matrix() * dt;                             // v 对 ba
-    F.template block<3, 3>(3, 15) = Mat3T::Identity() * dt;                        // v 对 g
-    F.template block<3, 3>(6, 6) = SO3::exp(-(compensated_imu.gyro_ - bg_) * dt).matrix();     // theta 对 theta
-    F.template block<3, 3>(6, 9) = -Mat3T::Identity() * dt;                        // theta 对 bg
-
-    // mean and cov prediction
-    dx_ = F * dx_;  // 这行其实没必要算，dx_在重置之后应该为零，因此这步可以跳过，但F需要参与Cov部分计算，所以保留
-    cov_ = F * cov_.eval() * F.transpose() + Q_; //协方差传播
+    // 计算运动过程雅可比矩阵 F，见(3.47)，F除对角线外只有以下六个非零块
+    A = -R_.matrix() * SO3::hat(acce) * dt_s;   // v对theta
+    B = -R_.matrix() * dt_s;                     // v 对 ba
+    E = SO3::exp(-gyro * dt_s).matrix();         // theta 对 theta
     current_time_ = compensated_imu.timestamp_;
     return true;
 }
 
+template <typename S, typename PS>
+bool ESKF<S, PS>::Predict(const IMU& imu) {
+    S dt_s;
+    Mat3T A, B, E;
+    if (!IntegrateNominal(imu, dt_s, A, B, E)) {
+        return false;
+    }
+
+    if (options_.dense_covariance_propagation_) {
+        // 稠密矩阵形式，便于对照公式，用于验证分块传播
+        Mat18T F = Mat18T::Identity();                                 // 主对角线
+        F.template block<3, 3>(0, 3) = Mat3T::Identity() * dt_s;       // p 对 v
+        F.template block<3, 3>(3, 6) = A;                              // v对theta
+        F.template block<3, 3>(3, 12) = B;                             // v 对 ba
+        F.template block<3, 3>(3, 15) = Mat3T::Identity() * dt_s;      // v 对 g
+        F.template block<3, 3>(6, 6) = E;                              // theta 对 theta
+        F.template block<3, 3>(6, 9) = -Mat3T::Identity() * dt_s;      // theta 对 bg
+
+        // mean and cov prediction
+        if (options_.packed_covariance_) {
+            cov_ = packed_cov_.Full();
+        }
+        dx_ = F * dx_;  // 这行其实没必要算，dx_在重置之后应该为零
+        cov_ = F * cov_.eval() * F.transpose() + Q_; //协方差传播
+        if (options_.packed_covariance_) {
+            packed_cov_.FromFull(cov_);
+        }
+    } else if (options_.packed_covariance_) {
+        PropagatePackedCov(A, B, E, dt_s);
+    } else {
+        // dx_在重置之后为零，F * dx_仍为零，不必计算
+        PropagateCovBlocks(A, B, E, dt_s);
+    }
+    return true;
+}
+
+template <typename S, typename PS>
+int ESKF<S, PS>::PredictBatch(const IMU* imus, size_t count, std::vector<NavStateT>* states) {
+    const size_t interval = options_.batch_propagation_samples_ > 0
+                                ? static_cast<size_t>(options_.batch_propagation_samples_)
+                                : count;
+    ResetBatchTransition();
+
+    int predicted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Mat3T R_prev = R_.matrix();
+        S dt_s;
+        Mat3T A, B, E;
+        if (!IntegrateNominal(imus[i], dt_s, A, B, E)) {
+            continue;
+        }
+
+        AccumulateBatchTransition(R_prev, A, B, E, dt_s);
+        predicted++;
+        if (states != nullptr) {
+            states->emplace_back(GetNominalState());
+        }
+        if (batch_steps_.size() >= interval) {
+            PropagateBatchCov();
+        }
+    }
+
+    if (!batch_steps_.empty()) {
+        PropagateBatchCov();
+    }
+    return predicted;
+}
+
 
-template <typename S>
-bool ESKF<S>::ObserveGps(const GNSS& gnss) {
+template <typename S, typename PS>
+bool ESKF<S, PS>::ObserveGps(const GNSS& gnss) {
     /// GNSS 观测的修正 观测更新
     
     // const double TIME_TOLERANCE = 0.2;
@@ -474,8 +1073,8 @@ bool ESKF<S>::ObserveGps(const GNSS& gnss) {
         
         LOG(INFO) << "ESKF初始航向: " << initial_yaw_deg << "°";
 
-        R_ = gnss.utm_pose_.so3();
-        p_ = gnss.utm_pose_.translation();
+        R_ = CastSO3(gnss.utm_pose_.so3());
+        p_ = gnss.utm_pose_.translation().template cast<PS>();
         first_gnss_ = false;
         current_time_ = gnss.unix_time_;
         return true;
@@ -491,8 +1090,8 @@ bool ESKF<S>::ObserveGps(const GNSS& gnss) {
     return true;
 }
 
-template <typename S>
-bool ESKF<S>::ObservePositionOnly(const GNSS& gnss) {
+template <typename S, typename PS>
+bool ESKF<S, PS>::ObservePositionOnly(const GNSS& gnss) {
     /// 仅位置观测，不观测航向
     
     //首次GNSS的话直接设置初始位姿
@@ -504,8 +1103,8 @@ bool ESKF<S>::ObservePositionOnly(const GNSS& gnss) {
         
         LOG(INFO) << "ESKF初始航向: " << initial_yaw_deg << "°";
 
-        R_ = gnss.utm_pose_.so3();
-        p_ = gnss.utm_pose_.translation();
+        R_ = CastSO3(gnss.utm_pose_.so3());
+        p_ = gnss.utm_pose_.translation().template cast<PS>();
         first_gnss_ = false;
         current_time_ = gnss.unix_time_;
         return true;
@@ -517,68 +1116,44 @@ bool ESKF<S>::ObservePositionOnly(const GNSS& gnss) {
 }
 
 
-template <typename S>
-bool ESKF<S>::ObserveSE3(const SE3& pose, double trans_noise, double ang_noise) {
+template <typename S, typename PS>
+bool ESKF<S, PS>::ObserveSE3(const SE3& pose, double trans_noise, double ang_noise) {
     /// 既有旋转，也有平移
-    /// 观测状态变量中的p, R，H为6x18，其余为零
-
-    //1. 观测模型雅可比矩阵H
-    Eigen::Matrix<S, 6, 18> H = Eigen::Matrix<S, 6, 18>::Zero();
-    H.template block<3, 3>(0, 0) = Mat3T::Identity();  // P部分
-    H.template block<3, 3>(3, 6) = Mat3T::Identity();  // R部分（3.66)
+    /// 观测状态变量中的p, R，H为6x18，P部分与R部分(3.66)为单位阵，其余为零
 
-    // 卡尔曼增益和更新过程
-    //2. 观测噪声协方差矩阵R
-    Vec6d noise_vec;
+    //1. 观测噪声协方差矩阵V的对角线
+    Eigen::Matrix<S, 6, 1> noise_vec;
     noise_vec << trans_noise, trans_noise, trans_noise, ang_noise, ang_noise, ang_noise;
 
-    Mat6d V = noise_vec.asDiagonal();
-    
-    //3. 卡尔曼增益计算K
-    Eigen::Matrix<S, 18, 6> K = cov_ * H.transpose() * (H * cov_ * H.transpose() + V).inverse();
+    //2. 观测残差计算
+    Eigen::Matrix<S, 6, 1> innov = Eigen::Matrix<S, 6, 1>::Zero();
+    innov.template head<3>() = (pose.translation().template cast<PS>() - p_).template cast<S>();  // 平移部分
+    innov.template tail<3>() = (R_.inverse() * CastSO3(pose.so3())).log();  // 旋转部分(3.67)
 
-    // 更新x和cov
-    
-    //4. 观测残差计算
-    Vec6d innov = Vec6d::Zero();
-    innov.template head<3>() = (pose.translation() - p_);          // 平移部分
-    innov.template tail<3>() = (R_.inverse() * pose.so3()).log();  // 旋转部分(3.67)
-    
     //清除对横滚roll、俯仰pitch的观测残差
     innov[3] = 0.0;
     innov[4] = 0.0;
 
-    //5. 状态更新
-    dx_ = K * innov;
-    cov_ = (Mat18T::Identity() - K * H) * cov_;
+    //3. 卡尔曼增益与状态、协方差更新
+    UpdateSelected<6>({0, 1, 2, 6, 7, 8}, innov, noise_vec);
 
     UpdateAndReset();
     return true;
 }
 
-template <typename S>
-bool ESKF<S>::ObservePositionOnly(const SE3& pose, double trans_noise) {
-    /// 仅观测位置，H为3x18矩阵
-    
-    //1. 观测模型雅可比矩阵H - 只有位置部分
-    Eigen::Matrix<S, 3, 18> H = Eigen::Matrix<S, 3, 18>::Zero();
-    H.template block<3, 3>(0, 0) = Mat3T::Identity();  // 只有P部分
+template <typename S, typename PS>
+bool ESKF<S, PS>::ObservePositionOnly(const SE3& pose, double trans_noise) {
+    /// 仅观测位置，H为3x18矩阵，只有P部分为单位阵
 
-    // 卡尔曼增益和更新过程
-    //2. 观测噪声协方差矩阵R - 只有位置噪声
-    Vec3d noise_vec;
+    //1. 观测噪声协方差矩阵V的对角线 - 只有位置噪声
+    Eigen::Matrix<S, 3, 1> noise_vec;
     noise_vec << trans_noise, trans_noise, trans_noise;
-    Mat3T V = noise_vec.asDiagonal();
-    
-    //3. 卡尔曼增益计算K
-    Eigen::Matrix<S, 18, 3> K = cov_ * H.transpose() * (H * cov_ * H.transpose() + V).inverse();
 
-    //4. 观测残差计算 - 只有位置部分
-    Vec3d innov = pose.translation() - p_;
+    //2. 观测残差计算 - 只有位置部分
+    VecT innov = (pose.translation().template cast<PS>() - p_).template cast<S>();
 
-    //5. 状态更新
-    dx_ = K * innov;
-    cov_ = (Mat18T::Identity() - K * H) * cov_;
+    //3. 卡尔曼增益与状态、协方差更新
+    UpdateSelected<3>({0, 1, 2}, innov, noise_vec);
 
     UpdateAndReset();
     return true;
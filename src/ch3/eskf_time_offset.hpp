@@ -0,0 +1,330 @@
+//
+// 在误差状态中估计GNSS与IMU时间偏移的ESKF
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_ESKF_TIME_OFFSET_HPP
+#define SLAM_IN_AUTO_DRIVING_ESKF_TIME_OFFSET_HPP
+
+#include "ch3/eskf.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace sad {
+
+/**
+ * 在18维ESKF的基础上增加GNSS时间偏移td，误差状态为19维：p, v, R, bg, ba, grav, td
+ *
+ * td与--gps_time_offset含义相同：叠加到GNSS时间上后与IMU对齐，即时间戳为t的GNSS观测的是IMU时间t + td的状态。
+ * 观测时把名义状态外推到该时刻：p + v * tau，R * Exp(w * tau)，tau = t + td - 当前时间，
+ * 因此H中td一列的位置部分为当前速度v，旋转部分为当前角速度w，一次运行即可在线估计时间偏移。
+ * 速度和角速度都很小（静止）时td不可观，方差保持不变；IMU噪声设得较大时轨迹主要由GNSS决定，td的可观性也很弱，
+ * 此时估计值会偏向初值，应先用TimeLagEstimator粗估偏移
+ *
+ * 名义状态递推、安装角、FBK等都与ESKF相同
+ */
+template <typename S = double>
+class ESKFTimeOffset : public ESKF<S> {
+   public:
+    using Base = ESKF<S>;
+    using typename Base::Mat18T;
+    using typename Base::Mat3T;
+    using typename Base::NavStateT;
+    using typename Base::Options;
+    using typename Base::PackedCovT;
+    using typename Base::SO3;
+    using typename Base::VecT;
+    using Vec19T = Eigen::Matrix<S, 19, 1>;   // 19维向量类型
+    using Mat19T = Eigen::Matrix<S, 19, 19>;  // 19维方差类型
+
+    static constexpr int kTimeOffsetIndex = 18;  // td在误差状态中的位置
+
+    /// 时间偏移状态的参数
+    struct TimeOffsetOptions {
+        TimeOffsetOptions() {}
+        double init_time_offset_ = 0.0;      // 初始时间偏移(秒)
+        double init_time_offset_std_ = 0.1;  // 初始时间偏移标准差(秒)
+        double time_offset_walk_ = 1e-4;     // 时间偏移随机游走(秒/√秒)，每次递推的方差为walk^2 * dt
+        double max_time_offset_ = 1.0;       // 时间偏移的绝对值上限(秒)
+    };
+
+    ESKFTimeOffset(Options option = Options(), TimeOffsetOptions td_option = TimeOffsetOptions())
+        : Base(option), td_options_(td_option) {
+        ResetTimeOffset();
+    }
+
+    /// 设置初始条件，时间偏移取TimeOffsetOptions中的初值
+    void SetInitialConditions(Options options, const VecT& init_bg, const VecT& init_ba,
+                              const VecT& gravity = VecT(0, 0, -9.8)) {
+        Base::SetInitialConditions(options, init_bg, init_ba, gravity);
+        ResetTimeOffset();
+    }
+
+    /// 设置时间偏移参数，同时重置时间偏移及其方差
+    void SetTimeOffsetOptions(const TimeOffsetOptions& td_options) {
+        td_options_ = td_options;
+        ResetTimeOffset();
+    }
+
+    /// 使用IMU递推
+    bool Predict(const IMU& imu);
+
+    /// 成批使用IMU递推，接口与ESKF::PredictBatch相同，19维误差状态仍逐个IMU传播协方差
+    int PredictBatch(const IMU* imus, size_t count, std::vector<NavStateT>* states = nullptr) {
+        int predicted = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!Predict(imus[i])) {
+                continue;
+            }
+            predicted++;
+            if (states != nullptr) {
+                states->emplace_back(this->GetNominalState());
+            }
+        }
+        return predicted;
+    }
+
+    /// 使用GPS观测
+    bool ObserveGps(const GNSS& gnss);
+
+    /// 仅观测位置，不观测航向
+    bool ObservePositionOnly(const GNSS& gnss);
+
+    /// 当前估计的时间偏移(秒)
+    double GetTimeOffset() const { return time_offset_; }
+
+    /// 当前时间偏移的标准差(秒)
+    double GetTimeOffsetStd() const { return std::sqrt(static_cast<double>(aug_cov_(kTimeOffsetIndex, kTimeOffsetIndex))); }
+
+    /// 获取前18维的协方差，基类的cov_不随19维协方差更新
+    Mat18T GetCov() const { return aug_cov_.template topLeftCorner<18, 18>(); }
+
+    /// 获取前18维协方差的紧凑存放形式
+    PackedCovT GetPackedCov() const {
+        PackedCovT packed;
+        packed.FromFull(GetCov());
+        return packed;
+    }
+
+    /// 保存协方差对角元素，比ESKF多一列时间偏移方差
+    void SaveCovariance(std::ofstream& cov_file) const {
+        cov_file << std::setprecision(18) << this->current_time_ << " ";
+        for (int i = 0; i < 19; ++i) {
+            cov_file << std::setprecision(9) << aug_cov_(i, i) << " ";
+        }
+        cov_file << std::endl;
+    }
+
+   private:
+    void ResetTimeOffset() {
+        time_offset_ = td_options_.init_time_offset_;
+        aug_cov_ = Mat19T::Identity() * 1e-4;
+        aug_cov_(kTimeOffsetIndex, kTimeOffsetIndex) =
+            td_options_.init_time_offset_std_ * td_options_.init_time_offset_std_;
+        aug_dx_.setZero();
+    }
+
+    /// 首个GNSS直接设置初始位姿，与ESKF相同
+    void InitializeByFirstGnss(const GNSS& gnss);
+
+    /**
+     * 观测GNSS时刻的位姿
+     * @param gnss            GNSS观测，unix_time_为已叠加--gps_time_offset的时间
+     * @param observe_rotation 是否观测旋转，为false时只观测位置
+     */
+    bool ObserveWithTimeOffset(const GNSS& gnss, bool observe_rotation);
+
+    /// 更新名义状态变量与时间偏移，重置error state
+    void UpdateAndReset();
+
+    /// 对P阵进行投影，参考式(3.63)，td一维不受影响
+    void ProjectCov();
+
+    TimeOffsetOptions td_options_;
+    double time_offset_ = 0.0;         // 时间偏移名义值(秒)
+    VecT omega_ = VecT::Zero();        // 最近一次递推的角速度(车体系，已去零偏)
+    Vec19T aug_dx_ = Vec19T::Zero();   // 19维误差状态
+    Mat19T aug_cov_ = Mat19T::Identity();  // 19维协方差
+};
+
+using ESKFTimeOffsetD = ESKFTimeOffset<double>;
+using ESKFTimeOffsetF = ESKFTimeOffset<float>;
+
+template <typename S>
+bool ESKFTimeOffset<S>::Predict(const IMU& imu) {
+    this->UpdateInstallationAnglesByTime(imu.timestamp_);
+    IMU corrected_imu = this->ApplyPhoneInstallCorrection(imu);
+    IMU compensated_imu = this->ApplyTimeCompensation(corrected_imu);
+
+    double dt = compensated_imu.timestamp_ - this->current_time_;
+    if (dt < 0) {
+        LOG(INFO) << "skip early imu: dt = " << dt;
+        return false;
+    }
+
+    if (dt > (5 * this->options_.imu_dt_)) {
+        LOG(INFO) << "skip this imu because dt_ = " << dt;
+        this->current_time_ = compensated_imu.timestamp_;
+        return false;
+    }
+
+    auto& R = this->R_;
+    const S dt_s = static_cast<S>(dt);
+    const VecT acce = compensated_imu.acce_.template cast<S>() - this->ba_;
+    omega_ = compensated_imu.gyro_.template cast<S>() - this->bg_;
+
+    // nominal state 递推，与ESKF相同
+    VecT new_p = this->p_ + this->v_ * dt_s + S(0.5) * (R * acce) * dt_s * dt_s + S(0.5) * this->g_ * dt_s * dt_s;
+    VecT new_v = this->v_ + R * acce * dt_s + this->g_ * dt_s;
+    R = R * SO3::exp(omega_ * dt_s);
+    this->v_ = new_v;
+    this->p_ = new_p;
+
+    // error state 递推，前18维与ESKF相同，td不随时间变化
+    Mat19T F = Mat19T::Identity();
+    F.template block<3, 3>(0, 3) = Mat3T::Identity() * dt_s;                // p 对 v
+    F.template block<3, 3>(3, 6) = -R.matrix() * SO3::hat(acce) * dt_s;    // v对theta
+    F.template block<3, 3>(3, 12) = -R.matrix() * dt_s;                    // v 对 ba
+    F.template block<3, 3>(3, 15) = Mat3T::Identity() * dt_s;               // v 对 g
+    F.template block<3, 3>(6, 6) = SO3::exp(-omega_ * dt_s).matrix();       // theta 对 theta
+    F.template block<3, 3>(6, 9) = -Mat3T::Identity() * dt_s;               // theta 对 bg
+
+    Mat19T Q = Mat19T::Zero();
+    Q.template topLeftCorner<18, 18>() = this->Q_;
+    Q(kTimeOffsetIndex, kTimeOffsetIndex) = td_options_.time_offset_walk_ * td_options_.time_offset_walk_ * dt;
+
+    aug_cov_ = F * aug_cov_.eval() * F.transpose() + Q;
+    this->current_time_ = compensated_imu.timestamp_;
+    return true;
+}
+
+template <typename S>
+void ESKFTimeOffset<S>::InitializeByFirstGnss(const GNSS& gnss) {
+    double initial_yaw_deg = atan2(gnss.utm_pose_.so3().matrix()(1, 0), gnss.utm_pose_.so3().matrix()(0, 0)) *
+                             180.0 / M_PI;
+    if (initial_yaw_deg < 0) initial_yaw_deg += 360.0;
+    LOG(INFO) << "ESKF初始航向: " << initial_yaw_deg << "°";
+
+    this->R_ = Base::CastSO3(gnss.utm_pose_.so3());
+    this->p_ = gnss.utm_pose_.translation().template cast<S>();
+    this->first_gnss_ = false;
+    this->current_time_ = gnss.unix_time_;
+}
+
+template <typename S>
+bool ESKFTimeOffset<S>::ObserveGps(const GNSS& gnss) {
+    if (this->first_gnss_) {
+        this->SetInstallationAnglesByGPSTime(gnss.unix_time_);
+        InitializeByFirstGnss(gnss);
+        return true;
+    }
+
+    if (!gnss.heading_valid_) {
+        LOG(WARNING) << "GPS航向数据无效, 跳过观测更新";
+        return false;
+    }
+    return ObserveWithTimeOffset(gnss, true);
+}
+
+template <typename S>
+bool ESKFTimeOffset<S>::ObservePositionOnly(const GNSS& gnss) {
+    if (this->first_gnss_) {
+        InitializeByFirstGnss(gnss);
+        return true;
+    }
+    return ObserveWithTimeOffset(gnss, false);
+}
+
+template <typename S>
+bool ESKFTimeOffset<S>::ObserveWithTimeOffset(const GNSS& gnss, bool observe_rotation) {
+    const int dim = observe_rotation ? 6 : 3;
+    const double trans_noise = this->options_.gnss_pos_noise_;
+    const double ang_noise = this->options_.gnss_ang_noise_;
+
+    // 观测对应的IMU时刻与当前时刻之差
+    const S tau = static_cast<S>(gnss.unix_time_ + time_offset_ - this->current_time_);
+
+    // 外推到观测时刻的名义状态
+    const VecT pred_p = this->p_ + this->v_ * tau;
+    const SO3 pred_R = this->R_ * SO3::exp(omega_ * tau);
+
+    //1. 观测模型雅可比矩阵H，td一列为速度与角速度
+    Eigen::Matrix<S, Eigen::Dynamic, 19> H = Eigen::Matrix<S, Eigen::Dynamic, 19>::Zero(dim, 19);
+    H.template block<3, 3>(0, 0) = Mat3T::Identity();        // P部分
+    H.template block<3, 3>(0, 3) = Mat3T::Identity() * tau;  // V部分
+    H.template block<3, 1>(0, kTimeOffsetIndex) = this->v_;
+    if (observe_rotation) {
+        H.template block<3, 3>(3, 6) = Mat3T::Identity();  // R部分（3.66)
+        H.template block<3, 1>(3, kTimeOffsetIndex) = omega_;
+    }
+
+    //2. 观测噪声协方差矩阵，与ESKF相同
+    Eigen::Matrix<S, Eigen::Dynamic, 1> noise_vec(dim);
+    noise_vec.template head<3>().setConstant(trans_noise);
+    if (observe_rotation) {
+        noise_vec.template tail<3>().setConstant(ang_noise);
+    }
+
+    //3. 观测残差计算
+    Eigen::Matrix<S, Eigen::Dynamic, 1> innov(dim);
+    innov.template head<3>() = gnss.utm_pose_.translation().template cast<S>() - pred_p;
+    if (observe_rotation) {
+        innov.template tail<3>() = (pred_R.inverse() * gnss.utm_pose_.so3().template cast<S>()).log();
+        //清除对横滚roll、俯仰pitch的观测残差
+        innov[3] = 0.0;
+        innov[4] = 0.0;
+    }
+
+    //4. 卡尔曼增益计算K
+    const Eigen::Matrix<S, 19, Eigen::Dynamic> PHt = aug_cov_ * H.transpose();
+    Eigen::Matrix<S, Eigen::Dynamic, Eigen::Dynamic> HPHt = H * PHt;
+    HPHt.diagonal() += noise_vec;
+    const Eigen::Matrix<S, 19, Eigen::Dynamic> K = PHt * HPHt.inverse();
+
+    //5. 状态更新
+    aug_dx_ = K * innov;
+    aug_cov_ = (Mat19T::Identity() - K * H) * aug_cov_;
+
+    UpdateAndReset();
+    return true;
+}
+
+template <typename S>
+void ESKFTimeOffset<S>::UpdateAndReset() {
+    this->p_ += aug_dx_.template block<3, 1>(0, 0);
+    this->v_ += aug_dx_.template block<3, 1>(3, 0);
+    this->R_ = this->R_ * SO3::exp(aug_dx_.template block<3, 1>(6, 0));
+
+    if (this->options_.update_bias_gyro_) {
+        this->bg_ += aug_dx_.template block<3, 1>(9, 0);
+    }
+
+    if (this->options_.update_bias_acce_) {
+        this->ba_ += aug_dx_.template block<3, 1>(12, 0);
+    }
+
+    this->g_ += aug_dx_.template block<3, 1>(15, 0);
+
+    // 偏移受限于搜索范围，避免激励不足时发散
+    // 被截掉的修正量没有作用到名义值上，但方差已按完整的修正量减小，截断时把截掉部分的平方加回td的方差
+    const double unclamped = time_offset_ + static_cast<double>(aug_dx_[kTimeOffsetIndex]);
+    time_offset_ = std::clamp(unclamped, -td_options_.max_time_offset_, td_options_.max_time_offset_);
+    const double clipped = unclamped - time_offset_;
+    if (clipped != 0.0) {
+        aug_cov_(kTimeOffsetIndex, kTimeOffsetIndex) += static_cast<S>(clipped * clipped);
+    }
+
+    ProjectCov();
+    aug_dx_.setZero();
+}
+
+template <typename S>
+void ESKFTimeOffset<S>::ProjectCov() {
+    Mat19T J = Mat19T::Identity();
+    J.template block<3, 3>(6, 6) = Mat3T::Identity() - 0.5 * SO3::hat(aug_dx_.template block<3, 1>(6, 0));
+    aug_cov_ = J * aug_cov_ * J.transpose();
+}
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_ESKF_TIME_OFFSET_HPP
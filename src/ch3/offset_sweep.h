@@ -0,0 +1,154 @@
+//
+// GPS时间偏移扫描与寻优：偏移范围解析、按偏移命名的输出文件、一维极小化
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_OFFSET_SWEEP_H
+#define SLAM_IN_AUTO_DRIVING_OFFSET_SWEEP_H
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace sad {
+
+/// 解析start:end:step形式的GPS时间偏移范围，与批处理脚本相同：从start开始按step变化，直到越过end
+inline bool ParseOffsetSweep(const std::string& sweep, std::vector<double>& offsets) {
+    double start = 0, end = 0, step = 0;
+    char tail = 0;
+    if (std::sscanf(sweep.c_str(), "%lf:%lf:%lf%c", &start, &end, &step, &tail) != 3 || step == 0.0 ||
+        (end - start) * step < 0) {
+        LOG(ERROR) << "GPS时间偏移扫描范围格式错误: " << sweep << "，应为start:end:step";
+        return false;
+    }
+    // 输出文件名与处理汇总都按毫秒区分偏移
+    if (std::fabs(step) < 0.001 - 1e-9) {
+        LOG(ERROR) << "GPS时间偏移扫描的步长不能小于1ms: " << sweep;
+        return false;
+    }
+
+    // 每个偏移由步数直接算出并舍入到微秒，与命令行逐个给出时的取值相同，避免累加误差改变文件名中的毫秒数
+    const int num_steps = static_cast<int>(std::floor((end - start) / step + 1e-9));
+    offsets.clear();
+    for (int i = 0; i <= num_steps; ++i) {
+        offsets.push_back(std::round((start + i * step) * 1e6) / 1e6);
+    }
+    return true;
+}
+
+/// 按GPS时间偏移生成输出文件名，与单独运行时相同：<prefix>[_<偏移毫秒数>ms].txt
+inline std::string OffsetFileName(const std::string& prefix, double gps_time_offset) {
+    std::string name = prefix;
+    if (gps_time_offset != 0.0) {
+        name += "_" + std::to_string(static_cast<int>(gps_time_offset * 1000)) + "ms";
+    }
+    return name + ".txt";
+}
+
+/// 处理汇总中偏移的写法，默认与批处理脚本的printf "%.2f"相同；寻优的偏移精确到毫秒，用3位小数
+inline std::string FormatOffset(double gps_time_offset, int precision = 2) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.*f", precision, gps_time_offset);
+    return buffer;
+}
+
+/// GPS时间偏移舍入后的毫秒数，用于区分不同的偏移
+inline int OffsetMillis(double gps_time_offset) { return static_cast<int>(std::lround(gps_time_offset * 1000)); }
+
+/// 处理汇总中这组偏移需要的小数位数：都是10ms的整数倍时与批处理脚本相同用2位，否则用3位，避免不同偏移写成同一个值
+inline int OffsetPrecision(const std::vector<double>& offsets) {
+    for (double offset : offsets) {
+        if (OffsetMillis(offset) % 10 != 0) {
+            return 3;
+        }
+    }
+    return 2;
+}
+
+/// 解析start:end形式的GPS时间偏移搜索区间
+inline bool ParseOffsetInterval(const std::string& interval, double& lower, double& upper) {
+    double start = 0, end = 0;
+    char tail = 0;
+    if (std::sscanf(interval.c_str(), "%lf:%lf%c", &start, &end, &tail) != 2 || start == end) {
+        LOG(ERROR) << "GPS时间偏移搜索区间格式错误: " << interval << "，应为start:end";
+        return false;
+    }
+    lower = std::min(start, end);
+    upper = std::max(start, end);
+    return true;
+}
+
+/**
+ * Brent法求[lower, upper]内一维函数的极小值：黄金分割保证收敛，函数光滑时用抛物线插值加速
+ * 每次求值都是一次完整的滤波，因此以自变量的精度tol为停止条件，且每步至少移动tol
+ * @param f          目标函数double(double)
+ * @param tol        自变量精度，结果与真实极小值点之差约在2 * tol以内
+ * @param max_evals  最多求值次数
+ * @return 求得的极小值点
+ */
+template <typename Func>
+double BrentMinimize(Func&& f, double lower, double upper, double tol, int max_evals) {
+    const double golden = 0.5 * (3.0 - std::sqrt(5.0));
+    double a = lower, b = upper;
+    double x = a + golden * (b - a), w = x, v = x;
+    double fx = f(x), fw = fx, fv = fx;
+    double d = 0, e = 0;
+
+    for (int evals = 1; evals < max_evals; ++evals) {
+        const double m = 0.5 * (a + b);
+        if (std::fabs(x - m) <= 2 * tol - 0.5 * (b - a)) {
+            break;
+        }
+
+        // 用x, w, v三点拟合抛物线，顶点落在区间内且步长小于上上步的一半时采用，否则黄金分割
+        bool use_golden = true;
+        if (std::fabs(e) > tol) {
+            double r = (x - w) * (fx - fv);
+            double q = (x - v) * (fx - fw);
+            double p = (x - v) * q - (x - w) * r;
+            q = 2 * (q - r);
+            if (q > 0) {
+                p = -p;
+            } else {
+                q = -q;
+            }
+            if (std::fabs(p) < std::fabs(0.5 * q * e) && p > q * (a - x) && p < q * (b - x)) {
+                e = d;
+                d = p / q;
+                const double u = x + d;
+                if (u - a < 2 * tol || b - u < 2 * tol) {
+                    d = x < m ? tol : -tol;
+                }
+                use_golden = false;
+            }
+        }
+        if (use_golden) {
+            e = (x < m ? b : a) - x;
+            d = golden * e;
+        }
+
+        const double u = x + (std::fabs(d) >= tol ? d : (d > 0 ? tol : -tol));
+        const double fu = f(u);
+        if (fu <= fx) {
+            (u < x ? b : a) = x;
+            v = w, fv = fw;
+            w = x, fw = fx;
+            x = u, fx = fu;
+        } else {
+            (u < x ? a : b) = u;
+            if (fu <= fw || w == x) {
+                v = w, fv = fw;
+                w = u, fw = fu;
+            } else if (fu <= fv || v == x || v == w) {
+                v = u, fv = fu;
+            }
+        }
+    }
+    return x;
+}
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_OFFSET_SWEEP_H
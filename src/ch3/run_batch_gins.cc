@@ -0,0 +1,513 @@
+//
+// 批量处理：一个目录下的全部日志 × 一组GPS时间偏移，由工作窃取线程池并行调度
+// 取代mac_batch_process.sh中逐个串行执行run_eskf_gins的第二阶段
+//
+
+#include <fcntl.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ch3/offset_sweep.h"
+#include "common/sensor_cache.h"
+
+DEFINE_string(log_dir, "/Users/cjj/Data/vdr_plog/XiaoMi11", "日志文件夹，递归查找其中的.log文件");
+DEFINE_string(exec_path, "/Users/cjj/work/GNSS_INS/slam/gnss_imu_time/bin/run_eskf_gins", "run_eskf_gins可执行文件");
+DEFINE_string(output_dir, "/Users/cjj/Data/log_results/XiaoMi11", "结果保存目录，每个日志一个子目录");
+DEFINE_string(gps_time_offset_sweep, "0:-0.4:-0.05", "GPS时间偏移范围，格式start:end:step");
+DEFINE_int32(num_workers, 0, "同时运行的任务数，0表示使用全部CPU核");
+DEFINE_double(task_size_mb, 200.0, "单个任务的数据量上限(日志大小×偏移数, MB)，大日志的偏移按此拆成多个任务，避免最后单独拖尾");
+DEFINE_int32(task_timeout, 300, "每个偏移的超时时间(秒)，任务的超时按其包含的偏移数累加");
+
+namespace {
+
+/// 一个任务：一个日志上连续的一段GPS时间偏移，由一个run_eskf_gins进程只解析一次日志后依次处理
+struct BatchTask {
+    std::string log_path_;
+    std::string log_name_;
+    std::string output_dir_;
+    std::vector<double> offsets_;
+    size_t log_index_ = 0;         // 日志在log_files中的下标
+    bool save_body_acce_ = false;  // 只有包含最后一个偏移的任务输出body_acce.txt，与串行处理时留下的文件相同
+    bool cache_leader_ = false;    // 日志拆成多个任务且没有有效缓存时，由该任务的子进程解析日志并写缓存
+    bool wait_for_cache_ = false;  // 等cache_leader_写好缓存后再开始，只加载缓存而不重复解析
+    double cost_ = 0;              // 估计的工作量：日志大小(MB)×偏移数
+};
+
+/// 子进程的运行结果
+struct ChildResult {
+    bool exited_ = false;     // 正常退出且返回0
+    bool timed_out_ = false;  // 超时被终止
+    double wall_sec_ = 0;
+    double peak_memory_mb_ = 0;
+};
+
+/**
+ * 工作窃取线程池
+ * 每个线程有自己的任务队列，任务按工作量从大到小分发；自己的队列空了以后从其他线程的队列中窃取
+ * 窃取时取对方队列中最大的任务，大任务尽早开始，减少最后只剩一两个大任务时的拖尾
+ */
+class WorkStealingPool {
+   public:
+    explicit WorkStealingPool(int num_workers) : queues_(std::max(1, num_workers)) {}
+
+    using ReadyFunc = std::function<bool(const BatchTask& task)>;
+
+    /// 按工作量从大到小轮流分发到各线程的队列，写缓存的任务排在最前，须在Run()之前调用
+    void Distribute(std::vector<BatchTask> tasks) {
+        std::stable_sort(tasks.begin(), tasks.end(), [](const BatchTask& a, const BatchTask& b) {
+            if (a.cache_leader_ != b.cache_leader_) {
+                return a.cache_leader_;
+            }
+            return a.cost_ > b.cost_;
+        });
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            queues_[i % queues_.size()].tasks_.push_back(std::move(tasks[i]));
+        }
+    }
+
+    /**
+     * 在各线程中执行全部任务，返回时所有任务都已完成
+     * 只取is_ready为true的任务；剩下的任务都未就绪时，线程先调用wait（可在其中更新就绪状态）再重试
+     */
+    void Run(const std::function<void(int worker, const BatchTask& task)>& run_task, const ReadyFunc& is_ready,
+             const std::function<void()>& wait) {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < static_cast<int>(queues_.size()); ++i) {
+            threads.emplace_back([this, i, &run_task, &is_ready, &wait]() {
+                BatchTask task;
+                while (!Empty()) {
+                    if (Pop(i, task, is_ready)) {
+                        run_task(i, task);
+                    } else {
+                        wait();
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+    size_t NumSteals() const { return num_steals_; }
+
+   private:
+    struct Queue {
+        std::mutex mutex_;
+        std::deque<BatchTask> tasks_;
+    };
+
+    /// 取出队列中最靠前的就绪任务
+    bool PopFront(Queue& queue, BatchTask& task, const ReadyFunc& is_ready) {
+        std::lock_guard<std::mutex> lock(queue.mutex_);
+        auto it = std::find_if(queue.tasks_.begin(), queue.tasks_.end(), is_ready);
+        if (it == queue.tasks_.end()) {
+            return false;
+        }
+        task = std::move(*it);
+        queue.tasks_.erase(it);
+        return true;
+    }
+
+    /// 任务不会新增，所有队列都空时结束
+    bool Empty() {
+        for (auto& queue : queues_) {
+            std::lock_guard<std::mutex> lock(queue.mutex_);
+            if (!queue.tasks_.empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// 先取自己队列中的就绪任务，没有时依次从其他线程的队列中窃取
+    bool Pop(int worker, BatchTask& task, const ReadyFunc& is_ready) {
+        if (PopFront(queues_[worker], task, is_ready)) {
+            return true;
+        }
+        for (size_t k = 1; k < queues_.size(); ++k) {
+            if (PopFront(queues_[(worker + k) % queues_.size()], task, is_ready)) {
+                num_steals_++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Queue> queues_;
+    std::atomic<size_t> num_steals_{0};
+};
+
+/**
+ * 日志缓存的就绪状态
+ * 拆成多个任务的日志若同时开始，每个子进程都要解析整个日志并写同一个缓存，峰值内存按任务数成倍增加
+ * 因此只让其中一个任务先解析并写缓存，其余任务等缓存有效后再开始，只加载缓存；写缓存的任务结束时无论成败都放行
+ */
+class CacheGate {
+   public:
+    explicit CacheGate(const std::vector<std::string>& log_files)
+        : log_files_(log_files), ready_(log_files.size()) {
+        for (auto& ready : ready_) {
+            ready = true;
+        }
+    }
+
+    /// 日志log_index的缓存写好前，等待缓存的任务不能开始
+    void Close(size_t log_index) { ready_[log_index] = false; }
+
+    void Open(size_t log_index) { ready_[log_index] = true; }
+
+    bool IsReady(const BatchTask& task) const { return !task.wait_for_cache_ || ready_[task.log_index_]; }
+
+    /// 检查尚未就绪的日志的缓存是否已经写好，然后等待一段时间
+    void Wait() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < ready_.size(); ++i) {
+                if (!ready_[i] && sad::IsSensorCacheValid(sad::DefaultSensorCachePath(log_files_[i]), log_files_[i])) {
+                    ready_[i] = true;
+                }
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+   private:
+    std::vector<std::string> log_files_;
+    std::vector<std::atomic<bool>> ready_;
+    std::mutex mutex_;
+};
+
+std::string CurrentTimeString() {
+    std::time_t now = std::time(nullptr);
+    std::tm tm_now;
+    localtime_r(&now, &tm_now);
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm_now);
+    return buffer;
+}
+
+/// 在work_dir中运行子进程，标准输出与错误输出写入log_path，超时后终止，返回耗时与峰值内存
+ChildResult RunChild(const std::vector<std::string>& args, const std::string& work_dir, const std::string& log_path,
+                     int timeout_sec) {
+    ChildResult result;
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        LOG(ERROR) << "无法创建子进程";
+        return result;
+    }
+    if (pid == 0) {
+        // 子进程中只调用可在fork后安全使用的系统调用
+        if (chdir(work_dir.c_str()) != 0) {
+            _exit(127);
+        }
+        int fd = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage {};
+    const auto deadline = start + std::chrono::seconds(timeout_sec);
+    while (true) {
+        pid_t ret = wait4(pid, &status, WNOHANG, &usage);
+        if (ret == pid) {
+            break;
+        }
+        if (ret < 0) {
+            LOG(ERROR) << "等待子进程失败";
+            return result;
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            kill(pid, SIGKILL);
+            wait4(pid, &status, 0, &usage);
+            result.timed_out_ = true;
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    result.wall_sec_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#ifdef __APPLE__
+    result.peak_memory_mb_ = usage.ru_maxrss / (1024.0 * 1024.0);  // macOS上单位为字节
+#else
+    result.peak_memory_mb_ = usage.ru_maxrss / 1024.0;  // Linux上单位为KB
+#endif
+    result.exited_ = !result.timed_out_ && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return result;
+}
+
+/// 递归查找.log文件，按路径排序
+std::vector<std::string> FindLogFiles(const std::string& log_dir) {
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (std::filesystem::recursive_directory_iterator it(log_dir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->is_regular_file() && it->path().extension() == ".log") {
+            files.push_back(it->path().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+/**
+ * 按日志大小把偏移拆成若干段连续的任务，每个任务的工作量不超过task_size_mb
+ * 拆分的日志没有有效缓存时，第一个任务负责写缓存，其余任务在gate中等待
+ */
+std::vector<BatchTask> MakeTasks(const std::vector<std::string>& log_files, const std::vector<double>& offsets,
+                                 CacheGate& gate) {
+    std::vector<BatchTask> tasks;
+    for (size_t log_index = 0; log_index < log_files.size(); ++log_index) {
+        const std::string& log_path = log_files[log_index];
+        std::error_code ec;
+        const auto size_bytes = std::filesystem::file_size(log_path, ec);
+        const double size_mb = ec ? 0.0 : size_bytes / (1024.0 * 1024.0);
+        const std::string log_name = std::filesystem::path(log_path).stem().string();
+
+        const int num_offsets = static_cast<int>(offsets.size());
+        const int num_chunks = std::clamp(
+            static_cast<int>(std::ceil(size_mb * num_offsets / std::max(FLAGS_task_size_mb, 1.0))), 1, num_offsets);
+        const bool need_cache =
+            num_chunks > 1 && !sad::IsSensorCacheValid(sad::DefaultSensorCachePath(log_path), log_path);
+        if (need_cache) {
+            gate.Close(log_index);
+        }
+        for (int c = 0; c < num_chunks; ++c) {
+            BatchTask task;
+            task.log_path_ = log_path;
+            task.log_index_ = log_index;
+            task.cache_leader_ = need_cache && c == 0;
+            task.wait_for_cache_ = need_cache && c > 0;
+            task.log_name_ = log_name;
+            task.output_dir_ = FLAGS_output_dir + "/" + log_name;
+            task.offsets_.assign(offsets.begin() + c * num_offsets / num_chunks,
+                                 offsets.begin() + (c + 1) * num_offsets / num_chunks);
+            task.save_body_acce_ = c + 1 == num_chunks;
+            task.cost_ = size_mb * task.offsets_.size();
+            tasks.push_back(std::move(task));
+        }
+    }
+    return tasks;
+}
+
+/// 汇总文件，多个线程完成任务后各自追加
+class SummaryWriter {
+   public:
+    /**
+     * 与mac_batch_process.sh相同的表头，末尾增加峰值内存
+     * @param offset_precision  子进程没有写出的偏移的小数位数，与子进程写汇总时相同
+     */
+    bool Open(const std::string& path, int offset_precision) {
+        offset_precision_ = offset_precision;
+        fout_.open(path);
+        if (!fout_.is_open()) {
+            return false;
+        }
+        fout_ << "时间戳,日志文件,GPS偏移,状态,输出文件,处理时间,文件大小,峰值内存(MB)" << std::endl;
+        return true;
+    }
+
+    /**
+     * 写入一个任务中各偏移的结果
+     * 子进程写出的行已有各偏移的状态、耗时和输出文件大小，这里补上进程的峰值内存；
+     * 子进程异常退出或超时而没有写出的偏移记为FAILED
+     * 子进程写出的偏移按毫秒数对应，子进程只知道自己的几个偏移，小数位数可能不同，统一按整个扫描的位数重写
+     */
+    void Write(const BatchTask& task, const std::string& child_summary, const ChildResult& child) {
+        std::map<int, std::pair<std::string, std::string>> rows;  // 偏移毫秒数 -> 子进程写出的行在偏移前后的部分
+        std::ifstream fin(child_summary);
+        std::string line;
+        std::getline(fin, line);  // 表头
+        while (std::getline(fin, line)) {
+            const size_t begin = line.find(',', line.find(',') + 1);
+            const size_t end = begin == std::string::npos ? begin : line.find(',', begin + 1);
+            if (end == std::string::npos) {
+                continue;
+            }
+            const std::string offset = line.substr(begin + 1, end - begin - 1);
+            char* parsed = nullptr;
+            const double value = std::strtod(offset.c_str(), &parsed);
+            if (parsed != offset.c_str()) {
+                rows[sad::OffsetMillis(value)] = {line.substr(0, begin + 1), line.substr(end)};
+            }
+        }
+
+        char memory[32];
+        std::snprintf(memory, sizeof(memory), "%.1f", child.peak_memory_mb_);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (double offset : task.offsets_) {
+            auto it = rows.find(sad::OffsetMillis(offset));
+            if (it != rows.end()) {
+                const auto& [head, tail] = it->second;
+                fout_ << head << sad::FormatOffset(offset, offset_precision_) << tail << "," << memory << std::endl;
+                (tail.rfind(",SUCCESS,", 0) == 0 ? num_success_ : num_failed_)++;
+            } else {
+                fout_ << CurrentTimeString() << "," << task.log_name_ << ","
+                      << sad::FormatOffset(offset, offset_precision_) << ",FAILED,"
+                      << task.output_dir_ << "," << static_cast<int>(child.wall_sec_) << ",0," << memory << std::endl;
+                num_failed_++;
+            }
+        }
+    }
+
+    int NumSuccess() const { return num_success_; }
+    int NumFailed() const { return num_failed_; }
+
+   private:
+    std::mutex mutex_;
+    std::ofstream fout_;
+    int offset_precision_ = 2;
+    int num_success_ = 0;
+    int num_failed_ = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = google::INFO;
+    FLAGS_colorlogtostderr = true;
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    std::vector<double> offsets;
+    if (!sad::ParseOffsetSweep(FLAGS_gps_time_offset_sweep, offsets)) {
+        return -1;
+    }
+    // 步长不是10ms的整数倍时偏移用3位小数，输出文件名与汇总中的偏移才能一一对应
+    const int offset_precision = sad::OffsetPrecision(offsets);
+    if (access(FLAGS_exec_path.c_str(), X_OK) != 0) {
+        LOG(ERROR) << "可执行文件不存在或没有执行权限: " << FLAGS_exec_path;
+        return -1;
+    }
+
+    std::vector<std::string> log_files = FindLogFiles(FLAGS_log_dir);
+    if (log_files.empty()) {
+        LOG(WARNING) << "未找到任何.log文件在目录: " << FLAGS_log_dir;
+        return 0;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(FLAGS_output_dir, ec);
+    // 子进程在各自的输出目录中运行，传给它的路径都用绝对路径
+    const std::string output_dir = std::filesystem::absolute(FLAGS_output_dir, ec).string();
+    FLAGS_output_dir = output_dir;
+    for (auto& log_path : log_files) {
+        log_path = std::filesystem::absolute(log_path, ec).string();
+    }
+
+    SummaryWriter summary;
+    if (!summary.Open(output_dir + "/processing_summary.txt", offset_precision)) {
+        LOG(ERROR) << "无法创建处理汇总: " << output_dir << "/processing_summary.txt";
+        return -1;
+    }
+
+    CacheGate gate(log_files);
+    std::vector<BatchTask> tasks = MakeTasks(log_files, offsets, gate);
+    const int num_workers = std::min(static_cast<int>(tasks.size()),
+                                     FLAGS_num_workers > 0 ? FLAGS_num_workers
+                                                           : static_cast<int>(std::thread::hardware_concurrency()));
+    LOG(INFO) << "找到 " << log_files.size() << " 个日志文件, " << offsets.size() << " 个GPS偏移, 拆分为 "
+              << tasks.size() << " 个任务, " << num_workers << " 个并行任务";
+
+    const size_t num_tasks = tasks.size();
+    std::atomic<size_t> num_done(0);
+    std::atomic<int64_t> busy_ms(0);
+    auto start = std::chrono::steady_clock::now();
+
+    // 在工作线程中运行一个任务的子进程并写入汇总，输出目录无法创建时各偏移记为FAILED
+    auto run_task = [&](int worker, const BatchTask& task) {
+        const std::string first = sad::FormatOffset(task.offsets_.front(), offset_precision);
+        const std::string last = sad::FormatOffset(task.offsets_.back(), offset_precision);
+        size_t done = 0;
+
+        std::error_code dir_ec;
+        std::filesystem::create_directories(task.output_dir_, dir_ec);
+        if (dir_ec) {
+            summary.Write(task, "", ChildResult());
+            done = ++num_done;
+            LOG(ERROR) << "[" << done << "/" << num_tasks << "] 线程" << worker << " " << task.log_name_ << " 偏移 "
+                       << first << " ~ " << last << " 无法创建输出目录 " << task.output_dir_ << ": "
+                       << dir_ec.message();
+            return;
+        }
+
+        const std::string suffix = task.offsets_.size() == 1 ? first : first + "_" + last;
+        const std::string child_summary = task.output_dir_ + "/.summary_" + suffix + ".txt";
+        const std::string child_log = task.output_dir_ + "/" + task.log_name_ + "_offset_" + suffix + ".log";
+
+        const double step = task.offsets_.size() > 1 ? task.offsets_[1] - task.offsets_[0] : 1.0;
+        const std::string sweep = std::to_string(task.offsets_.front()) + ":" + std::to_string(task.offsets_.back()) +
+                                  ":" + std::to_string(step);
+
+        // 并行由任务池提供，子进程内部只用一个线程
+        std::vector<std::string> args = {FLAGS_exec_path,
+                                         "--txt_path=" + task.log_path_,
+                                         "--offline_mode=true",
+                                         "--gps_time_offset_sweep=" + sweep,
+                                         "--sweep_threads=1",
+                                         "--io_threads=1",
+                                         std::string("--save_body_acce=") + (task.save_body_acce_ ? "true" : "false"),
+                                         "--sweep_summary_path=" + child_summary};
+
+        std::remove(child_summary.c_str());
+        ChildResult child = RunChild(args, task.output_dir_, child_log,
+                                     FLAGS_task_timeout * static_cast<int>(task.offsets_.size()));
+        summary.Write(task, child_summary, child);
+        std::remove(child_summary.c_str());
+
+        busy_ms += static_cast<int64_t>(child.wall_sec_ * 1000);
+        done = ++num_done;
+        LOG(INFO) << "[" << done << "/" << num_tasks << "] 线程" << worker << " " << task.log_name_ << " 偏移 " << first
+                  << " ~ " << last << (child.timed_out_ ? " 超时" : (child.exited_ ? " 完成" : " 失败")) << ", 耗时 "
+                  << child.wall_sec_ << " s, 峰值内存 " << child.peak_memory_mb_ << " MB";
+    };
+
+    WorkStealingPool pool(num_workers);
+    pool.Distribute(std::move(tasks));
+    pool.Run(
+        [&](int worker, const BatchTask& task) {
+            run_task(worker, task);
+            if (task.cache_leader_) {
+                gate.Open(task.log_index_);
+            }
+        },
+        [&](const BatchTask& task) { return gate.IsReady(task); }, [&]() { gate.Wait(); });
+
+    const double wall_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    LOG(INFO) << "批量处理完成: 成功 " << summary.NumSuccess() << ", 失败 " << summary.NumFailed() << ", 总耗时 "
+              << wall_sec << " s, 任务耗时合计 " << busy_ms / 1000.0 << " s, 窃取任务 " << pool.NumSteals() << " 次";
+    LOG(INFO) << "详细汇总: " << output_dir << "/processing_summary.txt";
+    return summary.NumFailed() == 0 ? 0 : -1;
+}
@@ -1,817 +1,1288 @@
-//
-// Created by xiang on 2021/11/11.
-//
-
-#include "ch3/eskf.hpp"
-#include "common/io_utils.h"
-#include "utm_convert.h"
-#include "turn_detector.h"
-
-#include <gflags/gflags.h>
-#include <glog/logging.h>
-#include <fstream>
-#include <iomanip>
-#include <vector>
-#include <algorithm>
-#include <queue>
-
-DEFINE_string(txt_path, "/Users/cjj/Data/vdr_plog/Honor_V40/vdr_20250523_162014_895.log", "数据文件路径");
-DEFINE_bool(offline_mode, false, "是否使用离线重组织模式，同时使用转弯检测");
-DEFINE_double(gps_time_offset, 0.0, "GPS时间偏移");
-DEFINE_bool(enable_turn_detection, true, "是否启用转弯检测（仅在离线模式下有效）");  // 新增，默认开启
-
-//时间戳数据结构
-struct TimeStampedData {
-    double timestamp;
-    enum DataType { IMU_TYPE, GPS_TYPE } type;
-
-    sad::IMU imu_data;
-    sad::GNSS gps_data;
-
-    TimeStampedData(const sad::IMU& imu)
-        : timestamp(imu.timestamp_), type(IMU_TYPE), imu_data(imu) {}
-
-    TimeStampedData(const sad::GNSS& gnss)
-        : timestamp(gnss.unix_time_), type(GPS_TYPE), gps_data(gnss) {}
-
-    bool operator<(const TimeStampedData& other) const {
-        return timestamp < other.timestamp;
-    }
-};
-
-
-/**
- * 本程序演示使用RTK+IMU进行组合导航
- */
-bool InitializeESKF(sad::ESKFD& eskf){
-    // 陀螺零偏 (度/秒) 
-    const double GYRO_BIAS_X = 0.001711;
-    const double GYRO_BIAS_Y = -0.021235;
-    const double GYRO_BIAS_Z = 0.049159;
-    
-    // 加速度零偏 (m/s²) 
-    const double ACCEL_BIAS_X = -0.013369;
-    const double ACCEL_BIAS_Y = -0.020087;
-    const double ACCEL_BIAS_Z = 0.101552;
-    
-    sad::ESKFD::Options options;
-    options.gyro_var_ = 2e-3;     // 陀螺噪声
-    options.acce_var_ = 5e-2;     // 加速度噪声
-    options.bias_gyro_var_ = 1e-6; // 陀螺零偏随机游走
-    options.bias_acce_var_ = 1e-4; // 加速度零偏随机游走
-
-    Vec3d init_bg(GYRO_BIAS_X * sad::math::kDEG2RAD, GYRO_BIAS_Y * sad::math::kDEG2RAD, GYRO_BIAS_Z * sad::math::kDEG2RAD);
-    Vec3d init_ba(ACCEL_BIAS_X, ACCEL_BIAS_Y, ACCEL_BIAS_Z);
-    Vec3d gravity(0, 0, -9.8);
-
-    eskf.SetInitialConditions(options, init_bg, init_ba, gravity);
-    return true;
-
-
-}
-
-//离线数据管理
-class OfflineDataManager {
-private:
-    std::vector<TimeStampedData> all_data_;
-    double gps_time_offset_ = 0.0;
-
-    // 新增：GPS-NZZ匹配结果存储
-    std::vector<std::pair<double, double>> matched_heading_data_; // (gps_timestamp, nzz_heading)
-
-    // 新增：FBK数据存储
-    std::vector<sad::FBKPair> fbk_data_;
-
-public:
-
-    //读取所有数据
-    bool ReadAllData(const std::string& file_path,
-                    std::vector<sad::IMU>& imu_data,
-                    std::vector<sad::GNSS>& gps_data) {
-                        
-        // 新增：收集GPS-NZZ匹配数据
-        std::vector<sad::GPSWithTimeKey> gps_with_timekey;
-        std::vector<sad::NZZ> nzz_data;
-
-        // 新增：收集FBK数据
-        std::vector<sad::FBKPair> fbk_data;
-
-        sad::TxtIO io(file_path);
-        io.SetIMUProcessFunc([&](const sad::IMU& imu){
-            imu_data.push_back(imu);
-        }).SetGNSSProcessFunc([&](const sad::GNSS& gps){
-            gps_data.push_back(gps);
-        }).SetGPSWithTimeKeyProcessFunc([&](const sad::GPSWithTimeKey& gps_timekey){
-            gps_with_timekey.push_back(gps_timekey);
-        }).SetNZZProcessFunc([&](const sad::NZZ& nzz){
-            nzz_data.push_back(nzz);
-        }).SetFBKPairProcessFunc([&](const sad::FBKPair& fbk_pair){  // 新增
-            fbk_data.push_back(fbk_pair);
-        });
-
-        io.Go();
-
-        LOG(INFO) << "数据读取完成: GPS=" << gps_with_timekey.size() 
-                  << ", NZZ=" << nzz_data.size() << ", FBK=" << fbk_data.size();
-        
-        // 新增：进行GPS-NZZ匹配
-        MatchGPSNZZData(gps_with_timekey, nzz_data);
-
-        fbk_data_ = fbk_data;
-        return !imu_data.empty() && !gps_data.empty();
-     }
-
-    // 新增：获取匹配的航向数据
-    const std::vector<std::pair<double, double>>& GetMatchedHeadingData() const {
-        return matched_heading_data_;
-    }
-
-    // 新增：获取FBK数据
-    const std::vector<sad::FBKPair>& GetFBKData() const {
-        return fbk_data_;
-    }
-
-    void SetGPSTimeOffset(double offset) {
-        gps_time_offset_ = offset;
-        LOG(INFO) << "设置GPS时间偏移" << offset << "s";
-    }
-
-    bool LoadAndReorganizeData (const std::string& file_path) {
-        std::vector<sad::IMU> imu_data;
-        std::vector<sad::GNSS> gps_data;
-
-        // 读取数据
-        if(!ReadAllData(file_path, imu_data, gps_data)) {
-            LOG(ERROR) << "数据读取失败" ;
-            return false;
-        }
-
-        // 应用时间偏移
-        ConvertToTimeStampedData (imu_data, gps_data);
-
-        // 按时间戳排序
-        std::sort (all_data_.begin(), all_data_.end());
-
-        return true;
-    }
-
-    //获取重组织后的数据
-    const std::vector<TimeStampedData>& GetReorganizedData() const {
-        return all_data_;
-    }
-
-private:
-
-
-    // 新增：GPS-NZZ匹配方法 - 对应Python的match_gps_nzz_data
-    void MatchGPSNZZData(const std::vector<sad::GPSWithTimeKey>& gps_data,
-                         const std::vector<sad::NZZ>& nzz_data) {
-        matched_heading_data_.clear();
-        
-        LOG(INFO) << "开始GPS-NZZ数据匹配...";
-        
-        int direct_matches = 0;
-        int fuzzy_matches = 0;
-        
-        for (const auto& gps : gps_data) {
-            bool found_match = false;
-            
-            // 1. 直接匹配
-            for (const auto& nzz : nzz_data) {
-                if (gps.time_key_ == nzz.time_key_) {
-                    // 应用GPS时间偏移
-                    double adjusted_gps_time = gps.gnss_data_.unix_time_ + gps_time_offset_;
-                    matched_heading_data_.emplace_back(adjusted_gps_time, nzz.heading_);
-                    found_match = true;
-                    direct_matches++;
-                    break;
-                }
-            }
-            
-            // 2. 如果直接匹配失败，尝试模糊匹配
-            if (!found_match) {
-                std::string gps_normalized = NormalizeTimeKey(gps.time_key_);
-                
-                for (const auto& nzz : nzz_data) {
-                    std::string nzz_normalized = NormalizeTimeKey(nzz.time_key_);
-                    
-                    if (gps_normalized == nzz_normalized) {
-                        double adjusted_gps_time = gps.gnss_data_.unix_time_ + gps_time_offset_;
-                        matched_heading_data_.emplace_back(adjusted_gps_time, nzz.heading_);
-                        found_match = true;
-                        fuzzy_matches++;
-                        break;
-                    }
-                }
-            }
-        }
-        
-        // 按时间戳排序
-        std::sort(matched_heading_data_.begin(), matched_heading_data_.end(),
-                  [](const std::pair<double, double>& a, const std::pair<double, double>& b) {
-                      return a.first < b.first;
-                  });
-        
-        LOG(INFO) << "GPS-NZZ匹配完成:";
-        LOG(INFO) << "  直接匹配: " << direct_matches << " 个";
-        LOG(INFO) << "  模糊匹配: " << fuzzy_matches << " 个";
-        LOG(INFO) << "  总匹配数: " << matched_heading_data_.size() << " 个";
-    }
-    
-    // 新增：标准化时间字符串格式 - 对应Python的normalize_time_key
-    std::string NormalizeTimeKey(const std::string& time_key) const {
-        try {
-            // 检查格式：应该包含 '-' 和 ':'
-            if (time_key.find('-') == std::string::npos || 
-                time_key.find(':') == std::string::npos) {
-                return time_key;
-            }
-            
-            // 分离日期和时间部分
-            size_t space_pos = time_key.find(' ');
-            if (space_pos == std::string::npos) {
-                return time_key;
-            }
-            
-            std::string date_part = time_key.substr(0, space_pos);
-            std::string time_part = time_key.substr(space_pos + 1);
-            
-            // 处理日期部分：YYYY-M-D -> YYYY-MM-DD
-            std::string normalized_date = NormalizeDatePart(date_part);
-            
-            // 处理时间部分：H:M:S -> HH:MM:SS
-            std::string normalized_time = NormalizeTimePart(time_part);
-            
-            return normalized_date + " " + normalized_time;
-            
-        } catch (const std::exception& e) {
-            LOG(WARNING) << "时间字符串标准化失败: " << time_key << ", 错误: " << e.what();
-            return time_key;
-        }
-    }
-    
-    // 新增：标准化日期部分
-    std::string NormalizeDatePart(const std::string& date_str) const {
-        std::vector<std::string> parts;
-        std::stringstream ss(date_str);
-        std::string item;
-        
-        while (std::getline(ss, item, '-')) {
-            parts.push_back(item);
-        }
-        
-        if (parts.size() != 3) {
-            return date_str;
-        }
-        
-        // 补零：YYYY-MM-DD
-        std::string year = parts[0];
-        std::string month = (parts[1].length() == 1) ? "0" + parts[1] : parts[1];
-        std::string day = (parts[2].length() == 1) ? "0" + parts[2] : parts[2];
-        
-        return year + "-" + month + "-" + day;
-    }
-    
-    // 新增：标准化时间部分
-    std::string NormalizeTimePart(const std::string& time_str) const {
-        std::vector<std::string> parts;
-        std::stringstream ss(time_str);
-        std::string item;
-        
-        while (std::getline(ss, item, ':')) {
-            parts.push_back(item);
-        }
-        
-        if (parts.size() != 3) {
-            return time_str;
-        }
-        
-        // 补零：HH:MM:SS
-        std::string hour = (parts[0].length() == 1) ? "0" + parts[0] : parts[0];
-        std::string minute = (parts[1].length() == 1) ? "0" + parts[1] : parts[1];
-        std::string second = (parts[2].length() == 1) ? "0" + parts[2] : parts[2];
-        
-        return hour + ":" + minute + ":" + second;
-    }
-
-     void ConvertToTimeStampedData(const std::vector<sad::IMU>& imu_data,
-                                   const std::vector<sad::GNSS>& gps_data) {
-        all_data_.clear();
-        all_data_.reserve(imu_data.size() + gps_data.size());
-
-        for (const auto& imu : imu_data) {
-            all_data_.emplace_back(imu);
-        }
-        for (auto gps : gps_data) {
-            gps.unix_time_ += gps_time_offset_;
-            all_data_.emplace_back(gps);
-        }
-    }
-};
-
-//离线ESKF
-class OfflineESKFProcessor {
-private:
-    sad::ESKFD eskf_;
-    bool first_gps_processed_ = false;
-    Vec3d origin_ = Vec3d::Zero();
-    std::ofstream correction_file_; // 位置修正量
-    std::ofstream lateral_residual_file_; // 横向残差
-
-    // 新增：转弯段信息
-    std::vector<std::pair<double, double>> turn_segments_;  // (start_time, end_time)
-
-    // 新增：GPS-NZZ匹配数据存储
-    struct MatchedGPSNZZ {
-        double gps_timestamp;
-        double nzz_heading;
-        std::string time_key;
-        
-        MatchedGPSNZZ(double gps_ts, double heading, const std::string& key)
-            : gps_timestamp(gps_ts), nzz_heading(heading), time_key(key) {}
-    };
-
-public:
-    //初始化ESKF
-    bool Initialize(const std::string& correction_output_path) {
-        if (!InitializeESKF(eskf_)){
-            return false;
-        }
-        correction_file_.open(correction_output_path);
-        if(!correction_file_.is_open()){
-            return false;
-        }
-
-        std::string lateral_path = correction_output_path.substr(0, correction_output_path.find_last_of('.')) + "_lateral.txt";
-        lateral_residual_file_.open(lateral_path);
-        if(!lateral_residual_file_.is_open()){
-            return false;
-        }
-
-        return true;
-    }
-
-    //处理重组织后的数据
-    bool ProcessReorganizedData(const std::vector<TimeStampedData>& data,
-                                const std::string& output_path) {
-        std::ofstream fout(output_path);
-        std::string cov_path = output_path.substr(0, output_path.find_last_of('.')) + "_cov.txt";
-        std::ofstream cov_file(cov_path);
-        
-        auto save_vec3 = [](std::ofstream& fout, const Vec3d& v) {
-            fout << v[0] << " " << v[1] << " " << v[2] << " ";
-        };
-        auto save_quat = [](std::ofstream& fout, const Quatd& q) {
-            fout << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << " ";
-        };
-
-        auto save_result = [&](const sad::NavStated& state, const Vec3d& gps_pos, bool has_gps) {
-            fout << std::setprecision(18) << state.timestamp_ << " " << std::setprecision(9);
-            save_vec3(fout, state.p_);
-            save_quat(fout, state.R_.unit_quaternion());
-            save_vec3(fout, state.v_);
-            save_vec3(fout, state.bg_);
-            save_vec3(fout, state.ba_);
-            if (has_gps) {
-                save_vec3(fout, gps_pos);
-                fout << "1";
-            } else {
-                fout<< "0 0 0 0";
-            }
-            fout << std::endl;
-        };
-
-        Vec3d latest_gps_pos = Vec3d::Zero();
-        bool has_latest_gps = false;
-
-        for (const auto& timestamped_data : data) {
-            if (timestamped_data.type == TimeStampedData::IMU_TYPE) {
-                if (ProcessIMU(timestamped_data.imu_data, cov_file)){
-                    auto state = eskf_.GetNominalState();
-                    save_result(state, latest_gps_pos, has_latest_gps);
-                }
-            } else {
-                Vec3d gps_pos;
-                if (ProcessGPS(timestamped_data.gps_data, gps_pos)) {
-                    latest_gps_pos = gps_pos;
-                    has_latest_gps = true;
-                    eskf_.SaveCovariance(cov_file);
-                }
-            }
-        }
-        return true;
-    }
-
-    // 新增：设置转弯段信息
-    void SetTurnSegments(const std::vector<TurnDetector::TurnSegment>& segments) {
-        turn_segments_.clear();
-        for (const auto& segment : segments) {
-            turn_segments_.emplace_back(segment.start_time, segment.end_time);
-        }
-        LOG(INFO) << "设置转弯段信息: " << turn_segments_.size() << " 个转弯段";
-    }
-
-    // 新增：设置FBK数据
-    void SetFBKData(const std::vector<sad::FBKPair>& fbk_data) {
-        for (const auto& fbk_pair : fbk_data) {
-            if (fbk_pair.valid_) {
-                eskf_.AddFBKData(fbk_pair.flag_.timestamp_, 
-                                fbk_pair.misalignment_.pitch_, 
-                                fbk_pair.misalignment_.heading_);
-            }
-        }
-        LOG(INFO) << "设置FBK数据: " << fbk_data.size() << " 个FBK数据对";
-    }
-
-private:
-    bool ProcessIMU(const sad::IMU& imu, std::ofstream& cov_file) {
-        //等待第一个GPS
-        if(!first_gps_processed_) {
-            return false;
-        }
-
-        bool success = eskf_.Predict(imu);
-        if (success) {
-            eskf_.SaveCovariance(cov_file);
-        }
-        return success;
-    }
-
-    // 新增：检查是否在转弯段内
-    bool IsInTurnSegment(double timestamp) const {
-        for (const auto& segment : turn_segments_) {
-            if (timestamp >= segment.first && timestamp <= segment.second) {
-                return true;
-            }
-        }
-        return false;
-    }
-
-    bool ProcessGPS(const sad::GNSS& gps, Vec3d& gps_pos) {
-        sad::GNSS gps_convert = gps;
-        if (!sad::ConvertGps2UTM(gps_convert, Vec2d::Zero(), 0.0)) {
-            LOG(WARNING) << "GPS坐标转换失败";
-            return false;
-        }
-        if (!first_gps_processed_) {
-            origin_ = gps_convert.utm_pose_.translation();
-            first_gps_processed_ = true;
-        }
-        //应用原点偏移
-        gps_pos = gps_convert.utm_pose_.translation() - origin_;
-        gps_convert.utm_pose_.translation() -= origin_;
-        
-        Vec3d pos_before = eskf_.GetNominalState().p_;
-        Vec3d pos_residual = gps_convert.utm_pose_.translation() - pos_before;
-
-        double lateral_residual = eskf_.ComputeLateralResidual(pos_residual);
-        double heading = eskf_.GetCurrentHeading();
-        double speed = eskf_.GetNominalState().v_.norm();
-        double residual_norm = pos_residual.norm();
-
-        lateral_residual_file_ << std::fixed << std::setprecision(9)
-                               << gps.unix_time_ << " "
-                               << lateral_residual << " "
-                               << heading << " "
-                               << speed << " "
-                               << pos_residual.x() << " " << pos_residual.y() << " "
-                               << residual_norm
-                               << std::endl;
-
-        // 新增：根据转弯状态选择观测方式
-        bool success = false;
-        if (IsInTurnSegment(gps.unix_time_)) {
-            // 转弯期间：只做位置观测
-            success = eskf_.ObservePositionOnly(gps_convert);
-        } else {
-            // 直线期间：完整观测
-            success = eskf_.ObserveGps(gps_convert);
-        }
-
-        if(success) {
-            Vec3d pos_after = eskf_.GetNominalState().p_;
-            Vec3d pos_correction = pos_after - pos_before;
-            double correction_norm = pos_correction.norm();
-            double residual_norm = pos_residual.norm();
-            correction_file_ << std::fixed << std::setprecision(9)
-                             << gps.unix_time_ << " "
-                             << pos_correction.x() << " " << pos_correction.y() << " " << pos_correction.z() << " "
-                             << correction_norm << " "
-                             << pos_residual.x() << " " << pos_residual.y() << " " << pos_residual.z() << " "
-                             << residual_norm
-                             << std::endl;
-        }
-        return success;
-    }
-};
-
-//离线模式
-int RunOfflineMode() {
-    LOG(INFO) << "离线模式";
-    if (FLAGS_enable_turn_detection) {
-        LOG(INFO) << "转弯检测: 启用";
-    } else {
-        LOG(INFO) << "转弯检测: 关闭";
-    }
-    LOG(INFO) << "GPS时间偏移" << FLAGS_gps_time_offset << "s";
-    
-    //数据管理器
-    OfflineDataManager data_manager;
-    data_manager.SetGPSTimeOffset(FLAGS_gps_time_offset);
-
-    if(!data_manager.LoadAndReorganizeData(FLAGS_txt_path)) {
-        LOG(ERROR) << "数据加载失败";
-        return -1;
-    }
-
-    std::string correction_path_ = "corrections";
-    if (FLAGS_gps_time_offset != 0.0){
-        correction_path_ += "_" + std::to_string(static_cast<int>(FLAGS_gps_time_offset * 1000)) + "ms";
-    }
-    correction_path_ += ".txt";
-
-    //ESKF处理器
-    OfflineESKFProcessor processor;
-    if (!processor.Initialize(correction_path_)) {
-        LOG(ERROR) << "ESKF初始化失败";
-        return -1;
-    }
-
-    // 设置FBK数据到处理器
-    const auto& fbk_data = data_manager.GetFBKData();
-    if (!fbk_data.empty()) {
-        processor.SetFBKData(fbk_data);
-    }
-
-    // 转弯检测
-    std::vector<TurnDetector::TurnSegment> detected_turns;
-    if (FLAGS_enable_turn_detection) {
-        LOG(INFO) << "开始转弯检测分析...";
-        
-        // 获取GPS-NZZ匹配数据
-        const auto& matched_data = data_manager.GetMatchedHeadingData();
-        
-        if (matched_data.empty()) {
-            LOG(WARNING) << "没有匹配的GPS-NZZ数据，跳过转弯检测";
-        } else {
-            // 转弯检测器配置
-            TurnDetector turn_detector;
-            TurnDetector::Config config;
-            config.start_turn_rate_threshold = 3.0;
-            config.end_turn_rate_threshold = 1.5;
-            config.end_duration_threshold = 3.0;
-            config.accumulated_angle_threshold = 30.0;
-            
-            // 转弯检测输出文件名
-            std::string turn_output_filename = "turns_offline";
-            if (FLAGS_gps_time_offset != 0.0) {
-                int offset_ms = static_cast<int>(FLAGS_gps_time_offset * 1000);
-                turn_output_filename += "_" + std::to_string(offset_ms) + "ms";
-            }
-            turn_output_filename += ".txt";
-            
-            if (!turn_detector.Initialize(turn_output_filename, config)) {
-                LOG(ERROR) << "转弯检测器初始化失败";
-                return -1;
-            }
-            
-            // 添加匹配的航向数据进行转弯检测
-            for (const auto& data : matched_data) {
-                turn_detector.AddHeadingData(data.first, data.second);
-            }
-            
-            // 完成转弯检测
-            turn_detector.Finalize();
-
-            // 获取检测到的转弯段
-            detected_turns = turn_detector.GetDetectedTurns();
-
-            LOG(INFO) << "转弯检测分析完成";
-        }
-    }
-
-    // 设置转弯段信息到处理器
-    if (!detected_turns.empty()) {
-        processor.SetTurnSegments(detected_turns);
-    }
-
-    std::string output_path = "gins_offline";
-    if (FLAGS_gps_time_offset != 0.0) {
-        int offset_ms = static_cast<int>(FLAGS_gps_time_offset * 1000);
-        output_path += "_" + std::to_string(offset_ms) + "ms";
-    }
-    output_path += ".txt";
-
-    if (!processor.ProcessReorganizedData(data_manager.GetReorganizedData(), output_path)) {
-        LOG(ERROR) << "数据处理失败";
-        return -1;
-    }
-
-    return 0;
-}
-
-int RunRealtimeMode() {
-    sad::ESKFD eskf;
-    sad::TxtIO io(FLAGS_txt_path);
-    auto save_vec3 = [](std::ofstream& fout, const Vec3d& v) { fout << v[0] << " " << v[1] << " " << v[2] << " "; };
-    auto save_quat = [](std::ofstream& fout, const Quatd& q) {
-        fout << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << " ";
-    };
-    auto save_result = [&save_vec3, &save_quat](std::ofstream& fout, const sad::NavStated& save_state,
-                                                const Vec3d& gps_pos = Vec3d::Zero(), bool has_gps = false) {
-        fout << std::setprecision(18) << save_state.timestamp_ << " " << std::setprecision(9);
-        save_vec3(fout, save_state.p_);
-        save_quat(fout, save_state.R_.unit_quaternion());
-        save_vec3(fout, save_state.v_);
-        save_vec3(fout, save_state.bg_);
-        save_vec3(fout, save_state.ba_);
-        if (has_gps) {
-            save_vec3 (fout, gps_pos);
-            fout << "1";
-        } else {
-            fout << "0 0 0 0";
-        }
-        fout << std::endl;
-    };
-    std::ofstream fout("/Users/cjj/work/GNSS_INS/slam/gnss_imu_time/data/ch3/gins_realtime.txt");
-
-    // 新增：P矩阵协方差数据文件
-    std::ofstream cov_file("/Users/cjj/work/GNSS_INS/slam/gnss_imu_time/data/ch3/covariance_realtime.txt");
-
-    bool imu_inited = false, gnss_inited = false;
-
-    LOG(INFO) << "初始化ESKF";
-    if (InitializeESKF(eskf)) {
-        imu_inited = true;
-    }
-
-    //GNSS缓存队列
-    std::queue<sad::GNSS> pending_gps_queue;
-
-    /// 设置各类回调函数
-    bool first_gnss_set = false;
-    Vec3d origin = Vec3d::Zero();
-
-    //存储最新的GPS观测位置
-    Vec3d latest_gps_pos = Vec3d::Zero();
-    bool has_latest_gps = false;
-    double latest_gps_time = 0.0;
-
-    io.SetIMUProcessFunc([&](const sad::IMU& imu) {
-          /// IMU 处理函数
-
-          if (!gnss_inited) {
-              /// 等待有效的RTK数据
-              return;
-          }
-
-          /// GNSS 也接收到之后，再开始进行预测
-          eskf.Predict(imu);
-
-          // 记录IMU预测后的协方差
-          eskf.SaveCovariance(cov_file);
-
-          /// predict就会更新ESKF，所以此时就可以发送数据
-          auto current_state = eskf.GetNominalState();
-          double current_eskf_time = current_state.timestamp_;
-
-          //检查是否有GPS数据需要处理
-          while (!pending_gps_queue.empty()) {
-            sad::GNSS& catch_gps = pending_gps_queue.front();
-            //IMU递推到缓存的GNSS时刻
-            if (current_eskf_time >= catch_gps.unix_time_) {
-                LOG(INFO) << "=== 处理缓存的GPS数据 ===";
-                LOG(INFO) << "IMU时间: " << std::fixed << std::setprecision(9) << current_eskf_time
-                          << ", GPS时间: " << std::fixed << std::setprecision(9) << catch_gps.unix_time_;
-                try{
-
-                    eskf.ObserveGps(catch_gps);
-
-                    // 记录GPS更新后的协方差
-                    eskf.SaveCovariance(cov_file);
-
-                    LOG(INFO) << "GPS观测成功, 时间同步正确";
-                } catch (...) {
-                    LOG (ERROR) << "GNSS观测失败";
-                }
-                pending_gps_queue.pop();
-            }else {
-                // IMU还没追上GPS时刻，退出循环
-                LOG(INFO) << "等待IMU递推: current=" << std::fixed << std::setprecision(9) << current_eskf_time 
-                          << ", waiting_gps=" << catch_gps.unix_time_;
-                break;
-            }
-          }
-
-          //检查是否有时间接近的GPS观测数据
-          bool use_gps_obs = false;
-          Vec3d gps_obs_pos = Vec3d::Zero();
-          if (has_latest_gps) {
-              use_gps_obs = true;
-              gps_obs_pos = latest_gps_pos;
-          }
-          /// 记录数据以供绘图
-          save_result(fout, current_state, gps_obs_pos, use_gps_obs);
-
-          usleep(1e3);
-      })
-        .SetGNSSProcessFunc([&](const sad::GNSS& gnss) {
-            /// GNSS 处理函数 - 详细调试版本
-            if (!imu_inited) {
-                LOG(INFO) << "GPS: IMU未初始化，跳过";
-                return;
-            }
-            //添加GNSS时间延迟
-            sad::GNSS gnss_convert = gnss;
-            gnss_convert.unix_time_ += 0.0;
-
-            auto current_state = eskf.GetNominalState();
-            double current_eskf_time = current_state.timestamp_;
-            
-            LOG(INFO) << "=== GPS数据到达 ===";
-            LOG(INFO) << "原始GPS时间: " << gnss.unix_time_ << "s";
-            LOG(INFO) << "延迟GPS时间: " << gnss_convert.unix_time_ << "s"; 
-            LOG(INFO) << "当前ESKF时间: " << current_eskf_time << "s";
-            LOG(INFO) << "时间差: " << (gnss_convert.unix_time_ - current_eskf_time) << "s";
-
-            // 跳过太旧的GPS
-            if (gnss_convert.unix_time_ < current_eskf_time - 5.0) {
-                LOG(WARNING) << "GPS数据太旧，跳过";
-                return;
-            }
-            if (!sad::ConvertGps2UTM(gnss_convert, Vec2d::Zero(), 0.0)) {
-                LOG(WARNING) << "GPS坐标转换失败";
-                return;
-            }
-            /// 设置地图原点（去掉原点）
-            if (!first_gnss_set) {
-                origin = gnss_convert.utm_pose_.translation();
-                first_gnss_set = true;
-                LOG(INFO) << "设置地图原点: " << origin.transpose();
-            } else {
-                LOG(INFO) << "步骤6 - 使用已有地图原点";
-            }
-            
-            //保存GPS观测位置（去掉原点）
-            Vec3d gps_obs_position = gnss_convert.utm_pose_.translation() - origin;
-            latest_gps_pos = gps_obs_position;
-            has_latest_gps = true;
-            latest_gps_time = gnss_convert.unix_time_;
-
-            LOG(INFO) << "步骤6.5 - 保存GPS观测位置" << gps_obs_position.transpose();
-
-            gnss_convert.utm_pose_.translation() -= origin;
-            
-            LOG(INFO) << "步骤7 - 应用地图原点后，GPS时间戳: " << gnss_convert.unix_time_ << "s";
-
-            try {
-                if (current_eskf_time >= gnss_convert.unix_time_) {
-                    LOG(INFO) << "GPS时间不超前, 立即处理";
-                    eskf.ObserveGps(gnss_convert);
-                    eskf.SaveCovariance(cov_file);
-                    LOG(INFO) << "GPS观测成功";
-                    gnss_inited = true;
-                } else {
-                    LOG(INFO) << "GPS时间超前, 缓存等待IMU递推";
-                    pending_gps_queue.push(gnss_convert);
-                    gnss_inited = true;
-                }
-            } catch (...) {
-                LOG(ERROR) << "GPS观测异常";
-            }
-
-            
-            LOG(INFO) << "=== GPS处理结束 ===";
-        })
-
-        .SetFBKPairProcessFunc([&](const sad::FBKPair& fbk_pair) {
-            if (fbk_pair.valid_) {
-                eskf.AddFBKData(fbk_pair.flag_.timestamp_, 
-                            fbk_pair.misalignment_.pitch_, 
-                            fbk_pair.misalignment_.heading_);
-                LOG(INFO) << "添加FBK数据: t=" << fbk_pair.flag_.timestamp_ << "s, "
-                        << "pitch=" << fbk_pair.misalignment_.pitch_ << "°, "
-                        << "heading=" << fbk_pair.misalignment_.heading_ << "°";
-            }
-        })
-        .Go();
-
-    return 0;
-}
-
-int main(int argc, char** argv) {
-    google::InitGoogleLogging(argv[0]);
-    FLAGS_stderrthreshold = google::INFO;
-    FLAGS_colorlogtostderr = true;
-    google::ParseCommandLineFlags(&argc, &argv, true);
-
-    if (FLAGS_txt_path.empty()) {
-        return -1;
-    }
-
-    if (FLAGS_offline_mode) {
-        return RunOfflineMode();
-    } else {
-        return RunRealtimeMode();
-    }
+//
+// Created by xiang on 2021/11/11.
+//
+
+#include "ch3/eskf.hpp"
+#include "ch3/eskf_time_offset.hpp"
+#include "ch3/offset_sweep.h"
+#include "ch3/time_lag_estimator.h"
+#include "common/io_utils.h"
+#include "common/sensor_cache.h"
+#include "common/sensor_stream.h"
+#include "common/sensor_timeline.h"
+#include "common/txt_reader.h"
+#include "utm_convert.h"
+#include "turn_detector.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+
+DEFINE_string(txt_path, "/Users/cjj/Data/vdr_plog/Honor_V40/vdr_20250523_162014_895.log", "数据文件路径");
+DEFINE_bool(offline_mode, false, "是否使用离线重组织模式，同时使用转弯检测");
+DEFINE_double(gps_time_offset, 0.0, "GPS时间偏移");
+DEFINE_bool(enable_turn_detection, true, "是否启用转弯检测（仅在离线模式下有效）");  // 新增，默认开启
+DEFINE_bool(use_data_cache, true, "离线模式下缓存解析结果，同一日志再次运行时直接加载缓存");
+DEFINE_string(data_cache_path, "", "解析结果缓存文件路径，为空时使用<txt_path>.cache");
+DEFINE_int32(io_threads, 0, "离线模式解析日志的线程数，0表示使用全部CPU核");
+DEFINE_double(stream_window, 0.0, "离线模式按时间窗口流式读取IMU/GNSS的重排窗口长度(秒)，内存只与窗口有关；0表示全部读入后排序");
+DEFINE_string(gps_time_offset_sweep, "", "离线模式只解析一次日志，依次处理多个GPS时间偏移，格式start:end:step，如0:-0.4:-0.05；设置后忽略gps_time_offset");
+DEFINE_int32(sweep_threads, 0, "GPS时间偏移扫描的并行线程数，0表示使用全部CPU核");
+DEFINE_bool(estimate_time_lag, false, "离线模式用IMU与航向变化率的FFT互相关直接估计GPS时间偏移，写入time_lag_estimation.txt后退出");
+DEFINE_bool(save_body_acce, true, "离线模式是否输出车体系加速度body_acce.txt，偏移扫描时只由最后一个偏移输出，偏移寻优时为最优偏移的结果");
+DEFINE_string(sweep_summary_path, "", "GPS时间偏移扫描的处理汇总文件，格式与批处理脚本的processing_summary.txt相同，为空时不写");
+DEFINE_bool(estimate_time_offset_online, false, "离线模式在ESKF误差状态中增加GPS时间偏移，一次运行在线估计，逐个GNSS观测写入time_offset_online.txt");
+DEFINE_double(time_offset_init_std, 0.1, "在线估计GPS时间偏移的初始标准差(秒)");
+DEFINE_bool(dynamic_installation_angles, false, "IMU时间每越过一个FBK数据就切换到该数据的安装角，关闭时只在首个GNSS设置一次");
+DEFINE_bool(dense_covariance_propagation, false, "用稠密的18x18矩阵乘法传播和投影协方差，用于验证分块计算的结果");
+DEFINE_bool(packed_covariance, false, "ESKF协方差只按上三角存放171个元素，传播、投影和观测更新只写上三角");
+DEFINE_string(eskf_update_method, "dense", "ESKF观测更新的计算方式: dense(稠密矩阵求逆，默认), ldlt(LDLT求解，对称更新), sequential(逐个标量观测)");
+DEFINE_string(gps_time_offset_optimize, "", "离线模式在区间start:end内用Brent法寻找转弯段横向残差RMS最小的GPS时间偏移，如-0.4:0；设置后忽略gps_time_offset");
+DEFINE_double(optimize_tolerance, 0.001, "GPS时间偏移寻优的精度(秒)，求值的偏移舍入到毫秒，因此不应小于0.001");
+DEFINE_int32(optimize_max_evals, 20, "GPS时间偏移寻优最多运行滤波的次数");
+
+/**
+ * 本程序演示使用RTK+IMU进行组合导航
+ */
+template <typename ESKFType>
+bool InitializeESKF(ESKFType& eskf, const std::string& body_acce_path = "body_acce.txt"){
+    // 陀螺零偏 (度/秒) 
+    const double GYRO_BIAS_X = 0.001711;
+    const double GYRO_BIAS_Y = -0.021235;
+    const double GYRO_BIAS_Z = 0.049159;
+    
+    // 加速度零偏 (m/s²) 
+    const double ACCEL_BIAS_X = -0.013369;
+    const double ACCEL_BIAS_Y = -0.020087;
+    const double ACCEL_BIAS_Z = 0.101552;
+    
+    typename ESKFType::Options options;
+    options.gyro_var_ = 2e-3;     // 陀螺噪声
+    options.acce_var_ = 5e-2;     // 加速度噪声
+    options.bias_gyro_var_ = 1e-6; // 陀螺零偏随机游走
+    options.bias_acce_var_ = 1e-4; // 加速度零偏随机游走
+    options.body_acce_path_ = body_acce_path;
+    options.dynamic_installation_angles_ = FLAGS_dynamic_installation_angles;
+    options.dense_covariance_propagation_ = FLAGS_dense_covariance_propagation;
+    options.packed_covariance_ = FLAGS_packed_covariance;
+    if (FLAGS_eskf_update_method == "ldlt") {
+        options.update_method_ = ESKFType::UpdateMethod::LDLT;
+    } else if (FLAGS_eskf_update_method == "sequential") {
+        options.update_method_ = ESKFType::UpdateMethod::SEQUENTIAL;
+    } else if (FLAGS_eskf_update_method == "dense") {
+        options.update_method_ = ESKFType::UpdateMethod::DENSE;
+    } else {
+        LOG(ERROR) << "未知的ESKF观测更新方式: " << FLAGS_eskf_update_method;
+        return false;
+    }
+
+    Vec3d init_bg(GYRO_BIAS_X * sad::math::kDEG2RAD, GYRO_BIAS_Y * sad::math::kDEG2RAD, GYRO_BIAS_Z * sad::math::kDEG2RAD);
+    Vec3d init_ba(ACCEL_BIAS_X, ACCEL_BIAS_Y, ACCEL_BIAS_Z);
+    Vec3d gravity(0, 0, -9.8);
+
+    eskf.SetInitialConditions(options, init_bg, init_ba, gravity);
+    return true;
+
+
+}
+
+//离线数据管理
+class OfflineDataManager {
+private:
+    // IMU/GNSS表，GNSS时间不含偏移，各GPS时间偏移共享
+    std::shared_ptr<const sad::SensorTables> tables_;
+
+    // GNSS表逐行的UTM位姿，只转换一次，各GPS时间偏移共享
+    sad::GNSSUTMTable utm_table_;
+
+    // 新增：GPS-NZZ匹配结果存储，未叠加GPS时间偏移
+    std::vector<std::pair<double, double>> matched_heading_data_; // (gps_timestamp, nzz_heading)
+
+    // 新增：FBK数据存储
+    std::vector<sad::FBKPair> fbk_data_;
+
+    // 解析结果缓存文件路径，为空则不使用缓存
+    std::string cache_path_;
+
+    // 解析日志的线程数
+    int io_threads_ = 1;
+
+public:
+
+    //读取所有数据，IMU/GNSS直接放入按列存放的传感器表
+    bool ReadAllData(const std::string& file_path, sad::SensorCacheData& data) {
+
+        // 缓存有效时直接加载，跳过文本解析
+        // 读取出错时数据不完整，不写缓存，以免之后直接加载残缺的数据
+        if (cache_path_.empty() || !sad::LoadSensorCache(cache_path_, file_path, data)) {
+            if (!ParseLogFile(file_path, data)) {
+                return false;
+            }
+            if (!cache_path_.empty()) {
+                sad::SaveSensorCache(cache_path_, file_path, data);
+            }
+        }
+
+        matched_heading_data_ = std::move(data.matched_heading_);
+        fbk_data_ = std::move(data.fbk_);
+        return data.tables_.imu_.Size() > 0 && data.tables_.gnss_.Size() > 0;
+     }
+
+    /// 获取匹配的航向数据，叠加GPS时间偏移后按时间排序
+    std::vector<std::pair<double, double>> GetMatchedHeadingData(double gps_time_offset) const {
+        std::vector<std::pair<double, double>> matched;
+        matched.reserve(matched_heading_data_.size());
+        for (const auto& m : matched_heading_data_) {
+            matched.emplace_back(m.first + gps_time_offset, m.second);
+        }
+
+        // 按时间戳排序
+        std::sort(matched.begin(), matched.end(),
+                  [](const std::pair<double, double>& a, const std::pair<double, double>& b) {
+                      return a.first < b.first;
+                  });
+        return matched;
+    }
+
+    /// 获取IMU/GNSS表，GNSS时间不含偏移
+    const std::shared_ptr<const sad::SensorTables>& GetSensorTables() const {
+        return tables_;
+    }
+
+    /// 获取与GNSS表逐行对应的UTM位姿
+    const sad::GNSSUTMTable& GetUTMTable() const {
+        return utm_table_;
+    }
+
+    // 新增：获取FBK数据
+    const std::vector<sad::FBKPair>& GetFBKData() const {
+        return fbk_data_;
+    }
+
+    /// 设置解析结果缓存文件路径，为空则不使用缓存
+    void SetCachePath(const std::string& cache_path) {
+        cache_path_ = cache_path;
+    }
+
+    /// 设置解析日志的线程数
+    void SetIOThreads(int io_threads) {
+        io_threads_ = std::max(1, io_threads);
+    }
+
+    /// 读取数据并建立IMU/GNSS表，表只建一次，各GPS时间偏移通过BuildTimeline共享
+    bool LoadSensorTables(const std::string& file_path) {
+        sad::SensorCacheData data;
+
+        // 读取数据
+        if(!ReadAllData(file_path, data)) {
+            LOG(ERROR) << "数据读取失败" ;
+            return false;
+        }
+
+        tables_ = std::make_shared<const sad::SensorTables>(std::move(data.tables_));
+        LOG(INFO) << "传感器数据表: IMU " << tables_->imu_.Size() << " 条, GNSS " << tables_->gnss_.Size()
+                  << " 条, 占用 " << tables_->MemoryBytes() / (1024.0 * 1024.0) << " MB";
+
+        // GPS时间偏移不改变位置，UTM转换在这里做一次，滤波时按行查表
+        auto start = std::chrono::steady_clock::now();
+        if (!sad::ConvertGNSSTable2UTM(tables_->gnss_, Vec2d::Zero(), 0.0, utm_table_)) {
+            LOG(ERROR) << "GPS坐标转换失败";
+            return false;
+        }
+        double time_used = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+        LOG(INFO) << "GNSS UTM位姿表: " << utm_table_.Size() << " 条, 占用 "
+                  << utm_table_.MemoryBytes() / (1024.0 * 1024.0) << " MB, 耗时 " << time_used << " ms";
+        return true;
+    }
+
+    /// 在共享的表上应用GPS时间偏移并按时间戳归并
+    void BuildTimeline(double gps_time_offset, sad::SensorTimeline& timeline) const {
+        timeline.Build(tables_, gps_time_offset);
+        const auto& stats = timeline.GetStats();
+        LOG(INFO) << "GPS时间偏移" << gps_time_offset << "s 重组织数据: " << timeline.Size() << " 条, 事件占用 "
+                  << timeline.EventMemoryBytes() / (1024.0 * 1024.0) << " MB";
+        LOG(INFO) << "  乱序位置: IMU " << stats.imu_descents_ << " 处, GNSS " << stats.gnss_descents_
+                  << " 处, 修复逆序 " << stats.inversions_ << " 个"
+                  << (stats.imu_sorted_ || stats.gnss_sorted_ ? ", 乱序过多已改用排序" : "");
+    }
+
+    /// 流式处理时只读取低频的GPS-NZZ匹配与FBK数据，IMU/GNSS由SensorStream按时间顺序逐条提供
+    bool LoadAuxiliaryData(const std::string& file_path) {
+        if (!std::ifstream(file_path).good()) {
+            LOG(ERROR) << "未能找到文件: " << file_path;
+            return false;
+        }
+
+        std::vector<sad::GPSWithTimeKey> gps_with_timekey;
+        std::vector<sad::NZZ> nzz_data;
+        std::vector<sad::FBKPair> fbk_data;
+
+        sad::TxtReader reader(file_path, sad::TxtReadMode::MMAP,
+                              sad::Overloaded{[&](const sad::GPSWithTimeKey& gps_timekey) {
+                                                  gps_with_timekey.push_back(gps_timekey);
+                                              },
+                                              [&](const sad::NZZ& nzz) { nzz_data.push_back(nzz); },
+                                              [&](const sad::FBKPair& fbk_pair) { fbk_data.push_back(fbk_pair); }});
+        if (!reader.SetNumThreads(io_threads_).Go()) {
+            LOG(ERROR) << "辅助数据读取失败: " << file_path;
+            return false;
+        }
+
+        LOG(INFO) << "辅助数据读取完成: GPS=" << gps_with_timekey.size() << ", NZZ=" << nzz_data.size()
+                  << ", FBK=" << fbk_data.size();
+
+        MatchGPSNZZData(gps_with_timekey, nzz_data, matched_heading_data_);
+        fbk_data_ = std::move(fbk_data);
+        return true;
+    }
+
+private:
+
+    /// 解析文本日志，GPS-NZZ匹配结果不含时间偏移，便于缓存后在不同偏移下复用；读取出错时返回false
+    bool ParseLogFile(const std::string& file_path, sad::SensorCacheData& data) {
+        // 新增：收集GPS-NZZ匹配数据
+        std::vector<sad::GPSWithTimeKey> gps_with_timekey;
+        std::vector<sad::NZZ> nzz_data;
+
+        // 离线模式一次性读完整个文件，使用内存映射方式，多线程分块解析
+        // 处理器在编译期绑定，逐条记录的回调可被内联
+        sad::TxtReader reader(file_path, sad::TxtReadMode::MMAP,
+                              sad::Overloaded{[&](const sad::IMU& imu) { data.tables_.imu_.Push(imu); },
+                                              [&](const sad::GNSS& gps) { data.tables_.gnss_.Push(gps); },
+                                              [&](const sad::GPSWithTimeKey& gps_timekey) {
+                                                  gps_with_timekey.push_back(gps_timekey);
+                                              },
+                                              [&](const sad::NZZ& nzz) { nzz_data.push_back(nzz); },
+                                              [&](const sad::FBKPair& fbk_pair) { data.fbk_.push_back(fbk_pair); }});
+        if (!reader.SetNumThreads(io_threads_).Go()) {
+            LOG(ERROR) << "日志读取失败: " << file_path;
+            return false;
+        }
+
+        LOG(INFO) << "数据读取完成: GPS=" << gps_with_timekey.size() 
+                  << ", NZZ=" << nzz_data.size() << ", FBK=" << data.fbk_.size();
+        
+        // 新增：进行GPS-NZZ匹配
+        MatchGPSNZZData(gps_with_timekey, nzz_data, data.matched_heading_);
+        return true;
+    }
+
+    // 新增：GPS-NZZ匹配方法 - 对应Python的match_gps_nzz_data
+    // matched中为(GPS原始时间, NZZ航向)
+    // 以时间键为键建立NZZ的哈希索引，每个GPS数据查一次表，结果与逐个比较时相同：
+    // 优先取写法与GPS相同（直接匹配）的第一个NZZ，没有时取时间相同（模糊匹配）的第一个NZZ
+    void MatchGPSNZZData(const std::vector<sad::GPSWithTimeKey>& gps_data,
+                         const std::vector<sad::NZZ>& nzz_data,
+                         std::vector<std::pair<double, double>>& matched) {
+        matched.clear();
+        
+        LOG(INFO) << "开始GPS-NZZ数据匹配...";
+        auto start = std::chrono::steady_clock::now();
+
+        struct NZZIndex {
+            int direct = -1;  // 写法与GPS相同的第一个NZZ
+            int fuzzy = -1;   // 时间相同的第一个NZZ
+        };
+        std::unordered_map<sad::TimeKey, NZZIndex> nzz_index;
+        nzz_index.reserve(nzz_data.size());
+        for (int i = 0; i < static_cast<int>(nzz_data.size()); ++i) {
+            NZZIndex& index = nzz_index[nzz_data[i].time_key_];
+            if (index.fuzzy < 0) {
+                index.fuzzy = i;
+            }
+            if (index.direct < 0 && nzz_data[i].unpadded_) {
+                index.direct = i;
+            }
+        }
+
+        int direct_matches = 0;
+        int fuzzy_matches = 0;
+        matched.reserve(gps_data.size());
+
+        for (const auto& gps : gps_data) {
+            auto it = nzz_index.find(gps.time_key_);
+            if (it == nzz_index.end()) {
+                VLOG(1) << "GPS时间 " << sad::FormatTimeKey(gps.time_key_) << " 没有对应的NZZ数据";
+                continue;
+            }
+
+            if (it->second.direct >= 0) {
+                matched.emplace_back(gps.gnss_data_.unix_time_, nzz_data[it->second.direct].heading_);
+                direct_matches++;
+            } else {
+                // NZZ时间带补零，如"2025-06-12 11:22:27"
+                matched.emplace_back(gps.gnss_data_.unix_time_, nzz_data[it->second.fuzzy].heading_);
+                fuzzy_matches++;
+            }
+        }
+
+        double time_used = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+        LOG(INFO) << "GPS-NZZ匹配完成:";
+        LOG(INFO) << "  直接匹配: " << direct_matches << " 个";
+        LOG(INFO) << "  模糊匹配: " << fuzzy_matches << " 个";
+        LOG(INFO) << "  未匹配: " << gps_data.size() - matched.size() << " 个";
+        LOG(INFO) << "  总匹配数: " << matched.size() << " 个";
+        LOG(INFO) << "  NZZ时间键: " << nzz_index.size() << " 个, 耗时 " << time_used << " ms";
+    }
+};
+
+//离线ESKF，ESKFType为sad::ESKFTimeOffsetD时同时在线估计GPS时间偏移
+template <typename ESKFType = sad::ESKFD>
+class OfflineESKFProcessor {
+private:
+    static constexpr bool kEstimateTimeOffset = std::is_same<ESKFType, sad::ESKFTimeOffsetD>::value;
+
+    ESKFType eskf_;
+    bool first_gps_processed_ = false;
+    Vec3d origin_ = Vec3d::Zero();
+    std::ofstream correction_file_; // 位置修正量
+    std::ofstream lateral_residual_file_; // 横向残差
+    std::ofstream time_offset_file_; // 在线估计的时间偏移
+
+    double gps_time_offset_ = 0.0; // 已叠加在GNSS时间上的偏移
+    std::vector<std::pair<double, double>> lateral_residuals_; // (GNSS时间, 横向残差)，与_lateral.txt的前两列相同
+
+    // 新增：转弯段信息
+    std::vector<std::pair<double, double>> turn_segments_;  // (start_time, end_time)
+
+    // 新增：GPS-NZZ匹配数据存储
+    struct MatchedGPSNZZ {
+        double gps_timestamp;
+        double nzz_heading;
+        sad::TimeKey time_key;
+        
+        MatchedGPSNZZ(double gps_ts, double heading, sad::TimeKey key)
+            : gps_timestamp(gps_ts), nzz_heading(heading), time_key(key) {}
+    };
+
+public:
+    //初始化ESKF
+    // body_acce_path为空时不输出车体系加速度，多个处理器并行时只能有一个写同一文件
+    bool Initialize(const std::string& correction_output_path, const std::string& body_acce_path = "body_acce.txt") {
+        if (!InitializeESKF(eskf_, body_acce_path)){
+            return false;
+        }
+        correction_file_.open(correction_output_path);
+        if(!correction_file_.is_open()){
+            return false;
+        }
+
+        std::string lateral_path = correction_output_path.substr(0, correction_output_path.find_last_of('.')) + "_lateral.txt";
+        lateral_residual_file_.open(lateral_path);
+        if(!lateral_residual_file_.is_open()){
+            return false;
+        }
+
+        if constexpr (kEstimateTimeOffset) {
+            sad::ESKFTimeOffsetD::TimeOffsetOptions td_options;
+            td_options.init_time_offset_std_ = FLAGS_time_offset_init_std;
+            eskf_.SetTimeOffsetOptions(td_options);
+        }
+        return true;
+    }
+
+    /// 逐个GNSS观测输出在线估计的时间偏移，time_offset为叠加在GNSS时间上的固定偏移
+    bool OpenTimeOffsetOutput(const std::string& path, double gps_time_offset) {
+        time_offset_file_.open(path);
+        if (!time_offset_file_.is_open()) {
+            return false;
+        }
+        gps_time_offset_ = gps_time_offset;
+        time_offset_file_ << "# timestamp time_offset time_offset_std (s)" << std::endl;
+        return true;
+    }
+
+    const ESKFType& GetESKF() const { return eskf_; }
+
+    const std::vector<std::pair<double, double>>& GetLateralResiduals() const { return lateral_residuals_; }
+
+    //处理重组织后的数据，utm_table为与时间线的GNSS表逐行对应的UTM位姿
+    bool ProcessReorganizedData(const sad::SensorTimeline& data, const sad::GNSSUTMTable& utm_table,
+                                const std::string& output_path) {
+        return ProcessTimeOrdered(output_path, [&](auto&& on_imu, auto&& on_gps) {
+            data.ForEachIndexed(on_imu, [&](const sad::GNSS& gnss, uint32_t index) {
+                on_gps(gnss, utm_table.valid_[index] ? &utm_table.pose_[index] : nullptr);
+            });
+        });
+    }
+
+    /// 处理按时间顺序流式读取的数据
+    bool ProcessStream(sad::SensorStream& stream, const std::string& output_path) {
+        return ProcessTimeOrdered(output_path, [&](auto&& on_imu, auto&& on_gps) {
+            for (const auto& record : stream) {
+                if (record.type_ == sad::SensorRecord::IMU_TYPE) {
+                    on_imu(record.imu_);
+                } else {
+                    on_gps(record.gnss_, nullptr);
+                }
+            }
+        });
+    }
+
+    // 新增：设置转弯段信息
+    void SetTurnSegments(const std::vector<TurnDetector::TurnSegment>& segments) {
+        turn_segments_.clear();
+        for (const auto& segment : segments) {
+            turn_segments_.emplace_back(segment.start_time, segment.end_time);
+        }
+        LOG(INFO) << "设置转弯段信息: " << turn_segments_.size() << " 个转弯段";
+    }
+
+    // 新增：设置FBK数据
+    void SetFBKData(const std::vector<sad::FBKPair>& fbk_data) {
+        for (const auto& fbk_pair : fbk_data) {
+            if (fbk_pair.valid_) {
+                eskf_.AddFBKData(fbk_pair.flag_.timestamp_, 
+                                fbk_pair.misalignment_.pitch_, 
+                                fbk_pair.misalignment_.heading_);
+            }
+        }
+        LOG(INFO) << "设置FBK数据: " << fbk_data.size() << " 个FBK数据对";
+    }
+
+private:
+    /// 依次处理按时间排序的IMU/GNSS数据并保存结果，for_each_data(on_imu, on_gps)按时间顺序逐条调用两个回调
+    /// on_gps(gnss, utm_pose)中utm_pose为预先转换的相对原点的UTM位姿，为空时现场转换
+    template <typename ForEachData>
+    bool ProcessTimeOrdered(const std::string& output_path, ForEachData&& for_each_data) {
+        std::ofstream fout(output_path);
+        std::string cov_path = output_path.substr(0, output_path.find_last_of('.')) + "_cov.txt";
+        std::ofstream cov_file(cov_path);
+        
+        auto save_vec3 = [](std::ofstream& fout, const Vec3d& v) {
+            fout << v[0] << " " << v[1] << " " << v[2] << " ";
+        };
+        auto save_quat = [](std::ofstream& fout, const Quatd& q) {
+            fout << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << " ";
+        };
+
+        auto save_result = [&](const sad::NavStated& state, const Vec3d& gps_pos, bool has_gps) {
+            fout << std::setprecision(18) << state.timestamp_ << " " << std::setprecision(9);
+            save_vec3(fout, state.p_);
+            save_quat(fout, state.R_.unit_quaternion());
+            save_vec3(fout, state.v_);
+            save_vec3(fout, state.bg_);
+            save_vec3(fout, state.ba_);
+            if (has_gps) {
+                save_vec3(fout, gps_pos);
+                fout << "1";
+            } else {
+                fout<< "0 0 0 0";
+            }
+            fout << std::endl;
+        };
+
+        Vec3d latest_gps_pos = Vec3d::Zero();
+        bool has_latest_gps = false;
+
+        for_each_data([&](const sad::IMU& imu) {
+            if (ProcessIMU(imu, cov_file)) {
+                auto state = eskf_.GetNominalState();
+                save_result(state, latest_gps_pos, has_latest_gps);
+            }
+        }, [&](const sad::GNSS& gnss, const SE3* utm_pose) {
+            Vec3d gps_pos;
+            if (ProcessGPS(gnss, utm_pose, gps_pos)) {
+                latest_gps_pos = gps_pos;
+                has_latest_gps = true;
+                eskf_.SaveCovariance(cov_file);
+                if constexpr (kEstimateTimeOffset) {
+                    if (time_offset_file_.is_open()) {
+                        time_offset_file_ << std::fixed << std::setprecision(9) << gnss.unix_time_ << " "
+                                          << gps_time_offset_ + eskf_.GetTimeOffset() << " "
+                                          << eskf_.GetTimeOffsetStd() << std::endl;
+                    }
+                }
+            }
+        });
+        return true;
+    }
+
+    bool ProcessIMU(const sad::IMU& imu, std::ofstream& cov_file) {
+        //等待第一个GPS
+        if(!first_gps_processed_) {
+            return false;
+        }
+
+        bool success = eskf_.Predict(imu);
+        if (success) {
+            eskf_.SaveCovariance(cov_file);
+        }
+        return success;
+    }
+
+    // 新增：检查是否在转弯段内
+    bool IsInTurnSegment(double timestamp) const {
+        for (const auto& segment : turn_segments_) {
+            if (timestamp >= segment.first && timestamp <= segment.second) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ProcessGPS(const sad::GNSS& gps, const SE3* utm_pose, Vec3d& gps_pos) {
+        sad::GNSS gps_convert = gps;
+        if (utm_pose != nullptr) {
+            // 已经转换并减去原点
+            gps_convert.utm_pose_ = *utm_pose;
+            first_gps_processed_ = true;
+        } else {
+            if (!sad::ConvertGps2UTM(gps_convert, Vec2d::Zero(), 0.0)) {
+                LOG(WARNING) << "GPS坐标转换失败";
+                return false;
+            }
+            if (!first_gps_processed_) {
+                origin_ = gps_convert.utm_pose_.translation();
+                first_gps_processed_ = true;
+            }
+            //应用原点偏移
+            gps_convert.utm_pose_.translation() -= origin_;
+        }
+        gps_pos = gps_convert.utm_pose_.translation();
+        
+        Vec3d pos_before = eskf_.GetNominalState().p_;
+        Vec3d pos_residual = gps_convert.utm_pose_.translation() - pos_before;
+
+        double lateral_residual = eskf_.ComputeLateralResidual(pos_residual);
+        double heading = eskf_.GetCurrentHeading();
+        double speed = eskf_.GetNominalState().v_.norm();
+        double residual_norm = pos_residual.norm();
+
+        lateral_residuals_.emplace_back(gps.unix_time_, lateral_residual);
+        lateral_residual_file_ << std::fixed << std::setprecision(9)
+                               << gps.unix_time_ << " "
+                               << lateral_residual << " "
+                               << heading << " "
+                               << speed << " "
+                               << pos_residual.x() << " " << pos_residual.y() << " "
+                               << residual_norm
+                               << std::endl;
+
+        // 新增：根据转弯状态选择观测方式
+        bool success = false;
+        if (IsInTurnSegment(gps.unix_time_)) {
+            // 转弯期间：只做位置观测
+            success = eskf_.ObservePositionOnly(gps_convert);
+        } else {
+            // 直线期间：完整观测
+            success = eskf_.ObserveGps(gps_convert);
+        }
+
+        if(success) {
+            Vec3d pos_after = eskf_.GetNominalState().p_;
+            Vec3d pos_correction = pos_after - pos_before;
+            double correction_norm = pos_correction.norm();
+            double residual_norm = pos_residual.norm();
+            correction_file_ << std::fixed << std::setprecision(9)
+                             << gps.unix_time_ << " "
+                             << pos_correction.x() << " " << pos_correction.y() << " " << pos_correction.z() << " "
+                             << correction_norm << " "
+                             << pos_residual.x() << " " << pos_residual.y() << " " << pos_residual.z() << " "
+                             << residual_norm
+                             << std::endl;
+        }
+        return success;
+    }
+};
+
+/// 一个GPS时间偏移的处理结果
+struct OffsetRunResult {
+    double gps_time_offset_ = 0.0;
+    bool success_ = false;
+    std::string correction_path_;
+    double time_used_ = 0.0;     // 处理耗时(秒)
+    std::time_t finish_time_ = 0;
+    double lateral_rms_ = 0.0;   // 横向残差RMS(米)，与auto_lateral_residuals_rms.py相同
+    int lateral_count_ = 0;      // 参与RMS的残差个数
+};
+
+/// 横向残差RMS：segments为空时使用整段轨迹，否则只使用落在各转弯段[start, end]内的残差
+void ComputeLateralRMS(const std::vector<std::pair<double, double>>& residuals,
+                       const std::vector<std::pair<double, double>>& segments, OffsetRunResult& result) {
+    double sum = 0;
+    int count = 0;
+    for (const auto& r : residuals) {
+        bool used = segments.empty();
+        for (size_t i = 0; i < segments.size() && !used; ++i) {
+            used = r.first >= segments[i].first && r.first <= segments[i].second;
+        }
+        if (used) {
+            sum += r.second * r.second;
+            count++;
+        }
+    }
+    result.lateral_count_ = count;
+    result.lateral_rms_ = count > 0 ? std::sqrt(sum / count) : 0.0;
+}
+
+/**
+ * 用指定GPS时间偏移下匹配的NZZ航向检测转弯段，结果写入output_filename
+ * 没有匹配数据时返回true且segments为空，检测器初始化失败时返回false
+ */
+bool DetectTurns(const OfflineDataManager& data_manager, double gps_time_offset, const std::string& output_filename,
+                 std::vector<TurnDetector::TurnSegment>& segments) {
+    segments.clear();
+
+    // 获取GPS-NZZ匹配数据
+    const auto matched_data = data_manager.GetMatchedHeadingData(gps_time_offset);
+    if (matched_data.empty()) {
+        LOG(WARNING) << "没有匹配的GPS-NZZ数据，跳过转弯检测";
+        return true;
+    }
+
+    // 转弯检测器配置
+    TurnDetector turn_detector;
+    TurnDetector::Config config;
+    config.start_turn_rate_threshold = 3.0;
+    config.end_turn_rate_threshold = 1.5;
+    config.end_duration_threshold = 3.0;
+    config.accumulated_angle_threshold = 30.0;
+
+    if (!turn_detector.Initialize(output_filename, config)) {
+        LOG(ERROR) << "转弯检测器初始化失败";
+        return false;
+    }
+
+    // 添加匹配的航向数据进行转弯检测
+    for (const auto& data : matched_data) {
+        turn_detector.AddHeadingData(data.first, data.second);
+    }
+
+    // 完成转弯检测
+    turn_detector.Finalize();
+
+    // 获取检测到的转弯段
+    segments = turn_detector.GetDetectedTurns();
+    return true;
+}
+
+/**
+ * 使用一个GPS时间偏移处理已加载的数据：转弯检测、ESKF、写出结果，输出文件名与单独运行时相同
+ * 只读访问data_manager，不同偏移可以在多个线程中同时处理
+ * body_acce_path为空时不输出车体系加速度，rms_segments为计算横向残差RMS的时间段，为空时使用整段轨迹
+ */
+template <typename ESKFType>
+OffsetRunResult ProcessOffsetWith(const OfflineDataManager& data_manager, double gps_time_offset, bool use_stream,
+                                  const std::string& body_acce_path,
+                                  const std::vector<std::pair<double, double>>& rms_segments) {
+    auto start = std::chrono::steady_clock::now();
+    OffsetRunResult result;
+    result.gps_time_offset_ = gps_time_offset;
+    result.correction_path_ = sad::OffsetFileName("corrections", gps_time_offset);
+
+    auto finish = [&](bool success) {
+        result.success_ = success;
+        result.time_used_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.finish_time_ = std::time(nullptr);
+        return result;
+    };
+
+    //ESKF处理器
+    OfflineESKFProcessor<ESKFType> processor;
+    if (!processor.Initialize(result.correction_path_, body_acce_path)) {
+        LOG(ERROR) << "ESKF初始化失败";
+        return finish(false);
+    }
+    if constexpr (std::is_same<ESKFType, sad::ESKFTimeOffsetD>::value) {
+        if (!processor.OpenTimeOffsetOutput(sad::OffsetFileName("time_offset_online", gps_time_offset),
+                                            gps_time_offset)) {
+            LOG(ERROR) << "无法创建时间偏移输出文件";
+            return finish(false);
+        }
+    }
+
+    // 设置FBK数据到处理器
+    const auto& fbk_data = data_manager.GetFBKData();
+    if (!fbk_data.empty()) {
+        processor.SetFBKData(fbk_data);
+    }
+
+    // 转弯检测
+    std::vector<TurnDetector::TurnSegment> detected_turns;
+    if (FLAGS_enable_turn_detection) {
+        LOG(INFO) << "开始转弯检测分析...";
+        if (!DetectTurns(data_manager, gps_time_offset, sad::OffsetFileName("turns_offline", gps_time_offset),
+                         detected_turns)) {
+            return finish(false);
+        }
+        LOG(INFO) << "转弯检测分析完成";
+    }
+
+    // 设置转弯段信息到处理器
+    if (!detected_turns.empty()) {
+        processor.SetTurnSegments(detected_turns);
+    }
+
+    std::string output_path = sad::OffsetFileName("gins_offline", gps_time_offset);
+
+    bool processed = false;
+    if (use_stream) {
+        sad::SensorStream::Options stream_options;
+        stream_options.window_ = FLAGS_stream_window;
+        stream_options.gnss_time_offset_ = gps_time_offset;
+        sad::SensorStream stream(FLAGS_txt_path, stream_options);
+        processed = processor.ProcessStream(stream, output_path);
+        LOG(INFO) << "流式处理完成，重排窗口最多缓存" << stream.MaxBuffered() << "条，丢弃乱序数据"
+                  << stream.NumLateRecords() << "条";
+        if (stream.Failed()) {
+            LOG(ERROR) << "日志读取出错，只处理了部分数据";
+            processed = false;
+        }
+    } else {
+        sad::SensorTimeline timeline;
+        data_manager.BuildTimeline(gps_time_offset, timeline);
+        processed = processor.ProcessReorganizedData(timeline, data_manager.GetUTMTable(), output_path);
+    }
+    if (!processed) {
+        LOG(ERROR) << "数据处理失败";
+        return finish(false);
+    }
+
+    ComputeLateralRMS(processor.GetLateralResiduals(), rms_segments, result);
+
+    if constexpr (std::is_same<ESKFType, sad::ESKFTimeOffsetD>::value) {
+        const auto& eskf = processor.GetESKF();
+        LOG(INFO) << "在线估计GPS时间偏移: " << gps_time_offset + eskf.GetTimeOffset() << "s (在" << gps_time_offset
+                  << "s基础上修正" << eskf.GetTimeOffset() << "s), 标准差 " << eskf.GetTimeOffsetStd() << "s";
+    }
+    return finish(true);
+}
+
+OffsetRunResult ProcessOffset(const OfflineDataManager& data_manager, double gps_time_offset, bool use_stream,
+                              const std::string& body_acce_path,
+                              const std::vector<std::pair<double, double>>& rms_segments = {}) {
+    if (FLAGS_estimate_time_offset_online) {
+        return ProcessOffsetWith<sad::ESKFTimeOffsetD>(data_manager, gps_time_offset, use_stream, body_acce_path,
+                                                       rms_segments);
+    }
+    return ProcessOffsetWith<sad::ESKFD>(data_manager, gps_time_offset, use_stream, body_acce_path, rms_segments);
+}
+
+/**
+ * 追加偏移扫描的处理汇总，格式与mac_batch_process.sh写的processing_summary.txt相同
+ * @param offset_precision  偏移的小数位数，网格扫描按OffsetPrecision取2位（与批处理脚本相同）或3位，寻优的偏移精确到毫秒用3位
+ */
+void WriteSweepSummary(const std::string& summary_path, const std::vector<OffsetRunResult>& results,
+                       int offset_precision = 2) {
+    std::error_code ec;
+    const bool has_header = std::filesystem::file_size(summary_path, ec) > 0 && !ec;
+    std::ofstream fout(summary_path, std::ios::app);
+    if (!fout.is_open()) {
+        LOG(ERROR) << "无法写入处理汇总: " << summary_path;
+        return;
+    }
+    if (!has_header) {
+        fout << "时间戳,日志文件,GPS偏移,状态,输出文件,处理时间,文件大小" << std::endl;
+    }
+
+    std::string log_name = std::filesystem::path(FLAGS_txt_path).filename().string();
+    if (log_name.size() > 4 && log_name.compare(log_name.size() - 4, 4, ".log") == 0) {
+        log_name.resize(log_name.size() - 4);
+    }
+    const std::string output_dir = std::filesystem::current_path(ec).string();
+
+    for (const auto& result : results) {
+        char time_str[32];
+        std::strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", std::localtime(&result.finish_time_));
+        uintmax_t file_size = 0;
+        if (result.success_) {
+            file_size = std::filesystem::file_size(result.correction_path_, ec);
+            if (ec) {
+                file_size = 0;
+            }
+        }
+
+        fout << time_str << "," << log_name << "," << sad::FormatOffset(result.gps_time_offset_, offset_precision) << "," << (result.success_ ? "SUCCESS" : "FAILED")
+             << "," << output_dir << "," << static_cast<int>(result.time_used_) << "," << file_size << std::endl;
+    }
+}
+
+/// 在线程池中处理各个GPS时间偏移，各线程共享只读的data_manager
+int RunOffsetSweep(const OfflineDataManager& data_manager, const std::vector<double>& offsets, bool use_stream) {
+    const int num_threads = std::max(
+        1, std::min(static_cast<int>(offsets.size()), FLAGS_sweep_threads > 0
+                                                          ? FLAGS_sweep_threads
+                                                          : static_cast<int>(std::thread::hardware_concurrency())));
+    LOG(INFO) << "GPS时间偏移扫描: " << offsets.size() << " 个偏移, " << num_threads << " 个线程";
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<OffsetRunResult> results(offsets.size());
+    std::atomic<size_t> next_task(0);
+    auto worker = [&]() {
+        for (size_t i = next_task++; i < offsets.size(); i = next_task++) {
+            // 逐个偏移运行时留下的是最后一个偏移的body_acce.txt，这里也只让最后一个偏移输出
+            const bool save_body_acce = FLAGS_save_body_acce && i + 1 == offsets.size();
+            results[i] = ProcessOffset(data_manager, offsets[i], use_stream, save_body_acce ? "body_acce.txt" : "");
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < num_threads; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    int num_success = 0;
+    for (const auto& result : results) {
+        num_success += result.success_ ? 1 : 0;
+    }
+    LOG(INFO) << "GPS时间偏移扫描完成: 成功 " << num_success << "/" << results.size() << ", 总耗时 "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s";
+    for (const auto& result : results) {
+        LOG(INFO) << "  偏移 " << result.gps_time_offset_ << "s: " << (result.success_ ? "SUCCESS" : "FAILED") << ", "
+                  << result.correction_path_ << ", 横向残差RMS " << result.lateral_rms_ << "m, 耗时 " << result.time_used_
+                  << " s";
+    }
+
+    if (!FLAGS_sweep_summary_path.empty()) {
+        WriteSweepSummary(FLAGS_sweep_summary_path, results, sad::OffsetPrecision(offsets));
+    }
+    return num_success == static_cast<int>(results.size()) ? 0 : -1;
+}
+
+/**
+ * 在[lower, upper]内用Brent法寻找转弯段横向残差RMS最小的GPS时间偏移，代替固定网格扫描后人工挑选
+ * 转弯段由偏移为0时的NZZ航向检测，与批处理脚本使用的<log>_turns_nzz.txt相同；没有转弯段时使用整段轨迹
+ * 求值的偏移舍入到毫秒，重复的偏移直接使用已有结果，各次求值共享已加载的数据
+ */
+int RunOffsetOptimization(const OfflineDataManager& data_manager, double lower, double upper, bool use_stream) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<TurnDetector::TurnSegment> turns;
+    if (!DetectTurns(data_manager, 0.0, "turns_objective.txt", turns)) {
+        return -1;
+    }
+    std::vector<std::pair<double, double>> rms_segments;
+    for (const auto& turn : turns) {
+        rms_segments.emplace_back(turn.start_time, turn.end_time);
+    }
+    LOG(INFO) << "GPS时间偏移寻优: 区间[" << lower << ", " << upper << "]s, 目标为"
+              << (rms_segments.empty() ? "整段轨迹" : std::to_string(rms_segments.size()) + "个转弯段")
+              << "的横向残差RMS";
+
+    std::map<int, OffsetRunResult> evaluated;  // 毫秒 -> 结果
+    std::vector<OffsetRunResult> results;      // 按求值顺序
+    auto objective = [&](double offset) {
+        const int offset_ms = static_cast<int>(std::lround(offset * 1000));
+        auto iter = evaluated.find(offset_ms);
+        if (iter == evaluated.end()) {
+            // 车体系加速度先按偏移分别输出，寻优结束后只保留最优偏移的一份
+            const double gps_time_offset = offset_ms / 1000.0;
+            auto result = ProcessOffset(data_manager, gps_time_offset, use_stream,
+                                        FLAGS_save_body_acce ? sad::OffsetFileName("body_acce", gps_time_offset) : "",
+                                        rms_segments);
+            LOG(INFO) << "  偏移 " << result.gps_time_offset_ << "s: 横向残差RMS " << result.lateral_rms_ << "m ("
+                      << result.lateral_count_ << "个), 耗时 " << result.time_used_ << " s";
+            iter = evaluated.emplace(offset_ms, result).first;
+            results.push_back(result);
+        }
+        // 失败或没有残差的偏移视为最差
+        const auto& result = iter->second;
+        return result.success_ && result.lateral_count_ > 0 ? result.lateral_rms_
+                                                             : std::numeric_limits<double>::max();
+    };
+
+    sad::BrentMinimize(objective, lower, upper, std::max(FLAGS_optimize_tolerance, 0.001), FLAGS_optimize_max_evals);
+
+    const OffsetRunResult* best = nullptr;
+    for (const auto& result : results) {
+        if (result.success_ && result.lateral_count_ > 0 && (best == nullptr || result.lateral_rms_ < best->lateral_rms_)) {
+            best = &result;
+        }
+    }
+
+    std::ofstream fout("offset_optimization.txt");
+    fout << "# GPS偏移(s),横向残差RMS(m),数据点数,状态" << std::endl;
+    for (const auto& result : results) {
+        fout << std::fixed << std::setprecision(3) << result.gps_time_offset_ << "," << std::setprecision(4)
+             << result.lateral_rms_ << "," << result.lateral_count_ << "," << (result.success_ ? "SUCCESS" : "FAILED")
+             << std::endl;
+    }
+    if (best != nullptr) {
+        fout << "# 最优偏移: " << std::setprecision(3) << best->gps_time_offset_ << "s" << std::endl;
+    }
+
+    // 最优偏移的车体系加速度改名为body_acce.txt，与单独用最优偏移运行时相同，其余偏移的删除
+    if (FLAGS_save_body_acce) {
+        std::error_code ec;
+        for (const auto& result : results) {
+            const std::string path = sad::OffsetFileName("body_acce", result.gps_time_offset_);
+            if (&result != best && path != "body_acce.txt") {
+                std::filesystem::remove(path, ec);
+            }
+        }
+        if (best != nullptr) {
+            const std::string path = sad::OffsetFileName("body_acce", best->gps_time_offset_);
+            if (path != "body_acce.txt") {
+                std::filesystem::rename(path, "body_acce.txt", ec);
+                if (ec) {
+                    LOG(ERROR) << "无法将" << path << "改名为body_acce.txt: " << ec.message();
+                }
+            }
+        }
+    }
+
+    if (!FLAGS_sweep_summary_path.empty()) {
+        WriteSweepSummary(FLAGS_sweep_summary_path, results, 3);
+    }
+
+    const double time_used = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (best == nullptr) {
+        LOG(ERROR) << "GPS时间偏移寻优失败: " << results.size() << "次求值都没有有效的横向残差";
+        return -1;
+    }
+    LOG(INFO) << "GPS时间偏移寻优完成: 最优偏移 " << best->gps_time_offset_ << "s, 横向残差RMS " << best->lateral_rms_
+              << "m, 运行滤波" << results.size() << "次, 总耗时 " << time_used << " s";
+    return 0;
+}
+
+/// 用IMU航向角速度与NZZ航向（没有时用GNSS航向）变化率的互相关估计GPS时间偏移
+int RunTimeLagEstimation(const OfflineDataManager& data_manager) {
+    auto start = std::chrono::steady_clock::now();
+    const sad::SensorTables& tables = *data_manager.GetSensorTables();
+
+    std::vector<std::pair<double, double>> heading = data_manager.GetMatchedHeadingData(0.0);
+    const char* source = "NZZ";
+    if (heading.empty()) {
+        source = "GNSS";
+        for (size_t i = 0; i < tables.gnss_.Size(); ++i) {
+            if (tables.gnss_.heading_valid_[i]) {
+                heading.emplace_back(tables.gnss_.unix_time_[i], tables.gnss_.heading_[i]);
+            }
+        }
+        std::stable_sort(heading.begin(), heading.end(),
+                         [](const std::pair<double, double>& a, const std::pair<double, double>& b) {
+                             return a.first < b.first;
+                         });
+    }
+    if (heading.empty()) {
+        LOG(ERROR) << "没有航向数据，无法估计时间偏移";
+        return -1;
+    }
+
+    sad::TimeLagEstimator estimator;
+    estimator.SetData(tables.imu_, std::move(heading));
+    auto result = estimator.EstimateAll();
+    double time_used = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+    LOG(INFO) << "时间偏移估计(" << source << "航向): " << (result.valid_ ? "有效" : "无效") << ", GPS时间偏移 "
+              << result.lag_ << "s, 置信度 " << result.confidence_ << ", 航向角速度标准差 " << result.rate_std_
+              << "°/s, 网格数 " << result.num_samples_ << ", 耗时 " << time_used << " ms";
+
+    start = std::chrono::steady_clock::now();
+    auto epochs = estimator.EstimateSliding();
+    time_used = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000;
+    LOG(INFO) << "滑动窗口估计: 窗口" << sad::TimeLagEstimator::Options().window_ << "s, 输出 " << epochs.size()
+              << " 个时刻, 耗时 " << time_used << " ms";
+    if (!sad::TimeLagEstimator::SaveEpochs("time_lag_estimation.txt", epochs)) {
+        return -1;
+    }
+    return result.valid_ ? 0 : -1;
+}
+
+//离线模式
+int RunOfflineMode() {
+    LOG(INFO) << "离线模式";
+    if (FLAGS_enable_turn_detection) {
+        LOG(INFO) << "转弯检测: 启用";
+    } else {
+        LOG(INFO) << "转弯检测: 关闭";
+    }
+
+    // 19维ESKF只实现了稠密的协方差传播与更新，不支持18维ESKF的这些计算方式
+    if (FLAGS_estimate_time_offset_online &&
+        (FLAGS_eskf_update_method != "dense" || FLAGS_packed_covariance || FLAGS_dense_covariance_propagation)) {
+        LOG(ERROR) << "--estimate_time_offset_online只支持--eskf_update_method=dense，且不能与--packed_covariance、"
+                   << "--dense_covariance_propagation同时使用";
+        return -1;
+    }
+
+    const bool optimize = !FLAGS_gps_time_offset_optimize.empty();
+    const bool sweep = !FLAGS_gps_time_offset_sweep.empty() && !optimize;
+    double optimize_lower = 0, optimize_upper = 0;
+    std::vector<double> offsets;
+    if (optimize) {
+        if (!sad::ParseOffsetInterval(FLAGS_gps_time_offset_optimize, optimize_lower, optimize_upper)) {
+            return -1;
+        }
+        LOG(INFO) << "GPS时间偏移寻优" << optimize_lower << "s ~ " << optimize_upper << "s";
+    } else if (sweep) {
+        if (!sad::ParseOffsetSweep(FLAGS_gps_time_offset_sweep, offsets)) {
+            return -1;
+        }
+        LOG(INFO) << "GPS时间偏移扫描" << offsets.front() << "s ~ " << offsets.back() << "s";
+    } else {
+        offsets.push_back(FLAGS_gps_time_offset);
+        LOG(INFO) << "GPS时间偏移" << FLAGS_gps_time_offset << "s";
+    }
+    
+    //数据管理器，只加载一次，各偏移共享
+    OfflineDataManager data_manager;
+    if (FLAGS_use_data_cache) {
+        data_manager.SetCachePath(FLAGS_data_cache_path.empty() ? sad::DefaultSensorCachePath(FLAGS_txt_path)
+                                                                : FLAGS_data_cache_path);
+    }
+    data_manager.SetIOThreads(FLAGS_io_threads > 0 ? FLAGS_io_threads
+                                                   : static_cast<int>(std::thread::hardware_concurrency()));
+
+    // 时间偏移估计需要全部IMU数据，不使用流式读取
+    const bool use_stream = FLAGS_stream_window > 0 && !FLAGS_estimate_time_lag;
+    bool loaded = false;
+    if (use_stream) {
+        LOG(INFO) << "流式读取IMU/GNSS，重排窗口" << FLAGS_stream_window << "s";
+        loaded = data_manager.LoadAuxiliaryData(FLAGS_txt_path);
+    } else {
+        loaded = data_manager.LoadSensorTables(FLAGS_txt_path);
+    }
+    if (!loaded) {
+        LOG(ERROR) << "数据加载失败";
+        if (sweep && !FLAGS_sweep_summary_path.empty()) {
+            std::vector<OffsetRunResult> results(offsets.size());
+            for (size_t i = 0; i < offsets.size(); ++i) {
+                results[i].gps_time_offset_ = offsets[i];
+                results[i].finish_time_ = std::time(nullptr);
+            }
+            WriteSweepSummary(FLAGS_sweep_summary_path, results, sad::OffsetPrecision(offsets));
+        }
+        return -1;
+    }
+
+    if (FLAGS_estimate_time_lag) {
+        return RunTimeLagEstimation(data_manager);
+    }
+    if (optimize) {
+        return RunOffsetOptimization(data_manager, optimize_lower, optimize_upper, use_stream);
+    }
+    if (!sweep) {
+        const std::string body_acce_path = FLAGS_save_body_acce ? "body_acce.txt" : "";
+        return ProcessOffset(data_manager, offsets.front(), use_stream, body_acce_path).success_ ? 0 : -1;
+    }
+    return RunOffsetSweep(data_manager, offsets, use_stream);
+}
+
+int RunRealtimeMode() {
+    sad::ESKFD eskf;
+    auto save_vec3 = [](std::ofstream& fout, const Vec3d& v) { fout << v[0] << " " << v[1] << " " << v[2] << " "; };
+    auto save_quat = [](std::ofstream& fout, const Quatd& q) {
+        fout << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << " ";
+    };
+    auto save_result = [&save_vec3, &save_quat](std::ofstream& fout, const sad::NavStated& save_state,
+                                                const Vec3d& gps_pos = Vec3d::Zero(), bool has_gps = false) {
+        fout << std::setprecision(18) << save_state.timestamp_ << " " << std::setprecision(9);
+        save_vec3(fout, save_state.p_);
+        save_quat(fout, save_state.R_.unit_quaternion());
+        save_vec3(fout, save_state.v_);
+        save_vec3(fout, save_state.bg_);
+        save_vec3(fout, save_state.ba_);
+        if (has_gps) {
+            save_vec3 (fout, gps_pos);
+            fout << "1";
+        } else {
+            fout << "0 0 0 0";
+        }
+        fout << std::endl;
+    };
+    std::ofstream fout("/Users/cjj/work/GNSS_INS/slam/gnss_imu_time/data/ch3/gins_realtime.txt");
+
+    // 新增：P矩阵协方差数据文件
+    std::ofstream cov_file("/Users/cjj/work/GNSS_INS/slam/gnss_imu_time/data/ch3/covariance_realtime.txt");
+
+    bool imu_inited = false, gnss_inited = false;
+
+    LOG(INFO) << "初始化ESKF";
+    if (InitializeESKF(eskf)) {
+        imu_inited = true;
+    }
+
+    //GNSS缓存队列
+    std::queue<sad::GNSS> pending_gps_queue;
+
+    /// 设置各类回调函数
+    bool first_gnss_set = false;
+    Vec3d origin = Vec3d::Zero();
+
+    //存储最新的GPS观测位置
+    Vec3d latest_gps_pos = Vec3d::Zero();
+    bool has_latest_gps = false;
+    double latest_gps_time = 0.0;
+
+    auto on_imu = [&](const sad::IMU& imu) {
+          /// IMU 处理函数
+
+          if (!gnss_inited) {
+              /// 等待有效的RTK数据
+              return;
+          }
+
+          /// GNSS 也接收到之后，再开始进行预测
+          eskf.Predict(imu);
+
+          // 记录IMU预测后的协方差
+          eskf.SaveCovariance(cov_file);
+
+          /// predict就会更新ESKF，所以此时就可以发送数据
+          auto current_state = eskf.GetNominalState();
+          double current_eskf_time = current_state.timestamp_;
+
+          //检查是否有GPS数据需要处理
+          while (!pending_gps_queue.empty()) {
+            sad::GNSS& catch_gps = pending_gps_queue.front();
+            //IMU递推到缓存的GNSS时刻
+            if (current_eskf_time >= catch_gps.unix_time_) {
+                LOG(INFO) << "=== 处理缓存的GPS数据 ===";
+                LOG(INFO) << "IMU时间: " << std::fixed << std::setprecision(9) << current_eskf_time
+                          << ", GPS时间: " << std::fixed << std::setprecision(9) << catch_gps.unix_time_;
+                try{
+
+                    eskf.ObserveGps(catch_gps);
+
+                    // 记录GPS更新后的协方差
+                    eskf.SaveCovariance(cov_file);
+
+                    LOG(INFO) << "GPS观测成功, 时间同步正确";
+                } catch (...) {
+                    LOG (ERROR) << "GNSS观测失败";
+                }
+                pending_gps_queue.pop();
+            }else {
+                // IMU还没追上GPS时刻，退出循环
+                LOG(INFO) << "等待IMU递推: current=" << std::fixed << std::setprecision(9) << current_eskf_time 
+                          << ", waiting_gps=" << catch_gps.unix_time_;
+                break;
+            }
+          }
+
+          //检查是否有时间接近的GPS观测数据
+          bool use_gps_obs = false;
+          Vec3d gps_obs_pos = Vec3d::Zero();
+          if (has_latest_gps) {
+              use_gps_obs = true;
+              gps_obs_pos = latest_gps_pos;
+          }
+          /// 记录数据以供绘图
+          save_result(fout, current_state, gps_obs_pos, use_gps_obs);
+
+          usleep(1e3);
+      };
+
+    auto on_gnss = [&](const sad::GNSS& gnss) {
+            /// GNSS 处理函数 - 详细调试版本
+            if (!imu_inited) {
+                LOG(INFO) << "GPS: IMU未初始化，跳过";
+                return;
+            }
+            //添加GNSS时间延迟
+            sad::GNSS gnss_convert = gnss;
+            gnss_convert.unix_time_ += 0.0;
+
+            auto current_state = eskf.GetNominalState();
+            double current_eskf_time = current_state.timestamp_;
+            
+            LOG(INFO) << "=== GPS数据到达 ===";
+            LOG(INFO) << "原始GPS时间: " << gnss.unix_time_ << "s";
+            LOG(INFO) << "延迟GPS时间: " << gnss_convert.unix_time_ << "s"; 
+            LOG(INFO) << "当前ESKF时间: " << current_eskf_time << "s";
+            LOG(INFO) << "时间差: " << (gnss_convert.unix_time_ - current_eskf_time) << "s";
+
+            // 跳过太旧的GPS
+            if (gnss_convert.unix_time_ < current_eskf_time - 5.0) {
+                LOG(WARNING) << "GPS数据太旧，跳过";
+                return;
+            }
+            if (!sad::ConvertGps2UTM(gnss_convert, Vec2d::Zero(), 0.0)) {
+                LOG(WARNING) << "GPS坐标转换失败";
+                return;
+            }
+            /// 设置地图原点（去掉原点）
+            if (!first_gnss_set) {
+                origin = gnss_convert.utm_pose_.translation();
+                first_gnss_set = true;
+                LOG(INFO) << "设置地图原点: " << origin.transpose();
+            } else {
+                LOG(INFO) << "步骤6 - 使用已有地图原点";
+            }
+            
+            //保存GPS观测位置（去掉原点）
+            Vec3d gps_obs_position = gnss_convert.utm_pose_.translation() - origin;
+            latest_gps_pos = gps_obs_position;
+            has_latest_gps = true;
+            latest_gps_time = gnss_convert.unix_time_;
+
+            LOG(INFO) << "步骤6.5 - 保存GPS观测位置" << gps_obs_position.transpose();
+
+            gnss_convert.utm_pose_.translation() -= origin;
+            
+            LOG(INFO) << "步骤7 - 应用地图原点后，GPS时间戳: " << gnss_convert.unix_time_ << "s";
+
+            try {
+                if (current_eskf_time >= gnss_convert.unix_time_) {
+                    LOG(INFO) << "GPS时间不超前, 立即处理";
+                    eskf.ObserveGps(gnss_convert);
+                    eskf.SaveCovariance(cov_file);
+                    LOG(INFO) << "GPS观测成功";
+                    gnss_inited = true;
+                } else {
+                    LOG(INFO) << "GPS时间超前, 缓存等待IMU递推";
+                    pending_gps_queue.push(gnss_convert);
+                    gnss_inited = true;
+                }
+            } catch (...) {
+                LOG(ERROR) << "GPS观测异常";
+            }
+
+            
+            LOG(INFO) << "=== GPS处理结束 ===";
+        };
+
+    auto on_fbk = [&](const sad::FBKPair& fbk_pair) {
+            if (fbk_pair.valid_) {
+                eskf.AddFBKData(fbk_pair.flag_.timestamp_, 
+                            fbk_pair.misalignment_.pitch_, 
+                            fbk_pair.misalignment_.heading_);
+                LOG(INFO) << "添加FBK数据: t=" << fbk_pair.flag_.timestamp_ << "s, "
+                        << "pitch=" << fbk_pair.misalignment_.pitch_ << "°, "
+                        << "heading=" << fbk_pair.misalignment_.heading_ << "°";
+            }
+        };
+
+    /// 各回调组成处理器，在编译期绑定
+    sad::TxtReader reader(FLAGS_txt_path, sad::TxtReadMode::STREAM, sad::Overloaded{on_imu, on_gnss, on_fbk});
+    if (!reader.Go()) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    FLAGS_stderrthreshold = google::INFO;
+    FLAGS_colorlogtostderr = true;
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    if (FLAGS_txt_path.empty()) {
+        return -1;
+    }
+
+    if (FLAGS_offline_mode) {
+        return RunOfflineMode();
+    } else {
+        return RunRealtimeMode();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,289 @@
+//
+// GNSS相对IMU的时间偏移估计
+//
+
+#include "ch3/time_lag_estimator.h"
+
+#include <glog/logging.h>
+#include <unsupported/Eigen/FFT>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+#include "common/math_utils.h"
+
+namespace sad {
+
+void TimeLagEstimator::SetData(const IMUTable& imu, std::vector<std::pair<double, double>> heading) {
+    imu_ = &imu;
+
+    // IMU表按日志顺序存放，可能局部乱序，区间查找与积分都按排序后的行号进行
+    imu_order_.resize(imu.Size());
+    for (size_t i = 0; i < imu_order_.size(); ++i) {
+        imu_order_[i] = static_cast<uint32_t>(i);
+    }
+    if (!std::is_sorted(imu.timestamp_.begin(), imu.timestamp_.end())) {
+        std::stable_sort(imu_order_.begin(), imu_order_.end(),
+                         [&imu](uint32_t a, uint32_t b) { return imu.timestamp_[a] < imu.timestamp_[b]; });
+    }
+    imu_time_.resize(imu_order_.size());
+    for (size_t i = 0; i < imu_order_.size(); ++i) {
+        imu_time_[i] = imu.timestamp_[imu_order_[i]];
+    }
+
+    heading_time_.clear();
+    heading_unwrapped_.clear();
+    heading_time_.reserve(heading.size());
+    heading_unwrapped_.reserve(heading.size());
+
+    // 航向北偏东为正，取反后与绕重力方向（向上）的转角方向一致
+    for (const auto& h : heading) {
+        double angle = -h.second;
+        if (!heading_unwrapped_.empty()) {
+            double diff = std::remainder(angle - heading_unwrapped_.back(), 360.0);
+            angle = heading_unwrapped_.back() + diff;
+        }
+        heading_time_.push_back(h.first);
+        heading_unwrapped_.push_back(angle);
+    }
+}
+
+void TimeLagEstimator::IntegrateIMUYaw(double t_begin, double t_end, std::vector<double>& t,
+                                       std::vector<double>& yaw) const {
+    t.clear();
+    yaw.clear();
+    const auto& ts = imu_time_;
+    size_t begin = std::lower_bound(ts.begin(), ts.end(), t_begin) - ts.begin();
+    size_t end = std::upper_bound(ts.begin(), ts.end(), t_end) - ts.begin();
+    // 多取前后各一个数据，保证区间端点可以插值
+    begin = begin > 0 ? begin - 1 : 0;
+    end = std::min(end + 1, ts.size());
+    if (end < begin + 2) {
+        return;
+    }
+
+    // 静止和匀速时加速度计测得的比力向上，区间内取均值作为重力方向
+    Vec3d up = Vec3d::Zero();
+    for (size_t i = begin; i < end; ++i) {
+        up += imu_->acce_[imu_order_[i]];
+    }
+    if (up.norm() < 1e-6) {
+        return;
+    }
+    up.normalize();
+
+    t.reserve(end - begin);
+    yaw.reserve(end - begin);
+    double last_rate = 0;
+    for (size_t i = begin; i < end; ++i) {
+        double rate = imu_->gyro_[imu_order_[i]].dot(up) * math::kRAD2DEG;
+        if (t.empty()) {
+            t.push_back(ts[i]);
+            yaw.push_back(0);
+        } else if (ts[i] > t.back()) {
+            yaw.push_back(yaw.back() + 0.5 * (rate + last_rate) * (ts[i] - t.back()));
+            t.push_back(ts[i]);
+        }
+        last_rate = rate;
+    }
+}
+
+void TimeLagEstimator::ResampleRate(const std::vector<double>& t, const std::vector<double>& angle, double t0, int n,
+                                    std::vector<double>& rate) const {
+    const double dt = options_.grid_dt_;
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // 网格点上的角度，所在数据间隔过长或超出数据范围时为NaN
+    std::vector<double> grid_angle(n + 1, nan);
+    size_t j = 0;
+    for (int k = 0; k <= n; ++k) {
+        double tk = t0 + k * dt;
+        while (j + 1 < t.size() && t[j + 1] < tk) {
+            ++j;
+        }
+        if (j + 1 >= t.size() || tk < t[j] || t[j + 1] - t[j] > options_.max_heading_gap_) {
+            continue;
+        }
+        double s = (tk - t[j]) / (t[j + 1] - t[j]);
+        grid_angle[k] = angle[j] + s * (angle[j + 1] - angle[j]);
+    }
+
+    rate.assign(n, nan);
+    for (int k = 0; k < n; ++k) {
+        rate[k] = (grid_angle[k + 1] - grid_angle[k]) / dt;
+    }
+}
+
+TimeLagEstimator::Result TimeLagEstimator::Estimate(double t_begin, double t_end) const {
+    Result result;
+    const double dt = options_.grid_dt_;
+    const int max_lag = static_cast<int>(std::ceil(options_.max_lag_ / dt));
+    const int n = static_cast<int>(std::floor((t_end - t_begin) / dt));
+    if (imu_ == nullptr || n < 4 * max_lag) {
+        return result;
+    }
+
+    std::vector<double> imu_t, imu_yaw;
+    IntegrateIMUYaw(t_begin, t_end, imu_t, imu_yaw);
+    std::vector<double> imu_rate, heading_rate;
+    ResampleRate(imu_t, imu_yaw, t_begin, n, imu_rate);
+    ResampleRate(heading_time_, heading_unwrapped_, t_begin, n, heading_rate);
+
+    // 两路都有数据的网格参与互相关，其余置零
+    double imu_mean = 0, heading_mean = 0;
+    int count = 0;
+    for (int k = 0; k < n; ++k) {
+        if (std::isfinite(imu_rate[k]) && std::isfinite(heading_rate[k]) &&
+            std::fabs(heading_rate[k]) <= options_.max_rate_) {
+            imu_mean += imu_rate[k];
+            heading_mean += heading_rate[k];
+            count++;
+        } else {
+            imu_rate[k] = heading_rate[k] = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+    result.num_samples_ = count;
+    if (count < 4 * max_lag) {
+        return result;
+    }
+    imu_mean /= count;
+    heading_mean /= count;
+
+    // 补零到2的幂，长度不小于n + max_lag，使循环相关在搜索范围内等于线性相关
+    int fft_size = 1;
+    while (fft_size < n + max_lag) {
+        fft_size <<= 1;
+    }
+    std::vector<double> imu_signal(fft_size, 0.0), heading_signal(fft_size, 0.0);
+    double imu_energy = 0, heading_energy = 0;
+    for (int k = 0; k < n; ++k) {
+        if (std::isfinite(imu_rate[k])) {
+            imu_signal[k] = imu_rate[k] - imu_mean;
+            heading_signal[k] = heading_rate[k] - heading_mean;
+            imu_energy += imu_signal[k] * imu_signal[k];
+            heading_energy += heading_signal[k] * heading_signal[k];
+        }
+    }
+    result.rate_std_ = std::sqrt(heading_energy / count);
+    if (result.rate_std_ < options_.min_rate_std_ || imu_energy <= 0) {
+        return result;
+    }
+
+    // r[k] = sum_n heading[n] * imu[n + k] = IFFT(conj(H) * I)
+    Eigen::FFT<double> fft;
+    std::vector<std::complex<double>> imu_spectrum, heading_spectrum;
+    fft.fwd(imu_spectrum, imu_signal);
+    fft.fwd(heading_spectrum, heading_signal);
+    for (size_t i = 0; i < imu_spectrum.size(); ++i) {
+        imu_spectrum[i] *= std::conj(heading_spectrum[i]);
+    }
+    std::vector<double> corr;
+    fft.inv(corr, imu_spectrum);
+
+    auto r = [&](int k) { return corr[(k + fft_size) % fft_size]; };
+    int best = -max_lag;
+    for (int k = -max_lag; k <= max_lag; ++k) {
+        if (r(k) > r(best)) {
+            best = k;
+        }
+    }
+    result.confidence_ = r(best) / std::sqrt(imu_energy * heading_energy);
+
+    // 峰值在搜索边界上说明真实偏移超出了搜索范围
+    if (best == -max_lag || best == max_lag) {
+        return result;
+    }
+
+    // 抛物线插值得到亚网格精度的峰值位置
+    double y0 = r(best - 1), y1 = r(best), y2 = r(best + 1);
+    double denom = y0 - 2 * y1 + y2;
+    double delta = denom < 0 ? 0.5 * (y0 - y2) / denom : 0.0;
+    result.lag_ = (best + delta) * dt;
+    result.valid_ = result.confidence_ >= options_.min_confidence_;
+    return result;
+}
+
+TimeLagEstimator::Result TimeLagEstimator::EstimateAll() const {
+    if (imu_ == nullptr || imu_->Size() == 0 || heading_time_.empty()) {
+        return Result();
+    }
+    double t_begin = std::max(imu_time_.front(), heading_time_.front());
+    double t_end = std::min(imu_time_.back(), heading_time_.back());
+    return Estimate(t_begin, t_end);
+}
+
+std::vector<TimeLagEstimator::Epoch> TimeLagEstimator::EstimateSliding() const {
+    std::vector<Epoch> epochs;
+    if (imu_ == nullptr || imu_->Size() == 0 || heading_time_.empty()) {
+        return epochs;
+    }
+
+    // 各窗口的结束时间与估计
+    std::vector<std::pair<double, Result>> windows;
+    double t_begin = std::max(imu_time_.front(), heading_time_.front());
+    double t_end = std::min(imu_time_.back(), heading_time_.back());
+    for (double s = t_begin; s + options_.window_ <= t_end; s += options_.window_step_) {
+        windows.emplace_back(s + options_.window_, Estimate(s, s + options_.window_));
+    }
+
+    epochs.reserve(heading_time_.size());
+    size_t w = 0;
+    double lag = 0;
+    // 最近buffer_windows_个已结束窗口是否有效，buffer_size为其中有效的个数，与原time_lag_estimation.txt一样表示有上限的缓冲区占用
+    std::deque<bool> recent_valid;
+    int buffer_size = 0;
+    for (size_t i = 0; i < heading_time_.size(); ++i) {
+        Epoch epoch;
+        epoch.timestamp_ = heading_time_[i];
+
+        // 只使用在此时刻之前已经结束的窗口
+        for (; w < windows.size() && windows[w].first <= epoch.timestamp_; ++w) {
+            const bool valid = windows[w].second.valid_;
+            if (valid) {
+                lag = windows[w].second.lag_;
+                buffer_size++;
+            }
+            recent_valid.push_back(valid);
+            if (static_cast<int>(recent_valid.size()) > options_.buffer_windows_) {
+                buffer_size -= recent_valid.front() ? 1 : 0;
+                recent_valid.pop_front();
+            }
+        }
+        epoch.lag_ = lag;
+        epoch.buffer_size_ = buffer_size;
+
+        double rate = 0;
+        if (i > 0 && heading_time_[i] > heading_time_[i - 1]) {
+            rate = std::fabs(heading_unwrapped_[i] - heading_unwrapped_[i - 1]) / (heading_time_[i] - heading_time_[i - 1]);
+        }
+        if (rate < options_.still_rate_threshold_) {
+            epoch.move_status_ = 0;
+        } else if (rate < options_.turn_rate_threshold_) {
+            epoch.move_status_ = 1;
+        } else {
+            epoch.move_status_ = 8;
+        }
+        epochs.push_back(epoch);
+    }
+    return epochs;
+}
+
+bool TimeLagEstimator::SaveEpochs(const std::string& path, const std::vector<Epoch>& epochs) {
+    std::ofstream fout(path);
+    if (!fout.is_open()) {
+        LOG(ERROR) << "无法创建文件: " << path;
+        return false;
+    }
+    fout << "# timestamp estimated_time_lag buffer_size move_status" << std::endl;
+    for (const auto& epoch : epochs) {
+        fout << std::setprecision(18) << epoch.timestamp_ << " " << std::setprecision(6) << epoch.lag_ << " "
+             << epoch.buffer_size_ << " " << epoch.move_status_ << "\n";
+    }
+    return true;
+}
+
+}  // namespace sad
@@ -0,0 +1,100 @@
+//
+// GNSS相对IMU的时间偏移估计：IMU航向角速度与GNSS/NZZ航向变化率的FFT互相关
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_TIME_LAG_ESTIMATOR_H
+#define SLAM_IN_AUTO_DRIVING_TIME_LAG_ESTIMATOR_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/sensor_timeline.h"
+
+namespace sad {
+
+/**
+ * 直接估计GNSS时间相对IMU的偏移，代替在多个偏移下反复运行ESKF再比较RMS
+ *
+ * IMU角速度投影到重力方向得到航向角速度，GNSS/NZZ航向（北偏东，度）取反后为同一转动方向；
+ * 两者都先积分/展开成角度曲线，在同一等间隔网格上插值后差分，得到每个网格内的平均角速度，
+ * 再用FFT计算互相关，峰值位置经抛物线插值得到亚网格精度的偏移
+ *
+ * 估计的偏移与--gps_time_offset含义相同：叠加到GNSS时间上后与IMU对齐
+ * 置信度为峰值处的归一化互相关系数，航向变化不足（直线行驶、静止）时估计无效
+ */
+class TimeLagEstimator {
+   public:
+    struct Options {
+        Options() {}
+        double grid_dt_ = 0.02;          // 重采样网格间隔(秒)
+        double max_lag_ = 1.0;           // 搜索的最大偏移(秒)
+        double max_heading_gap_ = 0.5;   // 航向数据间隔超过该值(秒)的网格不参与互相关
+        double min_rate_std_ = 1.0;      // 航向角速度标准差低于该值(度/秒)时视为激励不足
+        double max_rate_ = 60.0;         // 航向角速度超过该值(度/秒)的网格视为航向跳变，不参与互相关
+        double min_confidence_ = 0.5;    // 置信度低于该值的估计无效
+        double window_ = 60.0;           // 滑动窗口长度(秒)
+        double window_step_ = 1.0;       // 滑动窗口的步长(秒)
+        int buffer_windows_ = 9;         // buffer_size统计最近多少个已结束的窗口，与原输出文件中的上限相同
+        double turn_rate_threshold_ = 3.0;  // 航向角速度超过该值(度/秒)视为转弯，与转弯检测的开始阈值相同
+        double still_rate_threshold_ = 0.5;  // 航向角速度低于该值(度/秒)视为航向不变
+    };
+
+    /// 一次估计的结果
+    struct Result {
+        bool valid_ = false;
+        double lag_ = 0;          // GNSS时间偏移(秒)
+        double confidence_ = 0;   // 峰值归一化互相关系数
+        double rate_std_ = 0;     // 航向角速度标准差(度/秒)，表示激励强弱
+        int num_samples_ = 0;     // 参与互相关的网格数
+    };
+
+    /// 每个航向数据时刻的输出，对应time_lag_estimation.txt中的一行
+    struct Epoch {
+        double timestamp_ = 0;
+        double lag_ = 0;       // 最近一个有效窗口的估计
+        int buffer_size_ = 0;  // 此时刻之前最近buffer_windows_个已结束窗口中有效估计的个数
+        int move_status_ = 0;  // 0: 航向不变, 1: 航向缓慢变化, 8: 转弯
+    };
+
+    explicit TimeLagEstimator(Options options = Options()) : options_(options) {}
+
+    /**
+     * 设置数据
+     * @param imu      IMU表，可以局部乱序，按时间排序的行号在这里建立一次
+     * @param heading  (GNSS原始时间, 航向角度)，按时间排序，不含时间偏移
+     */
+    void SetData(const IMUTable& imu, std::vector<std::pair<double, double>> heading);
+
+    /// 用[t_begin, t_end)内的数据估计偏移
+    Result Estimate(double t_begin, double t_end) const;
+
+    /// 用全部数据估计偏移
+    Result EstimateAll() const;
+
+    /// 按滑动窗口估计，逐个航向时刻输出当时的估计
+    std::vector<Epoch> EstimateSliding() const;
+
+    /// 按time_lag_estimation.txt的格式保存
+    static bool SaveEpochs(const std::string& path, const std::vector<Epoch>& epochs);
+
+   private:
+    /// 把角度曲线在网格t0 + k*dt上插值后差分，得到n个网格内的平均角速度(度/秒)
+    void ResampleRate(const std::vector<double>& t, const std::vector<double>& angle, double t0, int n,
+                      std::vector<double>& rate) const;
+
+    /// 指定区间内IMU绕重力方向的累积转角(度)，重力方向取区间内加速度均值
+    void IntegrateIMUYaw(double t_begin, double t_end, std::vector<double>& t, std::vector<double>& yaw) const;
+
+    Options options_;
+    const IMUTable* imu_ = nullptr;
+    std::vector<uint32_t> imu_order_;  // 按时间戳稳定排序后的IMU行号
+    std::vector<double> imu_time_;     // 与imu_order_对应的有序时间戳，用于二分查找区间
+    std::vector<double> heading_time_;
+    std::vector<double> heading_unwrapped_;  // 展开后取反的航向，与IMU绕重力方向的转角方向一致
+};
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_TIME_LAG_ESTIMATOR_H
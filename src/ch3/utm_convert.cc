@@ -4,13 +4,21 @@
 
 #include "ch3/utm_convert.h"
 #include "common/math_utils.h"
+#include "common/sensor_timeline.h"
 #include "utm_convert/utm.h"
 
 #include <glog/logging.h>
+#include <mutex>
 
 namespace sad {
 
+namespace {
+/// 第三方UTM转换把投影参数存放在全局变量中，多线程同时转换时需要加锁
+std::mutex utm_mutex;
+}  // namespace
+
 bool LatLon2UTM(const Vec2d& latlon, UTMCoordinate& utm_coor) {
+    std::lock_guard<std::mutex> lock(utm_mutex);
     long zone = 0;
     char char_north = 0;
     long ret = Convert_Geodetic_To_UTM(latlon[0] * math::kDEG2RAD, latlon[1] * math::kDEG2RAD, &zone, &char_north,
@@ -22,6 +30,7 @@ bool LatLon2UTM(const Vec2d& latlon, UTMCoordinate& utm_coor) {
 }
 
 bool UTM2LatLon(const UTMCoordinate& utm_coor, Vec2d& latlon) {
+    std::lock_guard<std::mutex> lock(utm_mutex);
     bool ret = Convert_UTM_To_Geodetic((long)utm_coor.zone_, utm_coor.north_ ? 'N' : 'S', utm_coor.xy_[0],
                                        utm_coor.xy_[1], &latlon[0], &latlon[1]);
     latlon *= math::kRAD2DEG;
@@ -81,4 +90,36 @@ bool ConvertGps2UTMOnlyTrans(GNSS& gps_msg) {
     return true;
 }
 
+bool ConvertGNSSTable2UTM(const GNSSTable& gnss, const Vec2d& antenna_pos, double antenna_angle,
+                          GNSSUTMTable& utm_table) {
+    const size_t n = gnss.Size();
+    utm_table.pose_.assign(n, SE3());
+    utm_table.valid_.assign(n, 0);
+
+    // 时间最早的转换成功的读数作为原点，时间相同时取靠前的，与按时间顺序处理时第一个转换成功的读数相同
+    size_t first = n;
+    for (size_t i = 0; i < n; ++i) {
+        GNSS gps_msg = gnss.Get(i);
+        if (!ConvertGps2UTM(gps_msg, antenna_pos, antenna_angle)) {
+            continue;
+        }
+        utm_table.pose_[i] = gps_msg.utm_pose_;
+        utm_table.valid_[i] = 1;
+        if (first == n || gnss.unix_time_[i] < gnss.unix_time_[first]) {
+            first = i;
+        }
+    }
+    if (first == n) {
+        return false;
+    }
+
+    utm_table.origin_ = utm_table.pose_[first].translation();
+    for (size_t i = 0; i < n; ++i) {
+        if (utm_table.valid_[i]) {
+            utm_table.pose_[i].translation() -= utm_table.origin_;
+        }
+    }
+    return true;
+}
+
 }  // namespace sad
\ No newline at end of file
@@ -7,8 +7,27 @@
 
 #include "common/gnss.h"
 
+#include <cstdint>
+#include <vector>
+
 namespace sad {
 
+struct GNSSTable;
+
+/**
+ * 一个日志全部GNSS读数的UTM位姿，与GNSSTable逐行对应
+ * GPS时间偏移只改变时间，不改变位置，因此只需转换一次，可由各偏移的滤波共享
+ */
+struct GNSSUTMTable {
+    Vec3d origin_ = Vec3d::Zero();  // 原点：时间最早的转换成功的GNSS位置
+    std::vector<SE3> pose_;         // 减去原点后的位姿，航向无效时只有平移
+    std::vector<uint8_t> valid_;    // 是否转换成功
+
+    size_t Size() const { return pose_.size(); }
+
+    size_t MemoryBytes() const { return pose_.capacity() * sizeof(SE3) + valid_.capacity(); }
+};
+
 /**
  * 计算本书的GNSS读数对应的UTM pose和六自由度Pose
  * @param gnss_reading  输入gnss读数
@@ -27,6 +46,17 @@ bool ConvertGps2UTM(GNSS& gnss_reading, const Vec2d& antenna_pos, const double&
  */
 bool ConvertGps2UTMOnlyTrans(GNSS& gnss_reading);
 
+/**
+ * 转换GNSSTable中的全部读数，结果与逐个调用ConvertGps2UTM后减去原点相同
+ * @param gnss          GNSS表
+ * @param antenna_pos   安装位置
+ * @param antenna_angle 安装偏角
+ * @param utm_table     输出的UTM位姿表
+ * @return 是否至少有一个读数转换成功
+ */
+bool ConvertGNSSTable2UTM(const GNSSTable& gnss, const Vec2d& antenna_pos, double antenna_angle,
+                          GNSSUTMTable& utm_table);
+
 /**
  * 经纬度转UTM
  * NOTE 经纬度单位为度数
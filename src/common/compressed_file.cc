@@ -0,0 +1,364 @@
+//
+// 压缩日志(.gz/.zst)的流式读取
+//
+
+#include "common/compressed_file.h"
+
+#include <glog/logging.h>
+#include <zlib.h>
+#include <cstdio>
+#include <cstring>
+
+#ifdef SAD_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace sad {
+
+namespace {
+
+bool EndsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+CompressionType DetectCompression(const std::string& file_path) {
+    if (EndsWith(file_path, ".gz")) {
+        return CompressionType::GZIP;
+    }
+    if (EndsWith(file_path, ".zst")) {
+        return CompressionType::ZSTD;
+    }
+    return CompressionType::NONE;
+}
+
+bool IsCompressionSupported(CompressionType type) {
+    switch (type) {
+        case CompressionType::GZIP:
+            return true;
+        case CompressionType::ZSTD:
+#ifdef SAD_WITH_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        default:
+            return false;
+    }
+}
+
+/// 解压器：每次Read()尽量填满缓冲区，返回写入的字节数，数据结束返回0，出错返回-1
+class CompressedLineReader::Decompressor {
+   public:
+    virtual ~Decompressor() = default;
+    virtual bool Open(const std::string& file_path) = 0;
+    virtual long Read(char* buffer, size_t capacity) = 0;
+};
+
+namespace {
+
+/// gzip，支持多个gzip成员首尾相接的文件
+class GzipDecompressor : public CompressedLineReader::Decompressor {
+   public:
+    ~GzipDecompressor() override {
+        if (file_ != nullptr) {
+            gzclose(file_);
+        }
+    }
+
+    bool Open(const std::string& file_path) override {
+        file_ = gzopen(file_path.c_str(), "rb");
+        if (file_ == nullptr) {
+            return false;
+        }
+        gzbuffer(file_, 1 << 20);
+        return true;
+    }
+
+    long Read(char* buffer, size_t capacity) override {
+        size_t total = 0;
+        while (total < capacity) {
+            unsigned int request = static_cast<unsigned int>(std::min<size_t>(capacity - total, 1u << 30));
+            int n = gzread(file_, buffer + total, request);
+            if (n < 0) {
+                int err = 0;
+                LOG(ERROR) << "gzip解压失败: " << gzerror(file_, &err);
+                return -1;
+            }
+            if (n == 0) {
+                // 文件被截断时gzread同样返回0，由错误码区分
+                int err = Z_OK;
+                const char* msg = gzerror(file_, &err);
+                if (err != Z_OK) {
+                    LOG(ERROR) << "gzip文件不完整: " << msg;
+                    return -1;
+                }
+                break;
+            }
+            total += static_cast<size_t>(n);
+        }
+        return static_cast<long>(total);
+    }
+
+   private:
+    gzFile file_ = nullptr;
+};
+
+#ifdef SAD_WITH_ZSTD
+/// zstd流式解压，支持多个frame首尾相接的文件
+class ZstdDecompressor : public CompressedLineReader::Decompressor {
+   public:
+    ~ZstdDecompressor() override {
+        if (stream_ != nullptr) {
+            ZSTD_freeDStream(stream_);
+        }
+        if (file_ != nullptr) {
+            std::fclose(file_);
+        }
+    }
+
+    bool Open(const std::string& file_path) override {
+        file_ = std::fopen(file_path.c_str(), "rb");
+        if (file_ == nullptr) {
+            return false;
+        }
+        stream_ = ZSTD_createDStream();
+        if (stream_ == nullptr || ZSTD_isError(ZSTD_initDStream(stream_))) {
+            LOG(ERROR) << "zstd解压器初始化失败";
+            return false;
+        }
+        in_buffer_.resize(ZSTD_DStreamInSize());
+        in_ = {in_buffer_.data(), 0, 0};
+        return true;
+    }
+
+    long Read(char* buffer, size_t capacity) override {
+        ZSTD_outBuffer out = {buffer, capacity, 0};
+        while (out.pos < out.size) {
+            if (in_.pos == in_.size) {
+                size_t n = std::fread(in_buffer_.data(), 1, in_buffer_.size(), file_);
+                if (n == 0) {
+                    // 输入读完时最后一个frame必须已经解压完整，否则文件被截断
+                    if (std::ferror(file_) || last_ret_ != 0) {
+                        LOG(ERROR) << "zstd文件不完整或读取失败";
+                        return -1;
+                    }
+                    break;
+                }
+                in_ = {in_buffer_.data(), n, 0};
+            }
+            size_t ret = ZSTD_decompressStream(stream_, &out, &in_);
+            if (ZSTD_isError(ret)) {
+                LOG(ERROR) << "zstd解压失败: " << ZSTD_getErrorName(ret);
+                return -1;
+            }
+            last_ret_ = ret;
+        }
+        return static_cast<long>(out.pos);
+    }
+
+   private:
+    FILE* file_ = nullptr;
+    ZSTD_DStream* stream_ = nullptr;
+    std::vector<char> in_buffer_;
+    ZSTD_inBuffer in_ = {nullptr, 0, 0};
+    size_t last_ret_ = 0;  // 上一次ZSTD_decompressStream的返回值，0表示一个frame解压完整
+};
+#endif
+
+}  // namespace
+
+CompressedLineReader::CompressedLineReader() = default;
+
+CompressedLineReader::~CompressedLineReader() { Close(); }
+
+bool CompressedLineReader::Open(const std::string& file_path) {
+    Close();
+
+    CompressionType type = DetectCompression(file_path);
+    if (!IsCompressionSupported(type)) {
+        LOG(ERROR) << "不支持的压缩格式: " << file_path;
+        return false;
+    }
+
+    if (type == CompressionType::GZIP) {
+        decompressor_ = std::make_unique<GzipDecompressor>();
+    }
+#ifdef SAD_WITH_ZSTD
+    if (type == CompressionType::ZSTD) {
+        decompressor_ = std::make_unique<ZstdDecompressor>();
+    }
+#endif
+
+    failed_ = false;
+    if (!decompressor_->Open(file_path)) {
+        LOG(ERROR) << "无法打开文件: " << file_path;
+        decompressor_.reset();
+        return false;
+    }
+
+    stats_ = Stats();
+    start_time_ = std::chrono::steady_clock::now();
+    worker_ = std::thread(&CompressedLineReader::DecompressLoop, this);
+    return true;
+}
+
+void CompressedLineReader::Close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    decompressor_.reset();
+
+    ready_.clear();
+    free_.clear();
+    num_blocks_ = 0;
+    producer_done_ = false;
+    stop_ = false;
+    current_ = Block();
+    pos_ = 0;
+    carry_.clear();
+    line_buffer_.clear();
+    finished_ = false;
+}
+
+void CompressedLineReader::DecompressLoop() {
+    double busy_sec = 0;
+    uint64_t raw_bytes = 0;
+
+    while (true) {
+        Block block;
+        {
+            // 等待空块，队列满时解压线程在此阻塞，内存占用不超过kQueueBlocks+1块
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stop_ || !free_.empty() || num_blocks_ < kQueueBlocks + 1; });
+            if (stop_) {
+                break;
+            }
+            if (!free_.empty()) {
+                block = std::move(free_.back());
+                free_.pop_back();
+            } else {
+                num_blocks_++;
+            }
+        }
+        if (block.data_ == nullptr) {
+            block.data_.reset(new char[kBlockSize]);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        long n = decompressor_->Read(block.data_.get(), kBlockSize);
+        busy_sec += SecondsSince(start);
+
+        if (n <= 0) {
+            if (n < 0) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                failed_ = true;
+            }
+            break;
+        }
+        block.size_ = static_cast<size_t>(n);
+        raw_bytes += block.size_;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.push_back(std::move(block));
+        }
+        cv_.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        producer_done_ = true;
+        stats_.decompress_sec_ = busy_sec;
+        stats_.raw_bytes_ = raw_bytes;
+    }
+    cv_.notify_all();
+}
+
+bool CompressedLineReader::AcquireBlock() {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // 归还上一块
+    if (current_.data_ != nullptr) {
+        free_.push_back(std::move(current_));
+        current_ = Block();
+        cv_.notify_all();
+    }
+
+    cv_.wait(lock, [this]() { return !ready_.empty() || producer_done_; });
+    stats_.wait_sec_ += SecondsSince(start);
+    if (ready_.empty()) {
+        return false;
+    }
+
+    current_ = std::move(ready_.front());
+    ready_.pop_front();
+    pos_ = 0;
+    return true;
+}
+
+bool CompressedLineReader::NextLine(std::string_view& line) {
+    if (finished_ || decompressor_ == nullptr) {
+        return false;
+    }
+
+    while (true) {
+        if (pos_ < current_.size_) {
+            const char* begin = current_.data_.get() + pos_;
+            size_t remain = current_.size_ - pos_;
+            const char* newline = static_cast<const char*>(std::memchr(begin, '\n', remain));
+            if (newline != nullptr) {
+                size_t len = static_cast<size_t>(newline - begin);
+                pos_ += len + 1;
+                if (carry_.empty()) {
+                    line = std::string_view(begin, len);
+                } else {
+                    // 与上一块末尾的半行拼接
+                    carry_.append(begin, len);
+                    line_buffer_.swap(carry_);
+                    carry_.clear();
+                    line = line_buffer_;
+                }
+                return true;
+            }
+
+            carry_.append(begin, remain);
+            pos_ = current_.size_;
+        }
+
+        if (!AcquireBlock()) {
+            finished_ = true;
+            stats_.wall_sec_ = SecondsSince(start_time_);
+            if (!carry_.empty()) {
+                // 最后一行没有换行符
+                line_buffer_.swap(carry_);
+                carry_.clear();
+                line = line_buffer_;
+                return true;
+            }
+            return false;
+        }
+    }
+}
+
+void CompressedLineReader::LogStats() const {
+    const double mb = static_cast<double>(stats_.raw_bytes_) / (1024.0 * 1024.0);
+    const double parse_sec = stats_.wall_sec_ - stats_.wait_sec_;
+    LOG(INFO) << "解压 " << mb << " MB: 解压耗时 " << stats_.decompress_sec_ << " s ("
+              << (stats_.decompress_sec_ > 0 ? mb / stats_.decompress_sec_ : 0) << " MB/s), 解析耗时 " << parse_sec
+              << " s, 等待解压 " << stats_.wait_sec_ << " s, 总耗时 " << stats_.wall_sec_ << " s, 解压与解析重叠 "
+              << stats_.Overlap() * 100.0 << "%";
+}
+
+}  // namespace sad
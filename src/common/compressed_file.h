@@ -0,0 +1,113 @@
+//
+// 压缩日志(.gz/.zst)的流式读取
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_COMPRESSED_FILE_H
+#define SLAM_IN_AUTO_DRIVING_COMPRESSED_FILE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace sad {
+
+/// 日志文件的压缩格式，按扩展名判断
+enum class CompressionType { NONE, GZIP, ZSTD };
+
+CompressionType DetectCompression(const std::string& file_path);
+
+/// 当前编译是否支持该压缩格式，zstd需要在编译时找到libzstd（定义SAD_WITH_ZSTD）
+bool IsCompressionSupported(CompressionType type);
+
+/**
+ * 压缩日志的逐行读取
+ *
+ * 后台线程把文件按kBlockSize大小的块解压，解析线程通过NextLine()逐行取用，
+ * 两个线程之间以最多kQueueBlocks块的有界队列交接，解压与解析同时进行，内存占用固定
+ * 块边界处被截断的行会拼接完整后再返回
+ */
+class CompressedLineReader {
+   public:
+    static constexpr size_t kBlockSize = 4 << 20;
+    static constexpr size_t kQueueBlocks = 3;
+
+    /// 解压与解析的耗时统计
+    struct Stats {
+        uint64_t raw_bytes_ = 0;     // 解压后的字节数
+        double decompress_sec_ = 0;  // 解压线程实际工作时间
+        double wait_sec_ = 0;        // 解析线程等待解压数据的时间
+        double wall_sec_ = 0;        // 从打开到读完的总时间
+
+        /// 解压时间中被解析掩盖的比例，1表示解压完全与解析重叠
+        double Overlap() const { return decompress_sec_ > 0 ? 1.0 - wait_sec_ / decompress_sec_ : 1.0; }
+    };
+
+    CompressedLineReader();
+    ~CompressedLineReader();
+
+    CompressedLineReader(const CompressedLineReader&) = delete;
+    CompressedLineReader& operator=(const CompressedLineReader&) = delete;
+
+    /// 打开文件并启动解压线程，格式不支持或文件无法打开时返回false
+    bool Open(const std::string& file_path);
+
+    /// 取下一行（不含换行符），line在下一次调用前有效；读完或解压出错时返回false，用Failed()区分
+    bool NextLine(std::string_view& line);
+
+    /// 解压是否出错（数据损坏或文件被截断），出错时已返回的行只是文件的一部分
+    bool Failed() const { return failed_; }
+
+    /// 停止解压线程并关闭文件
+    void Close();
+
+    const Stats& GetStats() const { return stats_; }
+
+    /// 输出吞吐量与重叠情况
+    void LogStats() const;
+
+    /// 解压器接口，实现见compressed_file.cc
+    class Decompressor;
+
+   private:
+    struct Block {
+        std::unique_ptr<char[]> data_;
+        size_t size_ = 0;
+    };
+
+    void DecompressLoop();
+
+    /// 取下一块解压好的数据，数据结束时返回false
+    bool AcquireBlock();
+
+    std::unique_ptr<Decompressor> decompressor_;
+    std::thread worker_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Block> ready_;  // 已解压、待解析的块
+    std::vector<Block> free_;  // 可复用的空块
+    size_t num_blocks_ = 0;    // 已分配的块数
+    bool producer_done_ = false;
+    bool stop_ = false;
+    bool failed_ = false;  // 解压出错，由解压线程在producer_done_之前写入，Close()后仍保留到下一次Open()
+
+    Block current_;  // 正在解析的块
+    size_t pos_ = 0;
+    std::string carry_;        // 上一块末尾不完整的行
+    std::string line_buffer_;  // 跨块拼接出的行
+    bool finished_ = false;
+
+    Stats stats_;
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_COMPRESSED_FILE_H
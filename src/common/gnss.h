@@ -5,6 +5,8 @@
 #ifndef SLAM_IN_AUTO_DRIVING_GNSS_H
 #define SLAM_IN_AUTO_DRIVING_GNSS_H
 
+#include <memory>
+
 #include "common/eigen_types.h"
 // #include "common/message_def.h"
 
@@ -0,0 +1,228 @@
+//
+// 分开记录的加速度计与陀螺仪数据的时间同步
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_IMU_SYNCHRONIZER_H
+#define SLAM_IN_AUTO_DRIVING_IMU_SYNCHRONIZER_H
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+#include "common/eigen_types.h"
+#include "common/imu.h"
+
+namespace sad {
+
+/// 定长环形缓冲区，容量在编译期确定，运行中不申请内存
+template <typename T, size_t N>
+class RingBuffer {
+   public:
+    bool Empty() const { return size_ == 0; }
+    bool Full() const { return size_ == N; }
+    size_t Size() const { return size_; }
+
+    /// i=0为最早的元素
+    T& operator[](size_t i) { return data_[(head_ + i) % N]; }
+    const T& operator[](size_t i) const { return data_[(head_ + i) % N]; }
+    T& Front() { return data_[head_]; }
+    const T& Back() const { return data_[(head_ + size_ - 1) % N]; }
+
+    /// 调用前需保证未满
+    void PushBack(const T& value) {
+        data_[(head_ + size_) % N] = value;
+        ++size_;
+    }
+
+    void PopFront() {
+        head_ = (head_ + 1) % N;
+        --size_;
+    }
+
+    void Clear() { head_ = size_ = 0; }
+
+   private:
+    std::array<T, N> data_;
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+/**
+ * 把$ACC与$GYR两路数据合成IMU
+ *
+ * 两路数据各自缓存在环形缓冲区中，以加速度计的时间戳输出IMU，输出频率与加速度计一致：
+ * INTERPOLATE: 用前后两帧陀螺仪数据线性插值到加速度计时刻，两帧间隔过大或缺少一侧时退化为最近邻
+ * NEAREST:     取时间最近的一帧陀螺仪数据
+ * 最近邻的时间差超过max_time_diff_时丢弃该帧加速度计数据
+ * 日志成批写入时同一路数据可能连续出现多帧，缓冲区可容纳kCapacity帧，不会因此丢数据
+ *
+ * 加速度计数据要等到时间不早于它的陀螺仪数据到达后才输出，数据结束时需调用Flush()输出剩余数据
+ */
+class ImuSynchronizer {
+   public:
+    enum class Mode { INTERPOLATE, NEAREST };
+
+    struct Options {
+        Options() {}
+        Mode mode_ = Mode::INTERPOLATE;
+        double max_time_diff_ = 0.05;  // 最近邻配对允许的最大时间差(秒)
+        double max_interp_gap_ = 0.1;  // 插值时前后两帧陀螺仪数据的最大间隔(秒)
+    };
+
+    /// 同步统计
+    struct Stats {
+        size_t interpolated_ = 0;  // 插值得到的IMU数
+        size_t paired_ = 0;        // 最近邻配对得到的IMU数
+        size_t dropped_acc_ = 0;   // 没有可用陀螺仪数据或时间倒退而丢弃的加速度计数据
+        size_t dropped_gyr_ = 0;   // 未参与任何配对/插值，或时间倒退而丢弃的陀螺仪数据
+        size_t overflow_ = 0;      // 缓冲区满而提前处理或丢弃的次数
+
+        size_t Output() const { return interpolated_ + paired_; }
+    };
+
+    static constexpr size_t kCapacity = 64;
+
+    explicit ImuSynchronizer(Options options = Options()) : options_(options) {}
+
+    void SetOptions(const Options& options) { options_ = options; }
+    const Stats& GetStats() const { return stats_; }
+
+    /// 输入一帧加速度计数据，emit(const IMU&)可能被调用0次或多次
+    template <typename Emit>
+    void AddAcce(double timestamp, const Vec3d& acce, Emit&& emit) {
+        if (has_acc_ && timestamp < last_acc_time_) {
+            stats_.dropped_acc_++;
+            return;
+        }
+        has_acc_ = true;
+        last_acc_time_ = timestamp;
+
+        if (acc_.Full()) {
+            // 陀螺仪数据迟迟未到，用已有数据处理最早的一帧
+            stats_.overflow_++;
+            ResolveFront(emit);
+        }
+        acc_.PushBack({timestamp, acce});
+        Process(emit);
+    }
+
+    /// 输入一帧陀螺仪数据
+    template <typename Emit>
+    void AddGyro(double timestamp, const Vec3d& gyro, Emit&& emit) {
+        if (!gyr_.Empty() && timestamp < gyr_.Back().timestamp_) {
+            stats_.dropped_gyr_++;
+            return;
+        }
+
+        if (gyr_.Full()) {
+            stats_.overflow_++;
+            PopGyro();
+        }
+        gyr_.PushBack({timestamp, gyro, false});
+        Process(emit);
+    }
+
+    /// 数据结束，用已有的陀螺仪数据处理剩余的加速度计数据
+    template <typename Emit>
+    void Flush(Emit&& emit) {
+        while (!acc_.Empty()) {
+            ResolveFront(emit);
+        }
+        while (!gyr_.Empty()) {
+            PopGyro();
+        }
+    }
+
+   private:
+    struct AccSample {
+        double timestamp_;
+        Vec3d acce_;
+    };
+
+    struct GyrSample {
+        double timestamp_;
+        Vec3d gyro_;
+        bool used_;
+    };
+
+    /// 处理所有已经等到后一帧陀螺仪数据的加速度计数据
+    template <typename Emit>
+    void Process(Emit& emit) {
+        while (!acc_.Empty() && !gyr_.Empty() && gyr_.Back().timestamp_ >= acc_.Front().timestamp_) {
+            ResolveFront(emit);
+        }
+        // 没有待处理的加速度计数据时，早于最后一帧加速度计的陀螺仪数据只需保留一帧作为插值的前一帧
+        if (acc_.Empty()) {
+            while (gyr_.Size() >= 2 && gyr_[1].timestamp_ <= last_acc_time_) {
+                PopGyro();
+            }
+        }
+    }
+
+    /// 处理最早的一帧加速度计数据
+    template <typename Emit>
+    void ResolveFront(Emit& emit) {
+        const AccSample& acc = acc_.Front();
+
+        // 丢掉不可能再作为前一帧的陀螺仪数据，之后gyr_[0]为不晚于acc的最后一帧（如果有）
+        while (gyr_.Size() >= 2 && gyr_[1].timestamp_ <= acc.timestamp_) {
+            PopGyro();
+        }
+
+        GyrSample* before = nullptr;
+        GyrSample* after = nullptr;
+        if (!gyr_.Empty()) {
+            if (gyr_[0].timestamp_ <= acc.timestamp_) {
+                before = &gyr_[0];
+                if (gyr_.Size() >= 2) {
+                    after = &gyr_[1];
+                }
+            } else {
+                after = &gyr_[0];
+            }
+        }
+
+        if (options_.mode_ == Mode::INTERPOLATE && before != nullptr && after != nullptr &&
+            after->timestamp_ - before->timestamp_ <= options_.max_interp_gap_) {
+            double span = after->timestamp_ - before->timestamp_;
+            double s = span > 0 ? (acc.timestamp_ - before->timestamp_) / span : 0.0;
+            before->used_ = after->used_ = true;
+            stats_.interpolated_++;
+            emit(IMU(acc.timestamp_, before->gyro_ + s * (after->gyro_ - before->gyro_), acc.acce_));
+        } else {
+            GyrSample* nearest = before;
+            if (after != nullptr &&
+                (nearest == nullptr || after->timestamp_ - acc.timestamp_ < acc.timestamp_ - nearest->timestamp_)) {
+                nearest = after;
+            }
+            if (nearest != nullptr && std::abs(nearest->timestamp_ - acc.timestamp_) <= options_.max_time_diff_) {
+                nearest->used_ = true;
+                stats_.paired_++;
+                emit(IMU(acc.timestamp_, nearest->gyro_, acc.acce_));
+            } else {
+                stats_.dropped_acc_++;
+            }
+        }
+
+        acc_.PopFront();
+    }
+
+    void PopGyro() {
+        if (!gyr_.Front().used_) {
+            stats_.dropped_gyr_++;
+        }
+        gyr_.PopFront();
+    }
+
+    Options options_;
+    Stats stats_;
+
+    RingBuffer<AccSample, kCapacity> acc_;
+    RingBuffer<GyrSample, kCapacity> gyr_;
+    bool has_acc_ = false;
+    double last_acc_time_ = 0;
+};
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_IMU_SYNCHRONIZER_H
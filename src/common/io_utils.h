@@ -1,172 +1,182 @@
-//
-// Created by xiang on 2021/7/20.
-// Modified: 去掉ROS依赖，保留TxtIO功能
-//
-
-#ifndef SLAM_IN_AUTO_DRIVING_IO_UTILS_H
-#define SLAM_IN_AUTO_DRIVING_IO_UTILS_H
-
-#include <fstream>
-#include <functional>
-#include <utility>
-
-#include "common/dataset_type.h"
-#include "common/gnss.h"
-#include "common/imu.h"
-#include "common/math_utils.h"
-#include "common/odom.h"
-#include <set>  
-
-namespace sad {
-
-/// NZZ数据结构
-struct NZZ {
-    std::string time_key_;  // 时间字符串，用于匹配 "2025-6-12 11:22:27"
-    double heading_;        // 航向角（度）
-    
-    NZZ() = default;
-    NZZ(const std::string& time_key, double heading) : time_key_(time_key), heading_(heading) {}
-};
-
-/// 带时间字符串的GPS数据结构，用于GPS-NZZ匹配
-struct GPSWithTimeKey {
-    GNSS gnss_data_;       // 原始GPS数据
-    std::string time_key_; // 时间字符串，用于匹配 "2025-6-12 11:22:27"
-    
-    GPSWithTimeKey() = default;
-    GPSWithTimeKey(const GNSS& gnss, const std::string& time_key) 
-        : gnss_data_(gnss), time_key_(time_key) {}
-};
-
-/// FBK Flag数据结构
-struct FBKFlag {
-    double timestamp_;  // 时间戳（从字段3获取，毫秒转秒）
-    
-    FBKFlag() = default;
-    FBKFlag(double timestamp) : timestamp_(timestamp) {}
-};
-
-/// FBK Misalignment数据结构
-struct FBKMisalignment {
-    double pitch_;    // pitch角（度）
-    double heading_;  // heading角（度）
-    
-    FBKMisalignment() = default;
-    FBKMisalignment(double pitch, double heading) : pitch_(pitch), heading_(heading) {}
-};
-
-/// FBK完整数据对（Flag + Misalignment）
-struct FBKPair {
-    FBKFlag flag_;
-    FBKMisalignment misalignment_;
-    bool valid_;  // 是否有效（flag和misalignment都存在）
-    
-    FBKPair() : valid_(false) {}
-    FBKPair(const FBKFlag& flag, const FBKMisalignment& misalignment) 
-        : flag_(flag), misalignment_(misalignment), valid_(true) {}
-};
-
-/**
- * 读取本书提供的数据文本文件，并调用回调函数
- * 数据文本文件主要提供IMU/Odom/GNSS读数
- */
-class TxtIO {
-   public:
-    TxtIO(const std::string &file_path) : fin(file_path) {}
-
-    /// 定义回调函数
-    using IMUProcessFuncType = std::function<void(const IMU &)>;
-    using OdomProcessFuncType = std::function<void(const Odom &)>;
-    using GNSSProcessFuncType = std::function<void(const GNSS &)>;
-    using NZZProcessFuncType = std::function<void(const NZZ &)>;
-    using GPSWithTimeKeyProcessFuncType = std::function<void(const GPSWithTimeKey &)>;
-    using FBKPairProcessFuncType = std::function<void(const FBKPair &)>;
-
-    TxtIO &SetIMUProcessFunc(IMUProcessFuncType imu_proc) {
-        imu_proc_ = std::move(imu_proc);
-        return *this;
-    }
-
-    TxtIO &SetOdomProcessFunc(OdomProcessFuncType odom_proc) {
-        odom_proc_ = std::move(odom_proc);
-        return *this;
-    }
-
-    TxtIO &SetGNSSProcessFunc(GNSSProcessFuncType gnss_proc) {
-        gnss_proc_ = std::move(gnss_proc);
-        return *this;
-    }
-
-    TxtIO &SetNZZProcessFunc(NZZProcessFuncType nzz_proc) {
-        nzz_proc_ = std::move(nzz_proc);
-        return *this;
-    }
-
-    TxtIO &SetGPSWithTimeKeyProcessFunc(GPSWithTimeKeyProcessFuncType gps_timekey_proc) {
-        gps_timekey_proc_ = std::move(gps_timekey_proc);
-        return *this;
-    }
-
-    TxtIO &SetFBKPairProcessFunc(FBKPairProcessFuncType fbk_proc) {
-        fbk_proc_ = std::move(fbk_proc);
-        return *this;
-    }
-
-    // 遍历文件内容，调用回调函数
-    void Go();
-
-   private:
-    /// 存储待组合的加速度和陀螺仪数据
-    struct PendingAccData {
-        double timestamp;
-        Vec3d acce;
-        bool valid = false;
-    };
-    
-    struct PendingGyrData {
-        double timestamp;
-        Vec3d gyro;
-        bool valid = false;
-    };
-
-    /// 处理各种数据格式
-    void ProcessGPS(std::stringstream& ss);
-    void ProcessACC(std::stringstream& ss);
-    void ProcessGYR(std::stringstream& ss);
-    void ProcessNZZ(std::stringstream& ss);
-    void ProcessFBK(std::stringstream& ss);
-
-    /// 尝试组合IMU数据
-    void TryCreateIMU();
-
-    std::ifstream fin;
-    IMUProcessFuncType imu_proc_;
-    OdomProcessFuncType odom_proc_;
-    GNSSProcessFuncType gnss_proc_;
-    NZZProcessFuncType nzz_proc_;
-    GPSWithTimeKeyProcessFuncType gps_timekey_proc_;
-    FBKPairProcessFuncType fbk_proc_;
-
-    /// IMU数据组合相关
-    PendingAccData pending_acc_;
-    PendingGyrData pending_gyr_;
-    static constexpr double TIME_SYNC_THRESHOLD = 0.05; // 50ms同步阈值
-
-    /// NZZ数据去重相关
-    std::set<std::string> processed_nzz_times_; // 已处理的NZZ时间，用于去重
-
-    /// FBK数据处理相关
-    FBKFlag pending_flag_;          // 待匹配的flag数据
-    bool pending_flag_valid_;       // flag数据是否有效
-};
-
-// 注释掉RosbagIO类，因为它依赖ROS
-/*
-class RosbagIO {
-    // ... ROS相关功能暂时移除
-};
-*/
-
-}  // namespace sad
-
+//
+// Created by xiang on 2021/7/20.
+// Modified: 去掉ROS依赖，保留TxtIO功能
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_IO_UTILS_H
+#define SLAM_IN_AUTO_DRIVING_IO_UTILS_H
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "common/dataset_type.h"
+#include "common/gnss.h"
+#include "common/imu.h"
+#include "common/math_utils.h"
+#include "common/odom.h"
+
+namespace sad {
+
+/**
+ * 日志中"年-月-日 时:分:秒"形式的时间，按UTC换算成的整数秒
+ * 在解析时计算，用于NZZ去重与GPS-NZZ匹配；"2025-6-12"与"2025-06-12"得到相同的键
+ */
+using TimeKey = int64_t;
+
+constexpr TimeKey MakeTimeKey(int year, int month, int day, int hour, int minute, int second) {
+    // 公历日期到1970-01-01的天数
+    const int y = year - (month <= 2 ? 1 : 0);
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    const int64_t days = static_cast<int64_t>(era) * 146097 + doe - 719468;
+    return days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+/// 时间键的字符串形式 "2025-6-12 11:22:27"，仅用于调试输出
+std::string FormatTimeKey(TimeKey key);
+
+/// NZZ数据结构
+struct NZZ {
+    TimeKey time_key_ = 0;  // 时间键，用于匹配
+    double heading_ = 0;    // 航向角（度）
+    bool unpadded_ = true;  // 日志中的日期时间不含补零，与GPS时间的写法一致，用于区分直接匹配与模糊匹配的统计
+
+    NZZ() = default;
+    NZZ(TimeKey time_key, double heading, bool unpadded = true)
+        : time_key_(time_key), heading_(heading), unpadded_(unpadded) {}
+};
+
+/// 带时间键的GPS数据结构，用于GPS-NZZ匹配
+struct GPSWithTimeKey {
+    GNSS gnss_data_;        // 原始GPS数据
+    TimeKey time_key_ = 0;  // 时间键，用于匹配
+
+    GPSWithTimeKey() = default;
+    GPSWithTimeKey(const GNSS& gnss, TimeKey time_key) : gnss_data_(gnss), time_key_(time_key) {}
+};
+
+/// FBK Flag数据结构
+struct FBKFlag {
+    double timestamp_;  // 时间戳（从字段3获取，毫秒转秒）
+    
+    FBKFlag() = default;
+    FBKFlag(double timestamp) : timestamp_(timestamp) {}
+};
+
+/// FBK Misalignment数据结构
+struct FBKMisalignment {
+    double pitch_;    // pitch角（度）
+    double heading_;  // heading角（度）
+    
+    FBKMisalignment() = default;
+    FBKMisalignment(double pitch, double heading) : pitch_(pitch), heading_(heading) {}
+};
+
+/// FBK完整数据对（Flag + Misalignment）
+struct FBKPair {
+    FBKFlag flag_;
+    FBKMisalignment misalignment_;
+    bool valid_;  // 是否有效（flag和misalignment都存在）
+    
+    FBKPair() : valid_(false) {}
+    FBKPair(const FBKFlag& flag, const FBKMisalignment& misalignment) 
+        : flag_(flag), misalignment_(misalignment), valid_(true) {}
+};
+
+/// 文本日志的读取方式
+/// STREAM: ifstream逐行读取
+/// MMAP:   整个文件内存映射，行直接在映射区上切分，适合离线处理大日志，可多线程分块解析
+enum class TxtReadMode { STREAM, MMAP };
+
+/**
+ * 读取本书提供的数据文本文件，并调用回调函数
+ * 数据文本文件主要提供IMU/Odom/GNSS读数
+ *
+ * 两种读取方式使用同一套逐行解析，产生的回调完全一致
+ * 回调以std::function保存，逐条记录经类型擦除调用；对吞吐量敏感的场景可直接使用 TxtReader（见txt_reader.h），
+ * 它以处理器类型为模板参数，回调可被内联，行为与本类相同
+ */
+class TxtIO {
+   public:
+    using ReadMode = TxtReadMode;
+
+    TxtIO(const std::string &file_path, ReadMode mode = ReadMode::STREAM) : file_path_(file_path), mode_(mode) {}
+
+    /// 定义回调函数
+    using IMUProcessFuncType = std::function<void(const IMU &)>;
+    using OdomProcessFuncType = std::function<void(const Odom &)>;
+    using GNSSProcessFuncType = std::function<void(const GNSS &)>;
+    using NZZProcessFuncType = std::function<void(const NZZ &)>;
+    using GPSWithTimeKeyProcessFuncType = std::function<void(const GPSWithTimeKey &)>;
+    using FBKPairProcessFuncType = std::function<void(const FBKPair &)>;
+
+    TxtIO &SetIMUProcessFunc(IMUProcessFuncType imu_proc) {
+        imu_proc_ = std::move(imu_proc);
+        return *this;
+    }
+
+    TxtIO &SetOdomProcessFunc(OdomProcessFuncType odom_proc) {
+        odom_proc_ = std::move(odom_proc);
+        return *this;
+    }
+
+    TxtIO &SetGNSSProcessFunc(GNSSProcessFuncType gnss_proc) {
+        gnss_proc_ = std::move(gnss_proc);
+        return *this;
+    }
+
+    TxtIO &SetNZZProcessFunc(NZZProcessFuncType nzz_proc) {
+        nzz_proc_ = std::move(nzz_proc);
+        return *this;
+    }
+
+    TxtIO &SetGPSWithTimeKeyProcessFunc(GPSWithTimeKeyProcessFuncType gps_timekey_proc) {
+        gps_timekey_proc_ = std::move(gps_timekey_proc);
+        return *this;
+    }
+
+    TxtIO &SetFBKPairProcessFunc(FBKPairProcessFuncType fbk_proc) {
+        fbk_proc_ = std::move(fbk_proc);
+        return *this;
+    }
+
+    /// 设置MMAP方式的解析线程数，大于1时文件按行边界切块并行解析
+    /// 并行解析时每类回调内部仍保持文件中的顺序，但不同类型的回调之间不再按行交错
+    TxtIO &SetNumThreads(int num_threads) {
+        num_threads_ = num_threads;
+        return *this;
+    }
+
+    // 遍历文件内容，调用回调函数；文件无法打开或读取出错时返回false
+    bool Go();
+
+   private:
+    /// 把回调转交给TxtReader的处理器
+    struct FunctionHandler;
+
+    std::string file_path_;
+    ReadMode mode_ = ReadMode::STREAM;
+    int num_threads_ = 1;
+    IMUProcessFuncType imu_proc_;
+    OdomProcessFuncType odom_proc_;
+    GNSSProcessFuncType gnss_proc_;
+    NZZProcessFuncType nzz_proc_;
+    GPSWithTimeKeyProcessFuncType gps_timekey_proc_;
+    FBKPairProcessFuncType fbk_proc_;
+};
+
+// 注释掉RosbagIO类，因为它依赖ROS
+/*
+class RosbagIO {
+    // ... ROS相关功能暂时移除
+};
+*/
+
+}  // namespace sad
+
 #endif  // SLAM_IN_AUTO_DRIVING_IO_UTILS_H
\ No newline at end of file
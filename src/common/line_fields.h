@@ -0,0 +1,133 @@
+//
+// 文本日志的行内字段切分与数值解析
+// 所有字段均为指向原始缓冲区的string_view，解析过程不做拷贝、不申请堆内存
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_LINE_FIELDS_H
+#define SLAM_IN_AUTO_DRIVING_LINE_FIELDS_H
+
+#include <array>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+namespace sad {
+
+/// 一行中切分出的字段，字段位置在切分时一次性算好
+struct LineFields {
+    static constexpr int kMaxFields = 48;  // 最多保存的字段数，$GPS行约25个字段
+
+    std::array<std::string_view, kMaxFields> fields_;
+    int size_ = 0;  // 实际字段数，可能大于kMaxFields，超出部分不保存
+
+    int Size() const { return size_; }
+    std::string_view operator[](int i) const { return fields_[i]; }
+};
+
+/// 与std::isspace一致的空白字符判断，避免locale开销
+inline bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+
+/// 去除首尾的空格和制表符
+inline std::string_view TrimBlank(std::string_view s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        return std::string_view();
+    }
+    size_t end = s.find_last_not_of(" \t");
+    return s.substr(begin, end - begin + 1);
+}
+
+/// 取出第一个空白分隔的字段，rest返回其后的剩余部分
+inline std::string_view NextToken(std::string_view line, std::string_view& rest) {
+    size_t i = 0;
+    while (i < line.size() && IsBlank(line[i])) {
+        ++i;
+    }
+    size_t begin = i;
+    while (i < line.size() && !IsBlank(line[i])) {
+        ++i;
+    }
+    rest = line.substr(i);
+    return line.substr(begin, i - begin);
+}
+
+/// 按空白字符切分，与 ss >> field 的切分结果一致
+inline void SplitFields(std::string_view line, LineFields& out) {
+    out.size_ = 0;
+    size_t i = 0;
+    const size_t n = line.size();
+    while (i < n) {
+        while (i < n && IsBlank(line[i])) {
+            ++i;
+        }
+        if (i >= n) {
+            break;
+        }
+        size_t begin = i;
+        while (i < n && !IsBlank(line[i])) {
+            ++i;
+        }
+        if (out.size_ < LineFields::kMaxFields) {
+            out.fields_[out.size_] = line.substr(begin, i - begin);
+        }
+        ++out.size_;
+    }
+}
+
+/// 按指定分隔符切分，并去除每个字段首尾的空格和制表符，与 getline(ss, field, delim) 的结果一致
+inline void SplitFields(std::string_view line, char delim, LineFields& out) {
+    out.size_ = 0;
+    size_t begin = 0;
+    while (begin < line.size()) {
+        size_t end = line.find(delim, begin);
+        if (end == std::string_view::npos) {
+            end = line.size();
+        }
+        if (out.size_ < LineFields::kMaxFields) {
+            out.fields_[out.size_] = TrimBlank(line.substr(begin, end - begin));
+        }
+        ++out.size_;
+        begin = end + 1;
+    }
+}
+
+/**
+ * 解析浮点数，行为与std::stod一致：允许前导'+'，只要求前缀是合法数字
+ * 标准库支持浮点from_chars时直接使用，否则退化为在栈上拷贝后调用strtod
+ */
+inline bool ParseDouble(std::string_view s, double& value) {
+    if (!s.empty() && s[0] == '+') {
+        s.remove_prefix(1);
+    }
+    if (s.empty()) {
+        return false;
+    }
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+    return result.ptr != s.data();
+#else
+    char buf[64];
+    if (s.size() >= sizeof(buf)) {
+        return false;
+    }
+    std::memcpy(buf, s.data(), s.size());
+    buf[s.size()] = '\0';
+    char* end = nullptr;
+    value = std::strtod(buf, &end);
+    return end != buf;
+#endif
+}
+
+/// 解析整数，行为与std::stoi一致
+inline bool ParseInt(std::string_view s, int& value) {
+    if (!s.empty() && s[0] == '+') {
+        s.remove_prefix(1);
+    }
+    auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+    return result.ec == std::errc() && result.ptr != s.data();
+}
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_LINE_FIELDS_H
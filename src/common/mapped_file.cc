@@ -0,0 +1,60 @@
+//
+// 只读内存映射文件
+//
+
+#include "common/mapped_file.h"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sad {
+
+bool MappedFile::Open(const std::string& file_path) {
+    Close();
+
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG(ERROR) << "无法打开文件: " << file_path;
+        return false;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        LOG(ERROR) << "无法获取文件大小: " << file_path;
+        ::close(fd);
+        return false;
+    }
+
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+        void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            LOG(ERROR) << "内存映射失败: " << file_path;
+            ::close(fd);
+            size_ = 0;
+            return false;
+        }
+        // 日志按顺序扫描，提示内核加大预读
+        ::madvise(addr, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(addr);
+    }
+
+    // 映射建立后文件描述符即可关闭
+    ::close(fd);
+    is_open_ = true;
+    return true;
+}
+
+void MappedFile::Close() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    is_open_ = false;
+}
+
+}  // namespace sad
@@ -0,0 +1,46 @@
+//
+// 只读内存映射文件
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_MAPPED_FILE_H
+#define SLAM_IN_AUTO_DRIVING_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace sad {
+
+/**
+ * 将整个文件以只读方式映射到进程地址空间
+ * 读取时由内核按需换页，不经过ifstream的缓冲和逐行拷贝，适合顺序扫描大日志
+ */
+class MappedFile {
+   public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& file_path) { Open(file_path); }
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// 打开并映射文件，空文件也视为成功（此时Size()为0）
+    bool Open(const std::string& file_path);
+
+    /// 解除映射
+    void Close();
+
+    bool IsOpen() const { return is_open_; }
+    const char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    std::string_view View() const { return std::string_view(data_, size_); }
+
+   private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool is_open_ = false;
+};
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_MAPPED_FILE_H
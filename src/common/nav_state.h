@@ -33,7 +33,7 @@ struct NavState {
         : timestamp_(time), R_(pose.so3()), p_(pose.translation()), v_(vel) {}
 
     /// 转换到Sophus
-    Sophus::SE3<T> GetSE3() const { return SE3(R_, p_); }
+    Sophus::SE3<T> GetSE3() const { return Sophus::SE3<T>(R_, p_); }
 
     friend std::ostream& operator<<(std::ostream& os, const NavState<T>& s) {
         os << "p: " << s.p_.transpose() << ", v: " << s.v_.transpose()
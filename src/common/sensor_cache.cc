@@ -0,0 +1,282 @@
+//
+// 离线数据的二进制列式缓存
+//
+
+#include "common/sensor_cache.h"
+#include "common/mapped_file.h"
+
+#include <glog/logging.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace sad {
+
+namespace {
+
+constexpr char kCacheMagic[8] = {'S', 'A', 'D', 'C', 'A', 'C', 'H', 'E'};
+
+/// 缓存文件头，共64字节
+struct CacheHeader {
+    char magic_[8];
+    uint32_t version_ = 0;
+    uint32_t header_size_ = 0;
+    uint64_t source_size_ = 0;
+    int64_t source_mtime_ = 0;
+    uint64_t num_imu_ = 0;
+    uint64_t num_gnss_ = 0;
+    uint64_t num_matched_ = 0;
+    uint64_t num_fbk_ = 0;
+};
+static_assert(sizeof(CacheHeader) == 64, "cache header layout changed");
+
+bool GetSourceStat(const std::string& source_path, uint64_t& size, int64_t& mtime) {
+    struct stat st;
+    if (stat(source_path.c_str(), &st) != 0) {
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+    mtime = static_cast<int64_t>(st.st_mtime);
+    return true;
+}
+
+size_t Align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+/// 数据区总字节数
+size_t PayloadSize(const CacheHeader& h) {
+    return h.num_imu_ * 7 * sizeof(double) + h.num_gnss_ * 5 * sizeof(double) +
+           Align8(h.num_gnss_ * sizeof(int32_t)) + Align8(h.num_gnss_ * sizeof(uint8_t)) +
+           h.num_matched_ * 2 * sizeof(double) + h.num_fbk_ * 3 * sizeof(double);
+}
+
+/// 检查文件头与源文件、文件大小是否一致，一致时返回nullptr，否则返回失效原因
+const char* CheckHeader(const CacheHeader& header, uint64_t file_size, const std::string& source_path) {
+    if (std::memcmp(header.magic_, kCacheMagic, sizeof(kCacheMagic)) != 0 || header.version_ != kSensorCacheVersion ||
+        header.header_size_ != sizeof(CacheHeader)) {
+        return "缓存文件格式或版本不符，重新解析";
+    }
+
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+    if (!GetSourceStat(source_path, source_size, source_mtime) || source_size != header.source_size_ ||
+        source_mtime != header.source_mtime_) {
+        return "源文件已变化，缓存失效";
+    }
+
+    if (file_size != sizeof(CacheHeader) + PayloadSize(header)) {
+        return "缓存文件大小不符，重新解析";
+    }
+    return nullptr;
+}
+
+/// 写出一列数据，getter(i)给出第i行，末尾补零到8字节对齐
+template <typename T, typename Getter>
+void WriteColumn(std::ofstream& fout, size_t n, Getter&& getter) {
+    std::vector<T> column(n);
+    for (size_t i = 0; i < n; ++i) {
+        column[i] = static_cast<T>(getter(i));
+    }
+    fout.write(reinterpret_cast<const char*>(column.data()), n * sizeof(T));
+
+    size_t bytes = n * sizeof(T);
+    static const char zeros[8] = {0};
+    fout.write(zeros, Align8(bytes) - bytes);
+}
+
+/// 按列读取的游标
+class ColumnReader {
+   public:
+    explicit ColumnReader(const char* data) : cursor_(data) {}
+
+    /// 读取n行，setter(i, value)写入第i行
+    template <typename T, typename Setter>
+    void Read(size_t n, Setter&& setter) {
+        for (size_t i = 0; i < n; ++i) {
+            T value;
+            std::memcpy(&value, cursor_ + i * sizeof(T), sizeof(T));
+            setter(i, value);
+        }
+        cursor_ += Align8(n * sizeof(T));
+    }
+
+    /// 读取n个double到连续的列中
+    void ReadDoubles(size_t n, double* column) {
+        if (n > 0) {
+            std::memcpy(column, cursor_, n * sizeof(double));
+        }
+        cursor_ += n * sizeof(double);
+    }
+
+   private:
+    const char* cursor_;
+};
+
+}  // namespace
+
+bool SaveSensorCache(const std::string& cache_path, const std::string& source_path, const SensorCacheData& data) {
+    CacheHeader header;
+    std::memcpy(header.magic_, kCacheMagic, sizeof(kCacheMagic));
+    header.version_ = kSensorCacheVersion;
+    header.header_size_ = sizeof(CacheHeader);
+    if (!GetSourceStat(source_path, header.source_size_, header.source_mtime_)) {
+        LOG(WARNING) << "无法获取源文件信息，不写缓存: " << source_path;
+        return false;
+    }
+    const IMUTable& imu = data.tables_.imu_;
+    const GNSSTable& gnss = data.tables_.gnss_;
+    header.num_imu_ = imu.Size();
+    header.num_gnss_ = gnss.Size();
+    header.num_matched_ = data.matched_heading_.size();
+    header.num_fbk_ = data.fbk_.size();
+
+    // 临时文件名由mkstemp生成并以O_EXCL创建，各写入者各用一个，不会截断别人正在写的文件
+    std::string tmp_path = cache_path + ".XXXXXX";
+    int fd = mkstemp(&tmp_path[0]);
+    if (fd < 0) {
+        LOG(WARNING) << "无法创建缓存临时文件: " << tmp_path << ", " << std::strerror(errno);
+        return false;
+    }
+    fchmod(fd, 0644);  // mkstemp创建的文件为0600，缓存需要其他用户也能读
+    close(fd);
+
+    std::ofstream fout(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!fout.is_open()) {
+        LOG(WARNING) << "无法写入缓存文件: " << tmp_path;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const size_t num_imu = imu.Size();
+    WriteColumn<double>(fout, num_imu, [&](size_t i) { return imu.timestamp_[i]; });
+    for (int k = 0; k < 3; ++k) {
+        WriteColumn<double>(fout, num_imu, [&](size_t i) { return imu.gyro_[i][k]; });
+    }
+    for (int k = 0; k < 3; ++k) {
+        WriteColumn<double>(fout, num_imu, [&](size_t i) { return imu.acce_[i][k]; });
+    }
+
+    const size_t num_gnss = gnss.Size();
+    WriteColumn<double>(fout, num_gnss, [&](size_t i) { return gnss.unix_time_[i]; });
+    for (int k = 0; k < 3; ++k) {
+        WriteColumn<double>(fout, num_gnss, [&](size_t i) { return gnss.lat_lon_alt_[i][k]; });
+    }
+    WriteColumn<double>(fout, num_gnss, [&](size_t i) { return gnss.heading_[i]; });
+    WriteColumn<int32_t>(fout, num_gnss, [&](size_t i) { return static_cast<int>(gnss.status_[i]); });
+    WriteColumn<uint8_t>(fout, num_gnss, [&](size_t i) { return gnss.heading_valid_[i]; });
+
+    const auto& matched = data.matched_heading_;
+    WriteColumn<double>(fout, matched.size(), [&](size_t i) { return matched[i].first; });
+    WriteColumn<double>(fout, matched.size(), [&](size_t i) { return matched[i].second; });
+
+    const auto& fbk = data.fbk_;
+    WriteColumn<double>(fout, fbk.size(), [&](size_t i) { return fbk[i].flag_.timestamp_; });
+    WriteColumn<double>(fout, fbk.size(), [&](size_t i) { return fbk[i].misalignment_.pitch_; });
+    WriteColumn<double>(fout, fbk.size(), [&](size_t i) { return fbk[i].misalignment_.heading_; });
+
+    fout.close();
+    if (!fout) {
+        LOG(WARNING) << "缓存文件写入失败: " << tmp_path;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    // rename是原子的，多个写入者先后替换为内容相同的完整文件
+    if (std::rename(tmp_path.c_str(), cache_path.c_str()) != 0) {
+        LOG(WARNING) << "缓存文件重命名失败: " << cache_path;
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+
+    LOG(INFO) << "已写入数据缓存: " << cache_path;
+    return true;
+}
+
+bool IsSensorCacheValid(const std::string& cache_path, const std::string& source_path) {
+    struct stat st;
+    if (stat(cache_path.c_str(), &st) != 0) {
+        return false;
+    }
+    CacheHeader header;
+    std::ifstream fin(cache_path, std::ios::binary);
+    if (!fin.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+    return CheckHeader(header, static_cast<uint64_t>(st.st_size), source_path) == nullptr;
+}
+
+bool LoadSensorCache(const std::string& cache_path, const std::string& source_path, SensorCacheData& data) {
+    struct stat st;
+    if (stat(cache_path.c_str(), &st) != 0) {
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.Open(cache_path) || file.Size() < sizeof(CacheHeader)) {
+        LOG(WARNING) << "缓存文件无效: " << cache_path;
+        return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (const char* reason = CheckHeader(header, file.Size(), source_path)) {
+        LOG(WARNING) << reason << ": " << cache_path;
+        return false;
+    }
+
+    // IMU/GNSS的列直接读入SensorTables，不经过逐条的IMU/GNSS结构
+    IMUTable& imu = data.tables_.imu_;
+    GNSSTable& gnss = data.tables_.gnss_;
+    const size_t num_imu = header.num_imu_, num_gnss = header.num_gnss_;
+    imu.timestamp_.resize(num_imu);
+    imu.gyro_.resize(num_imu);
+    imu.acce_.resize(num_imu);
+    gnss.unix_time_.resize(num_gnss);
+    gnss.lat_lon_alt_.resize(num_gnss);
+    gnss.heading_.resize(num_gnss);
+    gnss.status_.resize(num_gnss);
+    gnss.heading_valid_.resize(num_gnss);
+    data.matched_heading_.assign(header.num_matched_, std::pair<double, double>(0, 0));
+    data.fbk_.assign(header.num_fbk_, FBKPair());
+
+    ColumnReader reader(file.Data() + sizeof(CacheHeader));
+    reader.ReadDoubles(num_imu, imu.timestamp_.data());
+    for (int k = 0; k < 3; ++k) {
+        reader.Read<double>(num_imu, [&](size_t i, double v) { imu.gyro_[i][k] = v; });
+    }
+    for (int k = 0; k < 3; ++k) {
+        reader.Read<double>(num_imu, [&](size_t i, double v) { imu.acce_[i][k] = v; });
+    }
+
+    reader.ReadDoubles(num_gnss, gnss.unix_time_.data());
+    for (int k = 0; k < 3; ++k) {
+        reader.Read<double>(num_gnss, [&](size_t i, double v) { gnss.lat_lon_alt_[i][k] = v; });
+    }
+    reader.ReadDoubles(num_gnss, gnss.heading_.data());
+    reader.Read<int32_t>(num_gnss, [&](size_t i, int32_t v) { gnss.status_[i] = GpsStatusType(v); });
+    reader.Read<uint8_t>(num_gnss, [&](size_t i, uint8_t v) { gnss.heading_valid_[i] = v != 0 ? 1 : 0; });
+
+    auto& matched = data.matched_heading_;
+    reader.Read<double>(matched.size(), [&](size_t i, double v) { matched[i].first = v; });
+    reader.Read<double>(matched.size(), [&](size_t i, double v) { matched[i].second = v; });
+
+    auto& fbk = data.fbk_;
+    reader.Read<double>(fbk.size(), [&](size_t i, double v) { fbk[i].flag_.timestamp_ = v; });
+    reader.Read<double>(fbk.size(), [&](size_t i, double v) { fbk[i].misalignment_.pitch_ = v; });
+    reader.Read<double>(fbk.size(), [&](size_t i, double v) { fbk[i].misalignment_.heading_ = v; });
+    // TxtIO只输出flag与misalignment都齐全的FBK对
+    for (auto& f : fbk) {
+        f.valid_ = true;
+    }
+
+    LOG(INFO) << "已加载数据缓存: " << cache_path << " (IMU=" << imu.Size() << ", GNSS=" << gnss.Size()
+              << ", 航向匹配=" << data.matched_heading_.size() << ", FBK=" << data.fbk_.size() << ")";
+    return true;
+}
+
+}  // namespace sad
@@ -0,0 +1,50 @@
+//
+// 离线数据的二进制列式缓存
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_SENSOR_CACHE_H
+#define SLAM_IN_AUTO_DRIVING_SENSOR_CACHE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/io_utils.h"
+#include "common/sensor_timeline.h"
+
+namespace sad {
+
+/// 一个日志文件解析后的全部离线数据
+struct SensorCacheData {
+    SensorTables tables_;  // IMU/GNSS按列存放，与缓存的列一一对应，加载后直接用于建立时间线
+    std::vector<std::pair<double, double>> matched_heading_;  // (GPS时间, NZZ航向)，未叠加GPS时间偏移
+    std::vector<FBKPair> fbk_;
+};
+
+/**
+ * 缓存文件格式（本机字节序）：
+ *   文件头：magic "SADCACHE"、版本号、源文件大小与修改时间、各数据流的条数
+ *   数据区：按列连续存放，每列为n个double（状态位等为int32/uint8，整体按8字节对齐）
+ *     IMU:     t, gx, gy, gz, ax, ay, az
+ *     GNSS:    t, lat, lon, alt, heading, status(int32), heading_valid(uint8)
+ *     航向匹配: t, heading
+ *     FBK:     t, pitch, heading
+ * 源文件大小、修改时间或版本号不一致时视为缓存失效
+ */
+constexpr uint32_t kSensorCacheVersion = 3;  // 2: $ACC/$GYR改为环形缓冲区同步; 3: NZZ按整数秒去重
+
+/// 缓存文件的默认路径
+inline std::string DefaultSensorCachePath(const std::string& source_path) { return source_path + ".cache"; }
+
+/// 写入缓存，先写本进程独占的临时文件（mkstemp）再重命名，并行任务同时写同一缓存时互不覆盖，读到的总是完整文件
+bool SaveSensorCache(const std::string& cache_path, const std::string& source_path, const SensorCacheData& data);
+
+/// 只读文件头检查缓存是否存在且有效，不加载数据
+bool IsSensorCacheValid(const std::string& cache_path, const std::string& source_path);
+
+/// 以内存映射方式读取缓存，缓存不存在或已失效时返回false
+bool LoadSensorCache(const std::string& cache_path, const std::string& source_path, SensorCacheData& data);
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_SENSOR_CACHE_H
@@ -0,0 +1,101 @@
+//
+// 按时间顺序拉取日志中的IMU/GNSS数据
+//
+
+#include "common/sensor_stream.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+
+namespace sad {
+
+namespace {
+
+/// 小顶堆的比较：时间晚的、时间相同时读入晚的排在后面
+template <typename T>
+bool LaterThan(const T& a, const T& b) {
+    if (a.record_.timestamp_ != b.record_.timestamp_) {
+        return a.record_.timestamp_ > b.record_.timestamp_;
+    }
+    return a.seq_ > b.seq_;
+}
+
+}  // namespace
+
+void SensorStream::Collector::operator()(const IMU& imu) const {
+    SensorRecord record;
+    record.type_ = SensorRecord::IMU_TYPE;
+    record.timestamp_ = imu.timestamp_;
+    record.imu_ = imu;
+    stream_->Push(std::move(record));
+}
+
+void SensorStream::Collector::operator()(const GNSS& gnss) const {
+    SensorRecord record;
+    record.type_ = SensorRecord::GNSS_TYPE;
+    record.gnss_ = gnss;
+    record.gnss_.unix_time_ += stream_->options_.gnss_time_offset_;
+    record.timestamp_ = record.gnss_.unix_time_;
+    stream_->Push(std::move(record));
+}
+
+SensorStream::SensorStream(const std::string& file_path, Options options)
+    : options_(options), reader_(file_path, options.mode_, Collector{this}) {}
+
+bool SensorStream::Next(SensorRecord& record) {
+    if (!opened_) {
+        opened_ = true;
+        eof_ = !reader_.Open();
+    }
+
+    // 逐行推进，直到窗口中最早的数据可以输出
+    while (!CanPop()) {
+        if (eof_) {
+            return false;
+        }
+        if (!reader_.Step()) {
+            eof_ = true;
+            if (num_late_ > 0) {
+                LOG(WARNING) << "有" << num_late_ << "条数据乱序超过重排窗口(" << options_.window_
+                             << "s)被丢弃，请增大窗口";
+            }
+        }
+    }
+
+    std::pop_heap(heap_.begin(), heap_.end(), LaterThan<Buffered>);
+    record = std::move(heap_.back().record_);
+    heap_.pop_back();
+
+    has_output_ = true;
+    last_output_time_ = record.timestamp_;
+    return true;
+}
+
+void SensorStream::Push(SensorRecord&& record) {
+    if (has_output_ && record.timestamp_ < last_output_time_) {
+        num_late_++;
+        return;
+    }
+
+    newest_time_ = has_input_ ? std::max(newest_time_, record.timestamp_) : record.timestamp_;
+    has_input_ = true;
+
+    heap_.push_back({std::move(record), next_seq_++});
+    std::push_heap(heap_.begin(), heap_.end(), LaterThan<Buffered>);
+    max_buffered_seen_ = std::max(max_buffered_seen_, heap_.size());
+}
+
+bool SensorStream::CanPop() const {
+    if (heap_.empty()) {
+        return false;
+    }
+    if (eof_ || heap_.size() > options_.max_buffered_) {
+        return true;
+    }
+    // GNSS时间偏移本身会造成同样大小的乱序，计入窗口
+    const double window = options_.window_ + std::abs(options_.gnss_time_offset_);
+    return heap_.front().record_.timestamp_ < newest_time_ - window;
+}
+
+}  // namespace sad
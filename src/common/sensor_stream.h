@@ -0,0 +1,136 @@
+//
+// 按时间顺序拉取日志中的IMU/GNSS数据
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_SENSOR_STREAM_H
+#define SLAM_IN_AUTO_DRIVING_SENSOR_STREAM_H
+
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "common/gnss.h"
+#include "common/imu.h"
+#include "common/txt_reader.h"
+
+namespace sad {
+
+/// 按时间排序后的一条传感器数据
+struct SensorRecord {
+    enum Type { IMU_TYPE, GNSS_TYPE };
+
+    Type type_ = IMU_TYPE;
+    double timestamp_ = 0;
+    IMU imu_;    // IMU_TYPE时有效
+    GNSS gnss_;  // GNSS_TYPE时有效
+};
+
+/**
+ * 拉取式的日志读取接口，每次Next()返回时间上最早的一条IMU/GNSS数据
+ *
+ * 日志按行逐步解析，解析出的数据先放入按时间排序的重排窗口，
+ * 窗口中最早的数据比已读到的最新数据早window_秒以上时才输出，内存占用只与窗口长度有关，与日志长度无关
+ * 时间相同的数据按读入顺序输出
+ * 比已输出数据更早到达的数据（乱序超过窗口）无法再排入正确位置，丢弃并计数，见 NumLateRecords()
+ *
+ *   sad::SensorStream stream(path, options);
+ *   for (const auto& record : stream) { ... }
+ */
+class SensorStream {
+   public:
+    struct Options {
+        Options() {}
+        double window_ = 2.0;            // 重排窗口长度(秒)，应大于日志中的最大乱序时间，GNSS时间偏移会自动计入
+        size_t max_buffered_ = 1 << 20;  // 窗口内最多缓存的条数，超出时提前输出最早的数据
+        double gnss_time_offset_ = 0.0;  // 读入时叠加到GNSS时间上的偏移
+        TxtReadMode mode_ = TxtReadMode::MMAP;
+    };
+
+    explicit SensorStream(const std::string& file_path, Options options = Options());
+
+    SensorStream(const SensorStream&) = delete;
+    SensorStream& operator=(const SensorStream&) = delete;
+
+    /// 取出下一条数据，全部读完时返回false
+    bool Next(SensorRecord& record);
+
+    /// 读取是否出错（压缩数据损坏、文件被截断），Next()返回false之后查询
+    bool Failed() const { return reader_.Failed(); }
+
+    /// 乱序超过窗口而被丢弃的条数
+    size_t NumLateRecords() const { return num_late_; }
+
+    /// 重排窗口中曾同时缓存的最多条数
+    size_t MaxBuffered() const { return max_buffered_seen_; }
+
+    /// 输入迭代器，用于range-for
+    class Iterator {
+       public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = SensorRecord;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const SensorRecord*;
+        using reference = const SensorRecord&;
+
+        Iterator() = default;
+        explicit Iterator(SensorStream* stream) : stream_(stream) { ++(*this); }
+
+        reference operator*() const { return record_; }
+        pointer operator->() const { return &record_; }
+        Iterator& operator++() {
+            if (stream_ != nullptr && !stream_->Next(record_)) {
+                stream_ = nullptr;
+            }
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return stream_ == other.stream_; }
+        bool operator!=(const Iterator& other) const { return stream_ != other.stream_; }
+
+       private:
+        SensorStream* stream_ = nullptr;
+        SensorRecord record_;
+    };
+
+    Iterator begin() { return Iterator(this); }
+    Iterator end() { return Iterator(); }
+
+   private:
+    /// 把TxtReader解析出的数据放入重排窗口
+    struct Collector {
+        SensorStream* stream_;
+
+        void operator()(const IMU& imu) const;
+        void operator()(const GNSS& gnss) const;
+    };
+
+    /// 窗口中的数据，seq_用于时间相同时保持读入顺序
+    struct Buffered {
+        SensorRecord record_;
+        uint64_t seq_;
+    };
+
+    void Push(SensorRecord&& record);
+
+    /// 最早的数据是否可以输出
+    bool CanPop() const;
+
+    Options options_;
+    TxtReader<Collector> reader_;
+    bool opened_ = false;
+    bool eof_ = false;
+
+    std::vector<Buffered> heap_;  // 以时间为键的小顶堆
+    uint64_t next_seq_ = 0;
+    bool has_input_ = false;
+    double newest_time_ = 0;  // 已读入数据的最新时间
+    bool has_output_ = false;
+    double last_output_time_ = 0;
+
+    size_t num_late_ = 0;
+    size_t max_buffered_seen_ = 0;
+};
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_SENSOR_STREAM_H
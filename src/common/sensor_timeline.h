@@ -0,0 +1,269 @@
+//
+// 离线处理用的IMU/GNSS时间线：按列存放的传感器表 + 按时间排序的事件序列
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_SENSOR_TIMELINE_H
+#define SLAM_IN_AUTO_DRIVING_SENSOR_TIMELINE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "common/eigen_types.h"
+#include "common/gnss.h"
+#include "common/imu.h"
+
+namespace sad {
+
+/// 按列存放的IMU数据
+struct IMUTable {
+    std::vector<double> timestamp_;
+    std::vector<Vec3d> gyro_;
+    std::vector<Vec3d> acce_;
+
+    size_t Size() const { return timestamp_.size(); }
+
+    void Reserve(size_t n) {
+        timestamp_.reserve(n);
+        gyro_.reserve(n);
+        acce_.reserve(n);
+    }
+
+    void Push(const IMU& imu) {
+        timestamp_.push_back(imu.timestamp_);
+        gyro_.push_back(imu.gyro_);
+        acce_.push_back(imu.acce_);
+    }
+
+    IMU Get(size_t i) const { return IMU(timestamp_[i], gyro_[i], acce_[i]); }
+
+    size_t MemoryBytes() const {
+        return timestamp_.capacity() * sizeof(double) + (gyro_.capacity() + acce_.capacity()) * sizeof(Vec3d);
+    }
+};
+
+/// 按列存放的GNSS数据，只保存日志中读到的字段，UTM坐标在使用时再计算
+struct GNSSTable {
+    std::vector<double> unix_time_;
+    std::vector<GpsStatusType> status_;
+    std::vector<Vec3d> lat_lon_alt_;
+    std::vector<double> heading_;
+    std::vector<uint8_t> heading_valid_;
+
+    size_t Size() const { return unix_time_.size(); }
+
+    void Reserve(size_t n) {
+        unix_time_.reserve(n);
+        status_.reserve(n);
+        lat_lon_alt_.reserve(n);
+        heading_.reserve(n);
+        heading_valid_.reserve(n);
+    }
+
+    /// time_offset叠加到GNSS时间上
+    void Push(const GNSS& gnss, double time_offset = 0.0) {
+        unix_time_.push_back(gnss.unix_time_ + time_offset);
+        status_.push_back(gnss.status_);
+        lat_lon_alt_.push_back(gnss.lat_lon_alt_);
+        heading_.push_back(gnss.heading_);
+        heading_valid_.push_back(gnss.heading_valid_ ? 1 : 0);
+    }
+
+    GNSS Get(size_t i) const {
+        return GNSS(unix_time_[i], static_cast<int>(status_[i]), lat_lon_alt_[i], heading_[i], heading_valid_[i] != 0);
+    }
+
+    size_t MemoryBytes() const {
+        return (unix_time_.capacity() + heading_.capacity()) * sizeof(double) +
+               status_.capacity() * sizeof(GpsStatusType) + lat_lon_alt_.capacity() * sizeof(Vec3d) +
+               heading_valid_.capacity();
+    }
+};
+
+/// 一个日志的IMU/GNSS表，GNSS时间不含偏移，建好后只读，可由不同GPS时间偏移的时间线共享
+struct SensorTables {
+    IMUTable imu_;
+    GNSSTable gnss_;
+
+    static std::shared_ptr<const SensorTables> Create(const std::vector<IMU>& imu, const std::vector<GNSS>& gnss) {
+        auto tables = std::make_shared<SensorTables>();
+        tables->imu_.Reserve(imu.size());
+        tables->gnss_.Reserve(gnss.size());
+        for (const auto& m : imu) {
+            tables->imu_.Push(m);
+        }
+        for (const auto& g : gnss) {
+            tables->gnss_.Push(g);
+        }
+        return tables;
+    }
+
+    size_t MemoryBytes() const { return imu_.MemoryBytes() + gnss_.MemoryBytes(); }
+};
+
+/// 时间线上的一条数据，指向对应传感器表中的一行
+struct SensorEvent {
+    enum Type : uint8_t { IMU_TYPE, GNSS_TYPE };
+
+    SensorEvent() = default;
+    SensorEvent(double timestamp, Type type, uint32_t index) : timestamp_(timestamp), index_(index), type_(type) {}
+
+    double timestamp_ = 0;
+    uint32_t index_ = 0;
+    Type type_ = IMU_TYPE;
+};
+
+/**
+ * 重组织后的离线数据
+ *
+ * IMU/GNSS各存一张列式表，时间顺序由16字节的事件数组表示，排序只移动事件，不移动传感器数据
+ * 遍历时按事件顺序从表中取出IMU/GNSS，交给回调处理
+ * GPS时间偏移只作用于事件时间和取出的GNSS，表本身不变，多个偏移的时间线共享同一份SensorTables
+ *
+ * 每路传感器数据在日志中基本按时间写入，只有少量局部乱序，因此不做整体排序：
+ * 先在每一路内用窗口为kRepairWindow的插入排序修复局部乱序，再把两路归并，总耗时O(N)
+ * 某一路的乱序超出窗口或逆序对超过kMaxInversionRatio时，该路退化为稳定排序
+ * 结果与对全部数据（IMU在前、GNSS在后）做稳定排序相同：时间相同的数据中IMU在前，同一路内保持读入顺序
+ */
+class SensorTimeline {
+   public:
+    static constexpr size_t kRepairWindow = 64;        // 插入修复时一条数据最多前移的位置数
+    static constexpr double kMaxInversionRatio = 0.01;  // 逆序对数超过该比例时改用排序
+
+    /// 重组织统计
+    struct Stats {
+        size_t imu_descents_ = 0;   // IMU中时间比前一条早的位置数
+        size_t gnss_descents_ = 0;  // GNSS中时间比前一条早的位置数
+        size_t inversions_ = 0;     // 插入修复消除的逆序对数，不含退化为排序的一路
+        bool imu_sorted_ = false;   // IMU是否退化为排序
+        bool gnss_sorted_ = false;  // GNSS是否退化为排序
+    };
+
+    /// 建表并按时间排序，gnss_time_offset叠加到GNSS时间上
+    void Build(const std::vector<IMU>& imu, const std::vector<GNSS>& gnss, double gnss_time_offset) {
+        Build(SensorTables::Create(imu, gnss), gnss_time_offset);
+    }
+
+    /// 在已有的表上按时间排序，gnss_time_offset叠加到GNSS时间上
+    void Build(std::shared_ptr<const SensorTables> tables, double gnss_time_offset) {
+        tables_ = std::move(tables);
+        gnss_time_offset_ = gnss_time_offset;
+        stats_ = Stats();
+
+        const IMUTable& imu = tables_->imu_;
+        std::vector<SensorEvent> imu_events;
+        imu_events.reserve(imu.Size());
+        for (size_t i = 0; i < imu.Size(); ++i) {
+            imu_events.emplace_back(imu.timestamp_[i], SensorEvent::IMU_TYPE, static_cast<uint32_t>(i));
+        }
+
+        const GNSSTable& gnss = tables_->gnss_;
+        std::vector<SensorEvent> gnss_events;
+        gnss_events.reserve(gnss.Size());
+        for (size_t i = 0; i < gnss.Size(); ++i) {
+            gnss_events.emplace_back(gnss.unix_time_[i] + gnss_time_offset_, SensorEvent::GNSS_TYPE,
+                                     static_cast<uint32_t>(i));
+        }
+
+        OrderStream(imu_events, stats_.imu_descents_, stats_.imu_sorted_);
+        OrderStream(gnss_events, stats_.gnss_descents_, stats_.gnss_sorted_);
+
+        // 两路归并，时间相同时先取IMU
+        events_.clear();
+        events_.reserve(imu_events.size() + gnss_events.size());
+        std::merge(imu_events.begin(), imu_events.end(), gnss_events.begin(), gnss_events.end(),
+                   std::back_inserter(events_), EarlierThan);
+    }
+
+    const Stats& GetStats() const { return stats_; }
+
+    /// 按时间顺序遍历，on_imu(const IMU&)、on_gnss(const GNSS&)
+    template <typename OnIMU, typename OnGNSS>
+    void ForEach(OnIMU&& on_imu, OnGNSS&& on_gnss) const {
+        ForEachIndexed(on_imu, [&](const GNSS& gnss, uint32_t) { on_gnss(gnss); });
+    }
+
+    /// 与ForEach相同，on_gnss(const GNSS&, uint32_t index)同时给出GNSS在表中的行号，便于查找按行预先计算的数据
+    template <typename OnIMU, typename OnGNSS>
+    void ForEachIndexed(OnIMU&& on_imu, OnGNSS&& on_gnss) const {
+        for (const auto& event : events_) {
+            if (event.type_ == SensorEvent::IMU_TYPE) {
+                on_imu(tables_->imu_.Get(event.index_));
+            } else {
+                GNSS gnss = tables_->gnss_.Get(event.index_);
+                gnss.unix_time_ += gnss_time_offset_;
+                on_gnss(gnss, event.index_);
+            }
+        }
+    }
+
+    size_t Size() const { return events_.size(); }
+    bool Empty() const { return events_.empty(); }
+
+    double GetGNSSTimeOffset() const { return gnss_time_offset_; }
+    const std::shared_ptr<const SensorTables>& GetTables() const { return tables_; }
+    const std::vector<SensorEvent>& GetEvents() const { return events_; }
+
+    /// 事件数组占用的内存，不含共享的表
+    size_t EventMemoryBytes() const { return events_.capacity() * sizeof(SensorEvent); }
+
+    size_t MemoryBytes() const { return (tables_ ? tables_->MemoryBytes() : 0) + EventMemoryBytes(); }
+
+   private:
+    static bool EarlierThan(const SensorEvent& a, const SensorEvent& b) { return a.timestamp_ < b.timestamp_; }
+
+    /// 把一路数据排成时间顺序（稳定），已有序时只做一次扫描
+    void OrderStream(std::vector<SensorEvent>& events, size_t& descents, bool& sorted) {
+        for (size_t i = 1; i < events.size(); ++i) {
+            if (EarlierThan(events[i], events[i - 1])) {
+                descents++;
+            }
+        }
+        if (descents == 0) {
+            return;
+        }
+
+        if (!RepairLocalInversions(events)) {
+            // 插入排序只移动严格更晚的数据，中途放弃时相同时间数据的相对顺序不变，稳定排序的结果不受影响
+            std::stable_sort(events.begin(), events.end(), EarlierThan);
+            sorted = true;
+        }
+    }
+
+    /// 窗口内的插入排序，乱序超出窗口或逆序对过多时返回false
+    bool RepairLocalInversions(std::vector<SensorEvent>& events) {
+        const size_t max_inversions = static_cast<size_t>(kMaxInversionRatio * events.size()) + kRepairWindow;
+        size_t inversions = 0;
+        for (size_t i = 1; i < events.size(); ++i) {
+            if (!EarlierThan(events[i], events[i - 1])) {
+                continue;
+            }
+
+            SensorEvent event = events[i];
+            size_t j = i;
+            while (j > 0 && EarlierThan(event, events[j - 1]) && i - j < kRepairWindow) {
+                events[j] = events[j - 1];
+                --j;
+            }
+            events[j] = event;
+
+            inversions += i - j;
+            if ((j > 0 && EarlierThan(event, events[j - 1])) || inversions > max_inversions) {
+                return false;
+            }
+        }
+        stats_.inversions_ += inversions;
+        return true;
+    }
+
+    std::shared_ptr<const SensorTables> tables_;
+    double gnss_time_offset_ = 0.0;
+    std::vector<SensorEvent> events_;
+    Stats stats_;
+};
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_SENSOR_TIMELINE_H
@@ -0,0 +1,181 @@
+//
+// 按上三角紧凑存放的对称矩阵，用于滤波器的协方差
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_SYM_PACKED_MATRIX_H
+#define SLAM_IN_AUTO_DRIVING_SYM_PACKED_MATRIX_H
+
+#include <Eigen/Core>
+#include <algorithm>
+
+namespace sad {
+
+/**
+ * N x N对称矩阵，只按行存放上三角的N(N+1)/2个元素，第i行的上三角部分(i, i..N-1)连续存放
+ * 所有写操作都只写上三角，结果严格对称；读取下三角元素时返回对称位置的值
+ * @tparam S 标量类型
+ * @tparam N 维数
+ */
+template <typename S, int N>
+class SymPackedMatrix {
+   public:
+    static constexpr int kSize = N * (N + 1) / 2;  // 存放的元素个数
+
+    using MatT = Eigen::Matrix<S, N, N>;
+    using VecT = Eigen::Matrix<S, N, 1>;
+    using DataT = Eigen::Matrix<S, kSize, 1>;
+
+    SymPackedMatrix() { data_.setZero(); }
+
+    /// 上三角元素(i, j), i <= j在data_中的下标
+    static constexpr int Index(int i, int j) { return i * N - i * (i - 1) / 2 + (j - i); }
+
+    /// 任意元素(i, j)
+    S operator()(int i, int j) const { return i <= j ? data_[Index(i, j)] : data_[Index(j, i)]; }
+
+    /// 上三角元素(i, j)的引用，要求i <= j
+    S& Upper(int i, int j) { return data_[Index(i, j)]; }
+
+    /// 第i行的上三角部分(i, i..N-1)
+    Eigen::Block<DataT, Eigen::Dynamic, 1> UpperRow(int i) { return data_.segment(Index(i, i), N - i); }
+    Eigen::Block<const DataT, Eigen::Dynamic, 1> UpperRow(int i) const { return data_.segment(Index(i, i), N - i); }
+
+    /// 取出从(i, j)开始的R x C子块，可以跨过对角线
+    template <int R, int C>
+    Eigen::Matrix<S, R, C> Block(int i, int j) const {
+        Eigen::Matrix<S, R, C> block;
+        for (int r = 0; r < R; ++r) {
+            // 对角线左侧的元素取对称位置，右侧的元素在行内连续存放
+            const int c0 = std::min(std::max(0, i + r - j), C);
+            for (int c = 0; c < c0; ++c) {
+                block(r, c) = data_[Index(j + c, i + r)];
+            }
+            if (c0 < C) {
+                block.row(r).tail(C - c0) = data_.segment(Index(i + r, j + c0), C - c0).transpose();
+            }
+        }
+        return block;
+    }
+
+    /**
+     * 从第i行开始的R行，每行都是完整的N列，不展开整个矩阵
+     * 对角线左侧第k列的R个元素在第k行中连续存放，右侧的元素在各行内连续存放
+     */
+    template <int R>
+    void Rows(int i, Eigen::Matrix<S, R, N>& rows) const {
+        for (int k = 0; k < i; ++k) {
+            rows.col(k) = data_.template segment<R>(Index(k, i));
+        }
+
+        // row[r][c]为元素(i + r, c), c >= i + r
+        const S* row[R];
+        for (int r = 0; r < R; ++r) {
+            row[r] = data_.data() + Index(i + r, i + r) - (i + r);
+        }
+        for (int c = 0; c < R; ++c) {
+            for (int r = 0; r < R; ++r) {
+                rows(r, i + c) = r <= c ? row[r][i + c] : row[c][i + r];
+            }
+        }
+        for (int c = i + R; c < N; ++c) {
+            for (int r = 0; r < R; ++r) {
+                rows(r, c) = row[r][c];
+            }
+        }
+    }
+
+    /// 写入从第i行开始的R行中位于上三角的部分，对角线左侧的值不使用
+    template <int R>
+    void SetUpperRows(int i, const Eigen::Matrix<S, R, N>& rows) {
+        for (int r = 0; r < R; ++r) {
+            S* row = data_.data() + Index(i + r, i + r) - (i + r);
+            for (int c = i + r; c < N; ++c) {
+                row[c] = rows(r, c);
+            }
+        }
+    }
+
+    /// 写入从(i, j)开始的R x C子块，只写其中位于上三角的元素
+    template <typename Derived>
+    void SetBlock(int i, int j, const Eigen::MatrixBase<Derived>& block) {
+        // 先求值，block可以是读取本矩阵的表达式
+        const typename Derived::PlainObject value = block;
+        const int cols = static_cast<int>(value.cols());
+        for (int r = 0; r < value.rows(); ++r) {
+            const int c0 = std::max(0, i + r - j);
+            if (c0 < cols) {
+                data_.segment(Index(i + r, j + c0), cols - c0) = value.row(r).tail(cols - c0).transpose();
+            }
+        }
+    }
+
+    /// 第j列
+    VecT Col(int j) const {
+        VecT col;
+        for (int i = 0; i < N; ++i) {
+            col[i] = (*this)(i, j);
+        }
+        return col;
+    }
+
+    /// 展开成完整矩阵
+    MatT Full() const {
+        MatT full;
+        for (int i = 0, k = 0; i < N; ++i) {
+            for (int j = i; j < N; ++j, ++k) {
+                full(i, j) = full(j, i) = data_[k];
+            }
+        }
+        return full;
+    }
+
+    /// 从完整矩阵取上三角
+    void FromFull(const MatT& full) {
+        for (int i = 0, k = 0; i < N; ++i) {
+            for (int j = i; j < N; ++j, ++k) {
+                data_[k] = full(i, j);
+            }
+        }
+    }
+
+    /// 设为对角阵scale * I
+    void SetIdentity(S scale = S(1)) {
+        data_.setZero();
+        for (int i = 0; i < N; ++i) {
+            data_[Index(i, i)] = scale;
+        }
+    }
+
+    S Diagonal(int i) const { return data_[Index(i, i)]; }
+
+    void AddDiagonal(const VecT& diag) {
+        for (int i = 0; i < N; ++i) {
+            data_[Index(i, i)] += diag[i];
+        }
+    }
+
+    /// this += alpha * u * u^T
+    void RankUpdate(const VecT& u, S alpha) {
+        for (int i = 0; i < N; ++i) {
+            UpperRow(i) += (alpha * u[i]) * u.tail(N - i);
+        }
+    }
+
+    /// this -= A * B^T，要求A * B^T对称，只计算上三角
+    template <int K>
+    void SubtractProduct(const Eigen::Matrix<S, N, K>& A, const Eigen::Matrix<S, N, K>& B) {
+        for (int i = 0; i < N; ++i) {
+            UpperRow(i).noalias() -= B.bottomRows(N - i) * A.row(i).transpose();
+        }
+    }
+
+    const DataT& Data() const { return data_; }
+    DataT& Data() { return data_; }
+
+   private:
+    DataT data_;
+};
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_SYM_PACKED_MATRIX_H
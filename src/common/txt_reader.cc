@@ -0,0 +1,210 @@
+//
+// 文本日志单行记录的解析
+//
+
+#include "common/txt_reader.h"
+
+#include <glog/logging.h>
+#include <charconv>
+
+namespace sad {
+namespace txt {
+
+namespace {
+
+bool StartsWith(std::string_view s, std::string_view prefix) { return s.substr(0, prefix.size()) == prefix; }
+
+/// 解析以sep分隔的三个整数，如"2025-6-12"、"11:22:27"；任一部分带前导零时unpadded置为false
+bool ParseIntTriple(std::string_view s, char sep, int* values, bool& unpadded) {
+    for (int i = 0; i < 3; ++i) {
+        size_t end = i < 2 ? s.find(sep) : s.size();
+        if (end == std::string_view::npos || end == 0) {
+            return false;
+        }
+        std::string_view part = s.substr(0, end);
+        auto result = std::from_chars(part.data(), part.data() + part.size(), values[i]);
+        if (result.ec != std::errc() || result.ptr != part.data() + part.size()) {
+            return false;
+        }
+        if (part.size() > 1 && part[0] == '0') {
+            unpadded = false;
+        }
+        s.remove_prefix(i < 2 ? end + 1 : end);
+    }
+    return true;
+}
+
+}  // namespace
+
+bool ParseDoubleFields(const LineFields& fields, int begin, int count, double* values) {
+    if (fields.Size() < begin + count) {
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (!ParseDouble(fields[begin + i], values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseGPSFields(const LineFields& fields, GNSS& gnss) {
+    if (fields.Size() < 25) {
+        LOG(WARNING) << "GPS数据字段不足，需要至少25个字段，实际：" << fields.Size();
+        return false;
+    }
+
+    // 时间戳(毫秒), WGS84经度, WGS84纬度, 航向, 速度, 高度
+    double timestamp = 0, longitude = 0, latitude = 0, heading = 0, speed = 0, altitude = 0;
+    if (!ParseDouble(fields[0], timestamp) || !ParseDouble(fields[6], longitude) ||
+        !ParseDouble(fields[7], latitude) || !ParseDouble(fields[8], heading) || !ParseDouble(fields[9], speed) ||
+        !ParseDouble(fields[10], altitude)) {
+        LOG(WARNING) << "解析GPS数据失败: " << fields[0];
+        return false;
+    }
+
+    bool gps_valid = (fields[11] == "A");
+    Vec3d lat_lon_alt(latitude / 10000000.0, longitude / 10000000.0, altitude);
+    gnss = GNSS(timestamp / 1000.0, gps_valid ? 4 : 0, lat_lon_alt, heading, true);
+    return true;
+}
+
+bool ParseGPSTimeKey(const LineFields& fields, TimeKey& time_key) {
+    int v[6];
+    for (int i = 0; i < 6; ++i) {
+        if (!ParseInt(fields[18 + i], v[i])) {
+            LOG(WARNING) << "解析GPS数据失败: " << fields[18 + i];
+            return false;
+        }
+    }
+
+    time_key = MakeTimeKey(v[0], v[1], v[2], v[3], v[4], v[5]);
+    return true;
+}
+
+bool ParseACCFields(const LineFields& fields, double& timestamp, Vec3d& acce) {
+    if (fields.Size() < 6) {
+        LOG(WARNING) << "ACC数据字段不足，需要至少6个字段，实际：" << fields.Size();
+        return false;
+    }
+
+    double t = 0, acc_up = 0, acc_front = 0, acc_right = 0;
+    if (!ParseDouble(fields[0], t) || !ParseDouble(fields[3], acc_up) || !ParseDouble(fields[4], acc_front) ||
+        !ParseDouble(fields[5], acc_right)) {
+        LOG(WARNING) << "解析ACC数据失败: " << fields[0];
+        return false;
+    }
+
+    // 毫秒转秒，g转m/s²，重排为XYZ=[朝右,朝前,朝上]
+    timestamp = t / 1000.0;
+    acce = Vec3d(acc_right * 9.8, acc_front * 9.8, acc_up * 9.8);
+    return true;
+}
+
+bool ParseGYRFields(const LineFields& fields, double& timestamp, Vec3d& gyro) {
+    if (fields.Size() < 7) {
+        LOG(WARNING) << "GYR数据字段不足，需要至少7个字段，实际：" << fields.Size();
+        return false;
+    }
+
+    double t = 0, gyro_up = 0, gyro_front = 0, gyro_right = 0;
+    if (!ParseDouble(fields[0], t) || !ParseDouble(fields[4], gyro_up) || !ParseDouble(fields[5], gyro_front) ||
+        !ParseDouble(fields[6], gyro_right)) {
+        LOG(WARNING) << "解析GYR数据失败: " << fields[0];
+        return false;
+    }
+
+    // 毫秒转秒，度/秒转弧度/秒，重排为XYZ=[朝右,朝前,朝上]
+    timestamp = t / 1000.0;
+    gyro = Vec3d(gyro_right * math::kDEG2RAD, gyro_front * math::kDEG2RAD, gyro_up * math::kDEG2RAD);
+    return true;
+}
+
+bool ParseNZZFields(const LineFields& fields, TimeKey& time_key, bool& unpadded, double& heading,
+                    bool& heading_valid) {
+    if (fields.Size() < 12) {
+        LOG(WARNING) << "NZZ数据字段不足，需要至少12个字段，实际：" << fields.Size();
+        return false;
+    }
+
+    int date[3], time[3];
+    unpadded = true;
+    if (!ParseIntTriple(fields[0], '-', date, unpadded) || !ParseIntTriple(fields[1], ':', time, unpadded)) {
+        LOG(WARNING) << "解析NZZ时间失败: " << fields[0] << " " << fields[1];
+        return false;
+    }
+    time_key = MakeTimeKey(date[0], date[1], date[2], time[0], time[1], time[2]);
+
+    heading_valid = ParseDouble(fields[11], heading);
+    if (!heading_valid) {
+        LOG(WARNING) << "解析NZZ数据失败: " << fields[11];
+    }
+    return true;
+}
+
+FBKLineType ParseFBKLine(std::string_view line, double* values, bool& valid) {
+    std::string_view full_line = TrimBlank(line);
+    if (full_line.empty()) {
+        LOG(WARNING) << "FBK数据为空";
+        return FBKLineType::OTHER;
+    }
+
+    LineFields fields;
+    if (StartsWith(full_line, "flag")) {
+        SplitFields(full_line, ',', fields);
+        if (fields.Size() < 3) {
+            LOG(WARNING) << "FBK flag数据字段不足，需要至少3个字段";
+            return FBKLineType::OTHER;
+        }
+        if (!ParseDouble(fields[2], values[0])) {
+            LOG(WARNING) << "解析FBK数据失败: " << fields[2];
+            return FBKLineType::OTHER;
+        }
+        values[0] /= 1000.0;
+        return FBKLineType::FLAG;
+    }
+
+    if (!StartsWith(full_line, "misalignment")) {
+        // 忽略其他格式的FBK行（如数字开头的行、info行等）
+        return FBKLineType::OTHER;
+    }
+
+    valid = false;
+    SplitFields(full_line, fields);
+    if (fields.Size() < 2) {
+        LOG(WARNING) << "FBK misalignment数据字段不足";
+        return FBKLineType::MISALIGNMENT;
+    }
+
+    // fields[1] 包含 "pitch:-19.279136,heading:-1.083479"
+    bool pitch_found = false, heading_found = false;
+    LineFields ph_fields;
+    SplitFields(fields[1], ',', ph_fields);
+    for (int i = 0; i < ph_fields.Size() && i < LineFields::kMaxFields; ++i) {
+        std::string_view ph_field = ph_fields[i];
+        if (StartsWith(ph_field, "pitch:")) {
+            if (!ParseDouble(ph_field.substr(6), values[0])) {
+                LOG(WARNING) << "解析FBK数据失败: " << ph_field;
+                return FBKLineType::MISALIGNMENT;
+            }
+            pitch_found = true;
+        }
+        if (StartsWith(ph_field, "heading:")) {
+            if (!ParseDouble(ph_field.substr(8), values[1])) {
+                LOG(WARNING) << "解析FBK数据失败: " << ph_field;
+                return FBKLineType::MISALIGNMENT;
+            }
+            heading_found = true;
+        }
+    }
+
+    valid = pitch_found && heading_found;
+    if (!valid) {
+        LOG(WARNING) << "FBK misalignment数据解析失败，pitch_found: " << pitch_found
+                     << ", heading_found: " << heading_found;
+    }
+    return FBKLineType::MISALIGNMENT;
+}
+
+}  // namespace txt
+}  // namespace sad
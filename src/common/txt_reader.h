@@ -0,0 +1,707 @@
+//
+// 以处理器类型为模板参数的文本日志读取器
+//
+
+#ifndef SLAM_IN_AUTO_DRIVING_TXT_READER_H
+#define SLAM_IN_AUTO_DRIVING_TXT_READER_H
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common/compressed_file.h"
+#include "common/imu_synchronizer.h"
+#include "common/io_utils.h"
+#include "common/line_fields.h"
+#include "common/mapped_file.h"
+
+namespace sad {
+
+/// 单行记录的解析，与读取方式和回调方式无关
+namespace txt {
+
+/// 日志中的记录类型
+enum class RecordType { GPS, ACC, GYR, NZZ, FBK, IMU, ODOM, GNSS, UNKNOWN };
+
+/// 把不超过4个字符的类型标签压成一个整数，编译期即可算出各标签的值，用于switch分派
+constexpr uint32_t PackTag(std::string_view tag) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < tag.size(); ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(tag[i])) << (8 * i);
+    }
+    return value;
+}
+
+inline RecordType ClassifyRecord(std::string_view data_type) {
+    if (data_type.empty() || data_type.size() > 4) {
+        return RecordType::UNKNOWN;
+    }
+
+    switch (PackTag(data_type)) {
+        case PackTag("$GPS"):
+            return RecordType::GPS;
+        case PackTag("$ACC"):
+            return RecordType::ACC;
+        case PackTag("$GYR"):
+            return RecordType::GYR;
+        case PackTag("$NZZ"):
+            return RecordType::NZZ;
+        case PackTag("$FBK"):
+            return RecordType::FBK;
+        case PackTag("IMU"):
+            return RecordType::IMU;
+        case PackTag("ODOM"):
+            return RecordType::ODOM;
+        case PackTag("GNSS"):
+            return RecordType::GNSS;
+        default:
+            return RecordType::UNKNOWN;
+    }
+}
+
+/// 从fields[begin]开始依次解析count个浮点数
+bool ParseDoubleFields(const LineFields& fields, int begin, int count, double* values);
+
+/**
+ * $GPS行：时间戳、WGS84经纬度、航向、速度、高度、定位状态
+ * 字段索引（不含$GPS）：0=时间戳(毫秒), 6=经度_wgs84, 7=纬度_wgs84, 8=航向, 9=速度, 10=高度, 11=GPS状态
+ * 时间字段：18=年, 19=月, 20=日, 21=时, 22=分, 23=秒
+ */
+bool ParseGPSFields(const LineFields& fields, GNSS& gnss);
+
+/// $GPS行中的年月日时分秒，换算成与NZZ一致的时间键
+bool ParseGPSTimeKey(const LineFields& fields, TimeKey& time_key);
+
+/// $ACC行：时间戳 有效轴 时间间隔 朝上轴读数 朝前轴读数 朝右轴读数
+bool ParseACCFields(const LineFields& fields, double& timestamp, Vec3d& acce);
+
+/// $GYR行：时间戳 有效轴 时间间隔 温度值 朝上轴读数 朝前轴读数 朝右轴读数
+bool ParseGYRFields(const LineFields& fields, double& timestamp, Vec3d& gyro);
+
+/// $NZZ行：fields[0] = 日期, fields[1] = 时间, fields[11] = 航向角
+/// 字段不足或日期时间无法解析时返回false；航向解析失败时仍返回时间键，以便与逐行读取一样参与去重
+bool ParseNZZFields(const LineFields& fields, TimeKey& time_key, bool& unpadded, double& heading,
+                    bool& heading_valid);
+
+/// $FBK行的类型
+enum class FBKLineType { OTHER, FLAG, MISALIGNMENT };
+
+/**
+ * $FBK行
+ * flag行：flag,1,164385368,...（逗号分隔），values[0]为时间戳（秒）
+ * misalignment行：misalignment pitch:-19.279136,heading:-1.083479，values为(pitch, heading)
+ * valid表示misalignment行中pitch和heading都解析成功
+ */
+FBKLineType ParseFBKLine(std::string_view line, double* values, bool& valid);
+
+}  // namespace txt
+
+/// 把多个lambda合成一个重载集合，作为TxtReader的处理器
+template <typename... Funcs>
+struct Overloaded : Funcs... {
+    using Funcs::operator()...;
+};
+template <typename... Funcs>
+Overloaded(Funcs...) -> Overloaded<Funcs...>;
+
+/// 处理器可提供 bool Enabled(RecordTag<T>) const，在运行时关闭某类数据的解析
+template <typename T>
+struct RecordTag {};
+
+/**
+ * 与TxtIO行为一致的日志读取器，回调在编译期绑定到处理器类型上
+ *
+ * 处理器是一组operator()重载，可接收 IMU/GNSS/Odom/NZZ/GPSWithTimeKey/FBKPair 中的任意几种，
+ * 没有对应重载的数据类型不解析；每条记录直接调用处理器，可被编译器内联，没有std::function的类型擦除开销
+ *
+ *   sad::TxtReader reader(path, sad::TxtReadMode::MMAP,
+ *                         sad::Overloaded{[&](const sad::IMU& imu) { ... }, [&](const sad::GNSS& gnss) { ... }});
+ *   reader.Go();
+ */
+template <typename Handler>
+class TxtReader {
+   public:
+    TxtReader(const std::string& file_path, TxtReadMode mode, Handler handler)
+        : file_path_(file_path), mode_(mode), handler_(std::move(handler)) {}
+
+    /// 设置MMAP方式的解析线程数，含义同TxtIO::SetNumThreads
+    TxtReader& SetNumThreads(int num_threads) {
+        num_threads_ = num_threads;
+        return *this;
+    }
+
+    /// $ACC/$GYR合成IMU的同步方式
+    TxtReader& SetImuSyncOptions(const ImuSynchronizer::Options& options) {
+        imu_sync_.SetOptions(options);
+        return *this;
+    }
+
+    Handler& GetHandler() { return handler_; }
+    const ImuSynchronizer::Stats& GetImuSyncStats() const { return imu_sync_.GetStats(); }
+
+    // 遍历文件内容，调用处理器；文件无法打开或读取出错时返回false，此时处理器只收到了文件的一部分
+    bool Go();
+
+    /// 逐行读取：Open()之后每次Step()解析一行并调用处理器，文件读完时输出同步缓冲区中剩余的IMU并返回false
+    /// 供拉取式的上层接口按需推进，不使用多线程
+    bool Open();
+    bool Step();
+
+    /// 读取是否出错（压缩数据损坏、文件被截断或读取失败），Step()返回false之后查询
+    bool Failed() const { return failed_; }
+
+   private:
+    template <typename T>
+    static constexpr bool kHandles = std::is_invocable_v<Handler&, const T&>;
+
+    template <typename H, typename T, typename = void>
+    struct HasEnabled : std::false_type {};
+    template <typename H, typename T>
+    struct HasEnabled<H, T, std::void_t<decltype(std::declval<const H&>().Enabled(RecordTag<T>()))>>
+        : std::true_type {};
+
+    /// 处理器是否需要某类数据
+    template <typename T>
+    bool Enabled() const {
+        if constexpr (!kHandles<T>) {
+            return false;
+        } else if constexpr (HasEnabled<Handler, T>::value) {
+            return handler_.Enabled(RecordTag<T>());
+        } else {
+            return true;
+        }
+    }
+
+    template <typename T>
+    void Emit(const T& data) {
+        if constexpr (kHandles<T>) {
+            handler_(data);
+        }
+    }
+
+    /// 单行解析与跨行状态（ACC/GYR组合、NZZ去重、FBK配对）分开处理：
+    /// 顺序读取时，每行的解析结果直接交给DirectSink处理；
+    /// 并行读取时，各线程把所负责数据块的解析结果存入ChunkRecords，再由主线程按块顺序处理跨行状态并调用处理器
+    struct DirectSink;
+    struct ChunkRecords;
+
+    void GoMappedParallel(std::string_view data);
+    template <typename Sink>
+    void ParseLine(std::string_view line, Sink& sink) const;
+    void ApplyChunk(const ChunkRecords& chunk);
+
+    /// 跨行状态处理
+    void OnACC(double timestamp, const Vec3d& acce);
+    void OnGYR(double timestamp, const Vec3d& gyro);
+    void OnNZZ(TimeKey time_key, bool unpadded, double heading, bool heading_valid);
+    void OnFBKFlag(double timestamp);
+    void OnFBKMisalignment(double pitch, double heading, bool valid);
+
+    /// 文件读完，输出同步缓冲区中剩余的IMU
+    void Finish();
+
+    std::string file_path_;
+    TxtReadMode mode_ = TxtReadMode::STREAM;
+    int num_threads_ = 1;
+    Handler handler_;
+
+    /// 逐行读取的位置
+    std::ifstream fin_;
+    MappedFile file_;
+    std::string_view data_;
+    size_t pos_ = 0;
+    std::string line_;  // STREAM方式的行缓冲，反复使用，容量稳定后不再申请内存
+    std::unique_ptr<CompressedLineReader> compressed_;  // .gz/.zst文件，非空时代替上面两种方式
+
+    /// 各类数据是否需要解析，在Open()时确定
+    bool imu_enabled_ = false;
+    bool odom_enabled_ = false;
+    bool gnss_enabled_ = false;
+    bool nzz_enabled_ = false;
+    bool gps_timekey_enabled_ = false;
+    bool fbk_enabled_ = false;
+
+    /// IMU数据组合相关
+    ImuSynchronizer imu_sync_;
+    bool finished_ = false;
+    bool failed_ = false;
+
+    /// NZZ数据去重相关，NZZ按时间顺序写入，同一秒的数据通常相邻，先与上一个时间键比较，
+    /// 再在最近kNZZTimeWindow个不同的时间键中查找；只保留固定个数，内存不随日志长度增长
+    static constexpr int kNZZTimeWindow = 16;
+    std::array<TimeKey, kNZZTimeWindow> recent_nzz_times_{};  // 最近处理过的NZZ时间，循环覆盖最早的
+    int num_recent_nzz_ = 0;                                  // recent_nzz_times_中有效的个数
+    int next_recent_nzz_ = 0;                                 // 下一个写入位置
+    TimeKey last_nzz_time_ = 0;
+    bool has_nzz_time_ = false;
+
+    /// FBK数据处理相关
+    FBKFlag pending_flag_;             // 待匹配的flag数据
+    bool pending_flag_valid_ = false;  // flag数据是否有效
+};
+
+/// 顺序读取：解析结果立即处理
+template <typename Handler>
+struct TxtReader<Handler>::DirectSink {
+    TxtReader& reader_;
+
+    void OnIMU(const IMU& imu) { reader_.Emit(imu); }
+    void OnACC(double timestamp, const Vec3d& acce) { reader_.OnACC(timestamp, acce); }
+    void OnGYR(double timestamp, const Vec3d& gyro) { reader_.OnGYR(timestamp, gyro); }
+    void OnGNSS(const GNSS& gnss) { reader_.Emit(gnss); }
+    void OnGPSWithTimeKey(const GPSWithTimeKey& gps) { reader_.Emit(gps); }
+    void OnOdom(const Odom& odom) { reader_.Emit(odom); }
+    void OnNZZ(TimeKey time_key, bool unpadded, double heading, bool heading_valid) {
+        reader_.OnNZZ(time_key, unpadded, heading, heading_valid);
+    }
+    void OnFBKFlag(double timestamp) { reader_.OnFBKFlag(timestamp); }
+    void OnFBKMisalignment(double pitch, double heading, bool valid) {
+        reader_.OnFBKMisalignment(pitch, heading, valid);
+    }
+};
+
+/// 并行读取：单个数据块的解析结果，每类数据按文件顺序存放
+template <typename Handler>
+struct TxtReader<Handler>::ChunkRecords {
+    /// IMU流，原格式IMU行与$ACC/$GYR行共用一个序列以保持相对顺序
+    struct InertialRecord {
+        enum Type { IMU_TYPE, ACC_TYPE, GYR_TYPE } type_;
+        IMU imu_;  // ACC只用acce_，GYR只用gyro_
+    };
+
+    struct NZZRecord {
+        TimeKey time_key_;
+        bool unpadded_;
+        double heading_;
+        bool heading_valid_;
+    };
+
+    struct FBKRecord {
+        bool is_flag_;
+        double timestamp_;  // flag行
+        double pitch_;      // misalignment行
+        double heading_;
+        bool valid_;
+    };
+
+    std::vector<InertialRecord> inertial_;
+    std::vector<GNSS> gnss_;
+    std::vector<GPSWithTimeKey> gps_timekey_;
+    std::vector<Odom> odom_;
+    std::vector<NZZRecord> nzz_;
+    std::vector<FBKRecord> fbk_;
+
+    void OnIMU(const IMU& imu) { inertial_.push_back({InertialRecord::IMU_TYPE, imu}); }
+    void OnACC(double timestamp, const Vec3d& acce) {
+        inertial_.push_back({InertialRecord::ACC_TYPE, IMU(timestamp, Vec3d::Zero(), acce)});
+    }
+    void OnGYR(double timestamp, const Vec3d& gyro) {
+        inertial_.push_back({InertialRecord::GYR_TYPE, IMU(timestamp, gyro, Vec3d::Zero())});
+    }
+    void OnGNSS(const GNSS& gnss) { gnss_.push_back(gnss); }
+    void OnGPSWithTimeKey(const GPSWithTimeKey& gps) { gps_timekey_.push_back(gps); }
+    void OnOdom(const Odom& odom) { odom_.push_back(odom); }
+    void OnNZZ(TimeKey time_key, bool unpadded, double heading, bool heading_valid) {
+        nzz_.push_back({time_key, unpadded, heading, heading_valid});
+    }
+    void OnFBKFlag(double timestamp) { fbk_.push_back({true, timestamp, 0, 0, true}); }
+    void OnFBKMisalignment(double pitch, double heading, bool valid) {
+        fbk_.push_back({false, 0, pitch, heading, valid});
+    }
+};
+
+template <typename Handler>
+bool TxtReader<Handler>::Go() {
+    if (!Open()) {
+        return false;
+    }
+
+    if (mode_ == TxtReadMode::MMAP && num_threads_ > 1 && compressed_ == nullptr) {
+        GoMappedParallel(data_);
+        Finish();
+    } else {
+        while (Step()) {
+        }
+    }
+
+    if (failed_) {
+        LOG(ERROR) << "读取未完成: " << file_path_;
+        return false;
+    }
+    LOG(INFO) << "done.";
+    return true;
+}
+
+template <typename Handler>
+bool TxtReader<Handler>::Open() {
+    imu_enabled_ = Enabled<IMU>();
+    odom_enabled_ = Enabled<Odom>();
+    gnss_enabled_ = Enabled<GNSS>();
+    nzz_enabled_ = Enabled<NZZ>();
+    gps_timekey_enabled_ = Enabled<GPSWithTimeKey>();
+    fbk_enabled_ = Enabled<FBKPair>();
+
+    pos_ = 0;
+    finished_ = false;
+    failed_ = false;
+    compressed_.reset();
+    if (DetectCompression(file_path_) != CompressionType::NONE) {
+        // 压缩文件不区分读取方式，都由后台线程边解压边交给解析线程
+        compressed_ = std::make_unique<CompressedLineReader>();
+        if (!compressed_->Open(file_path_)) {
+            compressed_.reset();
+            return false;
+        }
+        return true;
+    }
+
+    if (mode_ == TxtReadMode::MMAP) {
+        if (!file_.Open(file_path_)) {
+            LOG(ERROR) << "未能找到文件";
+            return false;
+        }
+        data_ = file_.View();
+        return true;
+    }
+
+    fin_.close();
+    fin_.clear();
+    fin_.open(file_path_);
+    if (!fin_) {
+        LOG(ERROR) << "未能找到文件";
+        return false;
+    }
+    return true;
+}
+
+template <typename Handler>
+bool TxtReader<Handler>::Step() {
+    DirectSink sink{*this};
+    if (compressed_ != nullptr) {
+        std::string_view line;
+        if (!compressed_->NextLine(line)) {
+            Finish();
+            return false;
+        }
+        ParseLine(line, sink);
+        return true;
+    }
+
+    if (mode_ == TxtReadMode::MMAP) {
+        if (pos_ >= data_.size()) {
+            Finish();
+            return false;
+        }
+        size_t end = data_.find('\n', pos_);
+        if (end == std::string_view::npos) {
+            end = data_.size();
+        }
+        ParseLine(data_.substr(pos_, end - pos_), sink);
+        pos_ = end + 1;
+        return true;
+    }
+
+    if (!std::getline(fin_, line_)) {
+        failed_ = fin_.bad();
+        Finish();
+        return false;
+    }
+    ParseLine(line_, sink);
+    return true;
+}
+
+template <typename Handler>
+void TxtReader<Handler>::GoMappedParallel(std::string_view data) {
+    // 按大小均分后把切分点推到下一行开头，每行只属于一个数据块
+    const size_t num_chunks = static_cast<size_t>(num_threads_);
+    std::vector<size_t> bounds(1, 0);
+    for (size_t i = 1; i < num_chunks; ++i) {
+        size_t pos = std::max(data.size() * i / num_chunks, bounds.back());
+        size_t newline = data.find('\n', pos);
+        bounds.push_back(newline == std::string_view::npos ? data.size() : newline + 1);
+    }
+    bounds.push_back(data.size());
+
+    std::vector<ChunkRecords> chunks(num_chunks);
+    std::vector<std::thread> workers;
+    workers.reserve(num_chunks);
+    for (size_t i = 0; i < num_chunks; ++i) {
+        workers.emplace_back([this, &chunks, &bounds, data, i]() {
+            std::string_view chunk = data.substr(bounds[i], bounds[i + 1] - bounds[i]);
+            size_t pos = 0;
+            while (pos < chunk.size()) {
+                size_t end = chunk.find('\n', pos);
+                if (end == std::string_view::npos) {
+                    end = chunk.size();
+                }
+                ParseLine(chunk.substr(pos, end - pos), chunks[i]);
+                pos = end + 1;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // 按块顺序处理跨行状态，块边界处的ACC/GYR组合、FBK配对与NZZ去重与逐行读取一致
+    for (auto& chunk : chunks) {
+        ApplyChunk(chunk);
+        chunk = ChunkRecords();
+    }
+}
+
+template <typename Handler>
+template <typename Sink>
+void TxtReader<Handler>::ParseLine(std::string_view line, Sink& sink) const {
+    if (line.empty() || line[0] == '#') {
+        // 以#开头的是注释
+        return;
+    }
+
+    std::string_view rest;
+    std::string_view data_type = NextToken(line, rest);
+
+    // 字段位置在SplitFields中一次算好，后续按下标直接取用
+    LineFields fields;
+    switch (txt::ClassifyRecord(data_type)) {
+        case txt::RecordType::GPS: {
+            if (!gnss_enabled_ && !gps_timekey_enabled_) {
+                break;
+            }
+            SplitFields(rest, fields);
+            GNSS gnss;
+            if (!txt::ParseGPSFields(fields, gnss)) {
+                break;
+            }
+            if (gnss_enabled_) {
+                sink.OnGNSS(gnss);
+            }
+
+            TimeKey time_key;
+            if (gps_timekey_enabled_ && txt::ParseGPSTimeKey(fields, time_key)) {
+                sink.OnGPSWithTimeKey(GPSWithTimeKey(gnss, time_key));
+            }
+            break;
+        }
+        case txt::RecordType::ACC: {
+            if (!imu_enabled_) {
+                break;
+            }
+            double timestamp;
+            Vec3d acce;
+            SplitFields(rest, fields);
+            if (txt::ParseACCFields(fields, timestamp, acce)) {
+                sink.OnACC(timestamp, acce);
+            }
+            break;
+        }
+        case txt::RecordType::GYR: {
+            if (!imu_enabled_) {
+                break;
+            }
+            double timestamp;
+            Vec3d gyro;
+            SplitFields(rest, fields);
+            if (txt::ParseGYRFields(fields, timestamp, gyro)) {
+                sink.OnGYR(timestamp, gyro);
+            }
+            break;
+        }
+        case txt::RecordType::NZZ: {
+            if (!nzz_enabled_) {
+                break;
+            }
+            TimeKey time_key = 0;
+            bool unpadded = true;
+            double heading = 0;
+            bool heading_valid = false;
+            SplitFields(rest, fields);
+            if (txt::ParseNZZFields(fields, time_key, unpadded, heading, heading_valid)) {
+                sink.OnNZZ(time_key, unpadded, heading, heading_valid);
+            }
+            break;
+        }
+        case txt::RecordType::FBK: {
+            if (!fbk_enabled_) {
+                break;
+            }
+            double values[2] = {0, 0};
+            bool valid = false;
+            txt::FBKLineType type = txt::ParseFBKLine(rest, values, valid);
+            if (type == txt::FBKLineType::FLAG) {
+                sink.OnFBKFlag(values[0]);
+            } else if (type == txt::FBKLineType::MISALIGNMENT) {
+                sink.OnFBKMisalignment(values[0], values[1], valid);
+            }
+            break;
+        }
+        case txt::RecordType::IMU: {
+            if (!imu_enabled_) {
+                break;
+            }
+            // time, gx, gy, gz, ax, ay, az
+            double v[7];
+            SplitFields(rest, fields);
+            if (!txt::ParseDoubleFields(fields, 0, 7, v)) {
+                LOG(WARNING) << "解析IMU数据失败";
+                break;
+            }
+            sink.OnIMU(IMU(v[0], Vec3d(v[1], v[2], v[3]), Vec3d(v[4], v[5], v[6])));
+            break;
+        }
+        case txt::RecordType::ODOM: {
+            if (!odom_enabled_) {
+                break;
+            }
+            // time, wl, wr
+            double v[3];
+            SplitFields(rest, fields);
+            if (!txt::ParseDoubleFields(fields, 0, 3, v)) {
+                LOG(WARNING) << "解析ODOM数据失败";
+                break;
+            }
+            sink.OnOdom(Odom(v[0], v[1], v[2]));
+            break;
+        }
+        case txt::RecordType::GNSS: {
+            if (!gnss_enabled_) {
+                break;
+            }
+            // time, lat, lon, alt, heading, heading_valid
+            double v[5];
+            int heading_valid = 0;
+            SplitFields(rest, fields);
+            if (!txt::ParseDoubleFields(fields, 0, 5, v) || fields.Size() < 6 ||
+                !ParseInt(fields[5], heading_valid)) {
+                LOG(WARNING) << "解析GNSS数据失败";
+                break;
+            }
+            sink.OnGNSS(GNSS(v[0], 4, Vec3d(v[1], v[2], v[3]), v[4], heading_valid != 0));
+            break;
+        }
+        case txt::RecordType::UNKNOWN:
+            break;
+    }
+}
+
+template <typename Handler>
+void TxtReader<Handler>::ApplyChunk(const ChunkRecords& chunk) {
+    for (const auto& record : chunk.inertial_) {
+        switch (record.type_) {
+            case ChunkRecords::InertialRecord::IMU_TYPE:
+                Emit(record.imu_);
+                break;
+            case ChunkRecords::InertialRecord::ACC_TYPE:
+                OnACC(record.imu_.timestamp_, record.imu_.acce_);
+                break;
+            case ChunkRecords::InertialRecord::GYR_TYPE:
+                OnGYR(record.imu_.timestamp_, record.imu_.gyro_);
+                break;
+        }
+    }
+    for (const auto& gnss : chunk.gnss_) {
+        Emit(gnss);
+    }
+    for (const auto& gps : chunk.gps_timekey_) {
+        Emit(gps);
+    }
+    for (const auto& odom : chunk.odom_) {
+        Emit(odom);
+    }
+    for (const auto& nzz : chunk.nzz_) {
+        OnNZZ(nzz.time_key_, nzz.unpadded_, nzz.heading_, nzz.heading_valid_);
+    }
+    for (const auto& fbk : chunk.fbk_) {
+        if (fbk.is_flag_) {
+            OnFBKFlag(fbk.timestamp_);
+        } else {
+            OnFBKMisalignment(fbk.pitch_, fbk.heading_, fbk.valid_);
+        }
+    }
+}
+
+template <typename Handler>
+void TxtReader<Handler>::OnACC(double timestamp, const Vec3d& acce) {
+    imu_sync_.AddAcce(timestamp, acce, [this](const IMU& imu) { Emit(imu); });
+}
+
+template <typename Handler>
+void TxtReader<Handler>::OnGYR(double timestamp, const Vec3d& gyro) {
+    imu_sync_.AddGyro(timestamp, gyro, [this](const IMU& imu) { Emit(imu); });
+}
+
+template <typename Handler>
+void TxtReader<Handler>::Finish() {
+    if (finished_) {
+        return;
+    }
+    finished_ = true;
+
+    imu_sync_.Flush([this](const IMU& imu) { Emit(imu); });
+
+    if (compressed_ != nullptr) {
+        failed_ = compressed_->Failed();
+        compressed_->Close();
+        compressed_->LogStats();
+    }
+
+    const auto& stats = imu_sync_.GetStats();
+    if (stats.Output() + stats.dropped_acc_ + stats.dropped_gyr_ > 0) {
+        LOG(INFO) << "ACC/GYR同步: 插值" << stats.interpolated_ << ", 最近邻配对" << stats.paired_ << ", 丢弃ACC "
+                  << stats.dropped_acc_ << ", 丢弃GYR " << stats.dropped_gyr_ << ", 缓冲区溢出" << stats.overflow_;
+    }
+}
+
+template <typename Handler>
+void TxtReader<Handler>::OnNZZ(TimeKey time_key, bool unpadded, double heading, bool heading_valid) {
+    // 去重：每秒只保留第一个NZZ数据
+    if (has_nzz_time_ && time_key == last_nzz_time_) {
+        return;
+    }
+    has_nzz_time_ = true;
+    last_nzz_time_ = time_key;
+
+    // 重复的时间键早于最近kNZZTimeWindow个不同的时间键时不再去重，NZZ每秒一个，相当于日志回跳超过约16秒
+    const auto recent_end = recent_nzz_times_.begin() + num_recent_nzz_;
+    if (std::find(recent_nzz_times_.begin(), recent_end, time_key) != recent_end) {
+        return;
+    }
+    recent_nzz_times_[next_recent_nzz_] = time_key;
+    next_recent_nzz_ = (next_recent_nzz_ + 1) % kNZZTimeWindow;
+    num_recent_nzz_ = std::min(num_recent_nzz_ + 1, kNZZTimeWindow);
+    if (heading_valid) {
+        Emit(NZZ(time_key, heading, unpadded));
+    }
+}
+
+template <typename Handler>
+void TxtReader<Handler>::OnFBKFlag(double timestamp) {
+    // 存储flag数据，等待下一行的misalignment
+    pending_flag_ = FBKFlag(timestamp);
+    pending_flag_valid_ = true;
+}
+
+template <typename Handler>
+void TxtReader<Handler>::OnFBKMisalignment(double pitch, double heading, bool valid) {
+    if (!pending_flag_valid_) {
+        LOG(WARNING) << "收到misalignment但没有对应的flag数据";
+        return;
+    }
+    if (valid) {
+        Emit(FBKPair(pending_flag_, FBKMisalignment(pitch, heading)));
+        pending_flag_valid_ = false;
+    }
+}
+
+}  // namespace sad
+
+#endif  // SLAM_IN_AUTO_DRIVING_TXT_READER_H